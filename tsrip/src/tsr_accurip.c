@@ -0,0 +1,488 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_accurip.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * AccurateRip v1 and v2 checksums and a crc32 of every track, as CUETools
+ * shows them, computed while the sectors are read. They are compared to a
+ * local database, a text file with lines like
+ *
+ *   dBAR-012-001ab0f4-00e2c8a1-a10b2f0c 3 17 8f3c21d0
+ *
+ * holding the AccurateRip id of a disc, the track number, the confidence
+ * and a v1, v2 or crc32 checksum of the track.
+ *
+ * The database holds the checksums of the audio as it is on the disc, the
+ * read offset correction of the drive, as AccurateRip lists it, is applied
+ * by summing up the samples of a track shifted by it. The window reaches into
+ * the neighbouring track, the reader adds those sectors, too. The crc32 is
+ * taken of the track as read.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdint.h>
+#include <cdda_interface.h>
+
+#include "config.h"
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_accurip.h"
+#include "tsr_crc32.h"
+#include "tsr_util.h"
+
+#if defined(HAVE_IMMINTRIN_H) && (defined(__x86_64__) || defined(__i386__))
+#define TSR_ACCURIP_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Plain C kernel, works everywhere.
+ *
+ */
+static void tsr_accurip_sum_c(const uint8_t *pcm, uint32_t mult, long samples,
+		uint64_t *lo, uint64_t *hi)
+{
+	uint64_t prod;
+	uint32_t sample;
+	long i;
+
+	for (i = 0; i < samples; i++)
+	{
+		sample = (uint32_t) pcm[i * 4] | (uint32_t) pcm[i * 4 + 1] << 8
+			| (uint32_t) pcm[i * 4 + 2] << 16 | (uint32_t) pcm[i * 4 + 3] << 24;
+		prod = (uint64_t) sample * (mult + i);
+		*lo += (uint32_t) prod;
+		*hi += prod >> 32;
+	}
+}
+
+static int tsr_accurip_supported_c(void)
+{
+	return 1;
+}
+
+#ifdef TSR_ACCURIP_X86
+
+/*
+ * SSE2 kernel, 4 samples per step. The even and the odd lanes are
+ * multiplied to 64 bit products separately, their halves are summed up in
+ * 64 bit lanes.
+ *
+ */
+__attribute__((target("sse2")))
+static void tsr_accurip_sum_sse2(const uint8_t *pcm, uint32_t mult, long samples,
+		uint64_t *lo, uint64_t *hi)
+{
+	const __m128i mask = _mm_set1_epi64x(0xffffffff);
+	const __m128i four = _mm_set1_epi32(4);
+	__m128i m, s, even, odd, acclo, acchi;
+	uint64_t out[2];
+	long i;
+
+	m = _mm_setr_epi32(mult, mult + 1, mult + 2, mult + 3);
+	acclo = _mm_setzero_si128();
+	acchi = _mm_setzero_si128();
+
+	for (i = 0; i + 4 <= samples; i += 4)
+	{
+		s = _mm_loadu_si128((const __m128i *) (pcm + i * 4));
+		even = _mm_mul_epu32(s, m);
+		odd = _mm_mul_epu32(_mm_srli_epi64(s, 32), _mm_srli_epi64(m, 32));
+		acclo = _mm_add_epi64(acclo, _mm_add_epi64(_mm_and_si128(even, mask),
+					_mm_and_si128(odd, mask)));
+		acchi = _mm_add_epi64(acchi, _mm_add_epi64(_mm_srli_epi64(even, 32),
+					_mm_srli_epi64(odd, 32)));
+		m = _mm_add_epi32(m, four);
+	}
+
+	_mm_storeu_si128((__m128i *) out, acclo);
+	*lo += out[0] + out[1];
+	_mm_storeu_si128((__m128i *) out, acchi);
+	*hi += out[0] + out[1];
+	tsr_accurip_sum_c(pcm + i * 4, mult + i, samples - i, lo, hi);
+}
+
+static int tsr_accurip_supported_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+/*
+ * AVX2 kernel, same as the SSE2 one with 8 samples per step.
+ *
+ */
+__attribute__((target("avx2")))
+static void tsr_accurip_sum_avx2(const uint8_t *pcm, uint32_t mult, long samples,
+		uint64_t *lo, uint64_t *hi)
+{
+	const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+	const __m256i eight = _mm256_set1_epi32(8);
+	__m256i m, s, even, odd, acclo, acchi;
+	uint64_t out[4];
+	long i;
+
+	m = _mm256_setr_epi32(mult, mult + 1, mult + 2, mult + 3, mult + 4,
+			mult + 5, mult + 6, mult + 7);
+	acclo = _mm256_setzero_si256();
+	acchi = _mm256_setzero_si256();
+
+	for (i = 0; i + 8 <= samples; i += 8)
+	{
+		s = _mm256_loadu_si256((const __m256i *) (pcm + i * 4));
+		even = _mm256_mul_epu32(s, m);
+		odd = _mm256_mul_epu32(_mm256_srli_epi64(s, 32), _mm256_srli_epi64(m, 32));
+		acclo = _mm256_add_epi64(acclo, _mm256_add_epi64(
+					_mm256_and_si256(even, mask), _mm256_and_si256(odd, mask)));
+		acchi = _mm256_add_epi64(acchi, _mm256_add_epi64(
+					_mm256_srli_epi64(even, 32), _mm256_srli_epi64(odd, 32)));
+		m = _mm256_add_epi32(m, eight);
+	}
+
+	_mm256_storeu_si256((__m256i *) out, acclo);
+	*lo += out[0] + out[1] + out[2] + out[3];
+	_mm256_storeu_si256((__m256i *) out, acchi);
+	*hi += out[0] + out[1] + out[2] + out[3];
+	tsr_accurip_sum_c(pcm + i * 4, mult + i, samples - i, lo, hi);
+}
+
+static int tsr_accurip_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+/*
+ * All kernels, the best one last.
+ *
+ */
+tsr_accurip_kernel_t tsr_accurip_kernels[] =
+{
+	{"c", tsr_accurip_sum_c, tsr_accurip_supported_c},
+#ifdef TSR_ACCURIP_X86
+	{"sse2", tsr_accurip_sum_sse2, tsr_accurip_supported_sse2},
+	{"avx2", tsr_accurip_sum_avx2, tsr_accurip_supported_avx2},
+#endif
+	{NULL, NULL, NULL}
+};
+
+static tsr_accurip_sum_t tsr_accurip_best = NULL;
+
+/*
+ * Sum up samples with the best supported kernel.
+ *
+ */
+static void tsr_accurip_sum(const uint8_t *pcm, uint32_t mult, long samples,
+		uint64_t *lo, uint64_t *hi)
+{
+	tsr_accurip_sum_t best;
+	int i;
+
+	best = __atomic_load_n(&tsr_accurip_best, __ATOMIC_RELAXED);
+
+	if (best == NULL)
+	{
+		for (i = 0; tsr_accurip_kernels[i].name != NULL; i++)
+		{
+			if (tsr_accurip_kernels[i].supported())
+			{
+				best = tsr_accurip_kernels[i].sum;
+			}
+		}
+
+		__atomic_store_n(&tsr_accurip_best, best, __ATOMIC_RELAXED);
+	}
+
+	best(pcm, mult, samples, lo, hi);
+}
+
+/*
+ * Sum of the decimal digits, for the cddb id.
+ *
+ */
+static int tsr_accurip_digitsum(long n)
+{
+	int sum = 0;
+
+	while (n > 0)
+	{
+		sum += n % 10;
+		n /= 10;
+	}
+
+	return sum;
+}
+
+/*
+ * Build the AccurateRip id of the toc, dBAR-<tracks>-<id1>-<id2>-<cddb id>.
+ *
+ */
+static void tsr_accurip_id(tsr_toc_t *toc, char *arid, size_t len)
+{
+	uint32_t id1 = 0, id2 = 0, cddb;
+	long n = 0;
+	int i;
+
+	for (i = 0; i < toc->numtracks; i++)
+	{
+		id1 += toc->firstsector[i];
+		id2 += ((toc->firstsector[i] > 0) ? toc->firstsector[i] : 1) * (i + 1);
+		n += tsr_accurip_digitsum((toc->firstsector[i] + 150) / 75);
+	}
+
+	id1 += toc->leadout;
+	id2 += ((toc->leadout > 0) ? toc->leadout : 1) * (toc->numtracks + 1);
+	cddb = ((n % 255) << 24) | toc->numtracks
+		| (((toc->leadout + 150) / 75 - (toc->firstsector[0] + 150) / 75) << 8);
+	snprintf(arid, len, "dBAR-%03i-%08x-%08x-%08x", toc->numtracks, id1, id2, cddb);
+}
+
+/*
+ * Load the entries of the database file for the disc, if there is one.
+ *
+ */
+static void tsr_accurip_load(tsr_accurip_t *accurip, char *dbfile)
+{
+	FILE *fp;
+	char *line = NULL;
+	size_t len = 0;
+	char arid[40];
+	tsr_accurip_entry_t entry;
+
+	if (dbfile == NULL || (fp = fopen(dbfile, "r")) == NULL)
+	{
+		return;
+	}
+
+	while (getline(&line, &len, fp) != -1)
+	{
+		if (sscanf(line, "%39s %d %d %x", arid, &entry.track, &entry.confidence,
+					&entry.checksum) != 4 || strcasecmp(arid, accurip->arid))
+		{
+			continue;
+		}
+
+		accurip->entries = (tsr_accurip_entry_t *) realloc(accurip->entries,
+				(accurip->numentries + 1) * sizeof(tsr_accurip_entry_t));
+
+		if (accurip->entries == NULL)
+		{
+			tsr_exit_error(__FILE__, __LINE__, errno);
+		}
+
+		accurip->entries[accurip->numentries++] = entry;
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+/*
+ * Create the checksums for the disc of the toc and look it up in dbfile,
+ * which may be NULL. offset is the read offset of the drive in samples.
+ *
+ */
+tsr_accurip_t *tsr_accurip_new(tsr_toc_t *toc, char *dbfile, int offset)
+{
+	tsr_accurip_t *accurip;
+
+	accurip = (tsr_accurip_t *) calloc(1, sizeof(tsr_accurip_t));
+
+	if (accurip == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	accurip->numtracks = toc->numtracks;
+	accurip->offset = offset;
+	tsr_accurip_id(toc, accurip->arid, sizeof(accurip->arid));
+	tsr_accurip_load(accurip, dbfile);
+
+	return accurip;
+}
+
+/*
+ * Number of sectors of the neighbouring track the read offset shifts into
+ * the window of a track, the ones before it for a negative offset, the
+ * ones after it otherwise. Nothing is needed beyond the first and the last
+ * track, the samples there are left out.
+ *
+ */
+int tsr_accurip_margin(tsr_accurip_t *accurip, int track)
+{
+	if ((accurip->offset < 0 && track == 0)
+			|| (accurip->offset > 0 && track == accurip->numtracks - 1))
+	{
+		return 0;
+	}
+
+	return (abs(accurip->offset) + CD_FRAMESAMPLES - 1) / CD_FRAMESAMPLES;
+}
+
+/*
+ * Start the checksums of a track with the given number of sectors, it may
+ * be started again to throw away what was read. With a negative offset the
+ * margin before the track is added first.
+ *
+ */
+void tsr_accurip_start(tsr_accurip_t *accurip, int track, long sectors)
+{
+	tsr_accurip_track_t *t = &accurip->tracks[track];
+
+	memset(t, 0, sizeof(tsr_accurip_track_t));
+	t->length = sectors * CD_FRAMESAMPLES;
+
+	if (accurip->offset < 0)
+	{
+		t->samples = -(long) tsr_accurip_margin(accurip, track) * CD_FRAMESAMPLES;
+	}
+
+	t->first = (track == 0) ? TSR_ACCURIP_SKIP - 1 : 1;
+	t->last = sectors * CD_FRAMESAMPLES;
+
+	if (track == accurip->numtracks - 1)
+	{
+		t->last -= TSR_ACCURIP_SKIP;
+	}
+}
+
+/*
+ * Add the next sectors of the track, or of the margin around it.
+ *
+ */
+void tsr_accurip_update(tsr_accurip_t *accurip, int track, const char *pcm,
+		int sectors)
+{
+	tsr_accurip_track_t *t = &accurip->tracks[track];
+	long mult, from, to;
+
+	/* multipliers of the samples to sum up */
+	mult = t->samples + 1 - accurip->offset;
+	from = (mult > t->first) ? mult : t->first;
+	to = mult + (long) sectors * CD_FRAMESAMPLES - 1;
+	to = (to < t->last) ? to : t->last;
+
+	if (from <= to)
+	{
+		tsr_accurip_sum((const uint8_t *) pcm + (from - mult) * 4,
+				from, to - from + 1, &t->lo, &t->hi);
+	}
+
+	if (t->samples >= 0 && t->samples < t->length)
+	{
+		t->crc32 = tsr_crc32(t->crc32, pcm, (size_t) sectors * CD_FRAMESIZE_RAW);
+	}
+
+	t->samples += (long) sectors * CD_FRAMESAMPLES;
+}
+
+/*
+ * Finish the checksums of the track and compare them to the database.
+ * Returns the confidence of the best matching entry, 0 for none.
+ *
+ */
+int tsr_accurip_finish(tsr_accurip_t *accurip, int track)
+{
+	tsr_accurip_track_t *t = &accurip->tracks[track];
+	tsr_accurip_entry_t *e;
+	int i;
+
+	t->v1 = (uint32_t) t->lo;
+	t->v2 = (uint32_t) (t->lo + t->hi);
+	t->confidence = 0;
+
+	for (i = 0; i < accurip->numentries; i++)
+	{
+		e = &accurip->entries[i];
+
+		if (e->track == track + 1 && e->confidence > t->confidence
+				&& (e->checksum == t->v1 || e->checksum == t->v2
+					|| e->checksum == t->crc32))
+		{
+			t->confidence = e->confidence;
+		}
+	}
+
+	return t->confidence;
+}
+
+/*
+ * Whether the database has entries for the disc.
+ *
+ */
+int tsr_accurip_known(tsr_accurip_t *accurip)
+{
+	return accurip->numentries > 0;
+}
+
+/*
+ * Print the checksums of all tracks read and whether they match.
+ *
+ */
+void tsr_accurip_print(FILE *fp, tsr_accurip_t *accurip)
+{
+	tsr_accurip_track_t *t;
+	int track;
+
+	fprintf(fp, "AccurateRip %s%s\n", accurip->arid,
+			tsr_accurip_known(accurip) ? "" : ", not in the database");
+
+	for (track = 0; track < accurip->numtracks; track++)
+	{
+		t = &accurip->tracks[track];
+
+		if (t->samples <= 0)
+		{
+			continue;
+		}
+
+		fprintf(fp, "Track %02i: v1 %08X, v2 %08X, crc32 %08X", track + 1,
+				t->v1, t->v2, t->crc32);
+
+		if (t->confidence > 0)
+		{
+			fprintf(fp, ", accurate (confidence %i)\n", t->confidence);
+		}
+		else if (tsr_accurip_known(accurip))
+		{
+			fprintf(fp, ", no match\n");
+		}
+		else
+		{
+			fprintf(fp, "\n");
+		}
+	}
+}
+
+/*
+ * Free the checksums.
+ *
+ */
+void tsr_accurip_free(tsr_accurip_t *accurip)
+{
+	free(accurip->entries);
+	free(accurip);
+}
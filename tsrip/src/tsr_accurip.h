@@ -0,0 +1,110 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_accurip.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_ACCURIP_H
+#define TSR_ACCURIP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Samples left out at the start of the first and the end of the last track,
+ * 5 sectors.
+ *
+ */
+#define TSR_ACCURIP_SKIP (5 * 588)
+
+/*
+ * Checksums of a track in the making. The multiplier of a sample is its
+ * position in the track corrected by the read offset, starting with 1, only
+ * multipliers from first to last are summed up. samples counts from the
+ * start of the track, it is negative while the sectors before it are added.
+ * v1 is the sum of the low halves of the products, v2 adds the high halves,
+ * too.
+ *
+ */
+typedef struct _tsr_accurip_track_t
+{
+	uint64_t lo;
+	uint64_t hi;
+	uint32_t crc32;
+	long samples;
+	long length;
+	long first;
+	long last;
+	uint32_t v1;
+	uint32_t v2;
+	int confidence;
+} tsr_accurip_track_t;
+
+typedef struct _tsr_accurip_entry_t
+{
+	int track;
+	int confidence;
+	uint32_t checksum;
+} tsr_accurip_entry_t;
+
+/*
+ * A disc with its AccurateRip id, the entries of the local database for it,
+ * the read offset of the drive in samples and the checksums of the tracks.
+ *
+ */
+typedef struct _tsr_accurip_t
+{
+	char arid[40];
+	int numtracks;
+	int offset;
+	tsr_accurip_entry_t *entries;
+	int numentries;
+	tsr_accurip_track_t tracks[TSR_MAXTRACKS];
+} tsr_accurip_t;
+
+typedef void (*tsr_accurip_sum_t)(const uint8_t *pcm, uint32_t mult, long samples,
+		uint64_t *lo, uint64_t *hi);
+
+typedef struct _tsr_accurip_kernel_t
+{
+	char *name;
+	tsr_accurip_sum_t sum;
+	int (*supported)(void);
+} tsr_accurip_kernel_t;
+
+extern tsr_accurip_kernel_t tsr_accurip_kernels[];
+
+tsr_accurip_t *tsr_accurip_new(tsr_toc_t *toc, char *dbfile, int offset);
+
+int tsr_accurip_margin(tsr_accurip_t *accurip, int track);
+
+void tsr_accurip_start(tsr_accurip_t *accurip, int track, long sectors);
+
+void tsr_accurip_update(tsr_accurip_t *accurip, int track, const char *pcm,
+		int sectors);
+
+int tsr_accurip_finish(tsr_accurip_t *accurip, int track);
+
+int tsr_accurip_known(tsr_accurip_t *accurip);
+
+void tsr_accurip_print(FILE *fp, tsr_accurip_t *accurip);
+
+void tsr_accurip_free(tsr_accurip_t *accurip);
+
+#endif
@@ -0,0 +1,901 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_bench.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Benchmarks for the encoding path, they don't need a drive.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <cdda_interface.h>
+
+#include "config.h"
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_pcm.h"
+#include "tsr_accurip.h"
+#include "tsr_loudness.h"
+#include "tsr_journal.h"
+#include "tsr_vorbis_track.h"
+#include "tsr_flac_track.h"
+#include "tsr_util.h"
+
+typedef struct _tsr_bench_t
+{
+	char *name;
+	int (*run)(double seconds);
+	char *description;
+} tsr_bench_t;
+
+typedef struct _tsr_bench_signal_t
+{
+	char *name;
+	void (*generate)(int16_t *samples, long numframes);
+} tsr_bench_signal_t;
+
+/*
+ * Settings for the encode benchmark, taken from the command line.
+ *
+ */
+tsr_cfg_t tsr_bench_cfg;
+double tsr_bench_duration = 60;
+
+/*
+ * Get monotonic time in seconds.
+ *
+ */
+double tsr_bench_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Allocate numsectors sectors of deterministic noise.
+ *
+ */
+int8_t *tsr_bench_noise(long numsectors)
+{
+	int8_t *pcm;
+	long i;
+	unsigned int seed = 1;
+
+	pcm = (int8_t *) malloc(numsectors * CD_FRAMESIZE_RAW);
+
+	if (pcm == NULL)
+	{
+		perror("tsr_bench_noise: malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < numsectors * CD_FRAMESIZE_RAW; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		pcm[i] = (int8_t) (seed >> 16);
+	}
+
+	return pcm;
+}
+
+/*
+ * Benchmark all pcm conversion kernels the cpu supports.
+ *
+ */
+int tsr_bench_pcm(double seconds)
+{
+	int8_t *pcm;
+	float *left, *right, *refleft, *refright;
+	long numsectors = 75 * 60, samples, i;
+	double start, elapsed;
+	int k, failed = 0;
+
+	samples = numsectors * CD_FRAMESAMPLES;
+	pcm = tsr_bench_noise(numsectors);
+	left = (float *) malloc(samples * sizeof(float));
+	right = (float *) malloc(samples * sizeof(float));
+	refleft = (float *) malloc(samples * sizeof(float));
+	refright = (float *) malloc(samples * sizeof(float));
+
+	if (!left || !right || !refleft || !refright)
+	{
+		perror("tsr_bench_pcm: malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	tsr_pcm_kernels[0].deinterleave(pcm, refleft, refright, samples);
+	printf("%-8s %16s %12s\n", "kernel", "samples/sec", "realtime");
+
+	for (k = 0; tsr_pcm_kernels[k].name != NULL; k++)
+	{
+		if (!tsr_pcm_kernels[k].supported())
+		{
+			printf("%-8s %16s\n", tsr_pcm_kernels[k].name, "unsupported");
+			continue;
+		}
+
+		start = tsr_bench_now();
+		elapsed = 0;
+		i = 0;
+
+		do
+		{
+			/* one sector per call, like the encoder does */
+			tsr_pcm_kernels[k].deinterleave(pcm + (i % numsectors) * CD_FRAMESIZE_RAW,
+					left + (i % numsectors) * CD_FRAMESAMPLES,
+					right + (i % numsectors) * CD_FRAMESAMPLES, CD_FRAMESAMPLES);
+			i++;
+
+			if (i % 64 == 0)
+			{
+				elapsed = tsr_bench_now() - start;
+			}
+		} while (i < numsectors || elapsed < seconds);
+
+		elapsed = tsr_bench_now() - start;
+
+		printf("%-8s %16.0f %11.0fx", tsr_pcm_kernels[k].name,
+				i * CD_FRAMESAMPLES / elapsed, i / 75. / elapsed);
+
+		if (memcmp(left, refleft, samples * sizeof(float))
+				|| memcmp(right, refright, samples * sizeof(float)))
+		{
+			printf(" MISMATCH");
+			failed = 1;
+		}
+
+		printf("\n");
+	}
+
+	free(pcm);
+	free(left);
+	free(right);
+	free(refleft);
+	free(refright);
+
+	return failed;
+}
+
+/*
+ * Benchmark all AccurateRip kernels the cpu supports, their sums must be
+ * the same as the ones of the first. They are checked at odd offsets,
+ * multipliers and lengths first, so every tail is taken.
+ *
+ */
+int tsr_bench_accurip(double seconds)
+{
+	int8_t *pcm;
+	long numsectors = 75 * 60, samples = numsectors * CD_FRAMESAMPLES - 8, i;
+	uint64_t lo, hi, reflo[17], refhi[17];
+	double start, elapsed;
+	int k, n, mismatch, failed = 0;
+
+	pcm = tsr_bench_noise(numsectors);
+	printf("%-8s %16s %12s\n", "kernel", "samples/sec", "realtime");
+
+	for (k = 0; tsr_accurip_kernels[k].name != NULL; k++)
+	{
+		if (!tsr_accurip_kernels[k].supported())
+		{
+			printf("%-8s %16s\n", tsr_accurip_kernels[k].name, "unsupported");
+			continue;
+		}
+
+		for (n = 0, mismatch = 0; n < 17; n++)
+		{
+			lo = 0;
+			hi = 0;
+			tsr_accurip_kernels[k].sum((const uint8_t *) pcm + 4 * n + 4,
+					2939 + 2 * n, samples - n, &lo, &hi);
+
+			if (k == 0)
+			{
+				reflo[n] = lo;
+				refhi[n] = hi;
+			}
+			else if (lo != reflo[n] || hi != refhi[n])
+			{
+				mismatch = 1;
+			}
+		}
+
+		lo = 0;
+		hi = 0;
+		start = tsr_bench_now();
+		elapsed = 0;
+		i = 0;
+
+		do
+		{
+			/* one sector per call, like the reader does */
+			tsr_accurip_kernels[k].sum((const uint8_t *) pcm + (i % numsectors)
+					* CD_FRAMESIZE_RAW, 1 + (i % numsectors) * CD_FRAMESAMPLES,
+					CD_FRAMESAMPLES, &lo, &hi);
+			i++;
+
+			if (i % 64 == 0)
+			{
+				elapsed = tsr_bench_now() - start;
+			}
+		} while (i < numsectors || elapsed < seconds);
+
+		elapsed = tsr_bench_now() - start;
+
+		printf("%-8s %16.0f %11.0fx%s\n", tsr_accurip_kernels[k].name,
+				i * CD_FRAMESAMPLES / elapsed, i / 75. / elapsed,
+				(mismatch) ? " MISMATCH" : "");
+		failed |= mismatch;
+	}
+
+	free(pcm);
+
+	return failed;
+}
+
+/*
+ * Benchmark all loudness filter kernels the cpu supports, their energy and
+ * peak must match the first one but for rounding.
+ *
+ */
+int tsr_bench_loudness(double seconds)
+{
+	int8_t *pcm;
+	tsr_loudness_t *loudness;
+	long numsectors = 75 * 60, i;
+	double start, elapsed, state[8], energy, peak, refenergy = 0, refpeak = 0;
+	int k, mismatch, failed = 0;
+
+	pcm = tsr_bench_noise(numsectors);
+	loudness = tsr_loudness_new(1);
+	printf("%-8s %16s %12s\n", "kernel", "samples/sec", "realtime");
+
+	for (k = 0; tsr_loudness_kernels[k].name != NULL; k++)
+	{
+		if (!tsr_loudness_kernels[k].supported())
+		{
+			printf("%-8s %16s\n", tsr_loudness_kernels[k].name, "unsupported");
+			continue;
+		}
+
+		memset(state, 0, sizeof(state));
+		energy = 0;
+		peak = 0;
+		mismatch = 0;
+		start = tsr_bench_now();
+		elapsed = 0;
+		i = 0;
+
+		do
+		{
+			/* one sector per call, like the reader does */
+			tsr_loudness_kernels[k].filter((int16_t *) (pcm + (i % numsectors) * CD_FRAMESIZE_RAW),
+					CD_FRAMESAMPLES, loudness->coef, state, &energy, &peak);
+			i++;
+
+			if (i == numsectors && k == 0)
+			{
+				refenergy = energy;
+				refpeak = peak;
+			}
+
+			if (i == numsectors && k > 0 && (fabs(energy - refenergy) > refenergy * 1e-9
+					|| peak != refpeak))
+			{
+				mismatch = 1;
+			}
+
+			if (i % 64 == 0)
+			{
+				elapsed = tsr_bench_now() - start;
+			}
+		} while (i < numsectors || elapsed < seconds);
+
+		elapsed = tsr_bench_now() - start;
+
+		printf("%-8s %16.0f %11.0fx%s\n", tsr_loudness_kernels[k].name,
+				i * CD_FRAMESAMPLES / elapsed, i / 75. / elapsed,
+				(mismatch) ? " MISMATCH" : "");
+		failed |= mismatch;
+	}
+
+	tsr_loudness_free(loudness);
+	free(pcm);
+
+	return failed;
+}
+
+/*
+ * Fill the sector with noise stamped with its number.
+ *
+ */
+void tsr_bench_sector(char *buf, int8_t *pcm, long numsectors, long sector)
+{
+	memcpy(buf, pcm + (sector % numsectors) * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
+	memcpy(buf, &sector, sizeof(sector));
+}
+
+/*
+ * Spool a track to a journal, interrupt the rip and read it again like the
+ * reader does: the spooled sectors are replayed and the rest is read and
+ * spooled, every sector has to come out once and in order.
+ *
+ */
+int tsr_bench_spool(double seconds)
+{
+	int8_t *pcm;
+	char buf[CD_FRAMESIZE_RAW], expected[CD_FRAMESIZE_RAW], dir[] = "/tmp/tsrip-bench-XXXXXX";
+	char *spool, *file;
+	long numsectors = 75 * 60, more = 75 * 30, sector, replayed = 0;
+	double start, elapsed;
+	int pass, failed = 0;
+	tsr_journal_t *journal;
+	tsr_toc_t toc;
+	tsr_cfg_t cfg;
+
+	if (mkdtemp(dir) == NULL)
+	{
+		perror("tsr_bench_spool: mkdtemp");
+		exit(EXIT_FAILURE);
+	}
+
+	tsr_cfg_defaults(&cfg);
+	tsr_cfg_set_encoder(&cfg, "flac");
+	tsr_cfg_outputs(&cfg);
+	tsr_cfg_set_journal(&cfg, dir);
+	tsr_cfg_set_spool(&cfg, "on");
+	memset(&toc, 0, sizeof(toc));
+	toc.numtracks = 1;
+	toc.lastsector[0] = numsectors + more - 1;
+	toc.leadout = numsectors + more;
+	pcm = tsr_bench_noise(numsectors);
+	printf("%-8s %12s %12s %12s\n", "pass", "sectors", "sectors/sec", "realtime");
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		journal = tsr_journal_open(&toc, &cfg);
+
+		if (journal->prefix == NULL)
+		{
+			return 1;
+		}
+
+		if (tsr_journal_spool_open(journal, 0) != ((pass == 0) ? 0 : numsectors))
+		{
+			failed = 1;
+		}
+
+		start = tsr_bench_now();
+
+		/* the first pass is interrupted after numsectors sectors */
+		for (sector = 0; sector < numsectors + pass * more; sector++)
+		{
+			tsr_bench_sector(expected, pcm, numsectors, sector);
+
+			if (tsr_journal_spool_read(journal, sector, buf))
+			{
+				replayed++;
+			}
+			else
+			{
+				memcpy(buf, expected, CD_FRAMESIZE_RAW);
+				tsr_journal_spool_write(journal, sector, buf, 0);
+			}
+
+			if (memcmp(buf, expected, CD_FRAMESIZE_RAW))
+			{
+				failed = 1;
+			}
+		}
+
+		tsr_journal_spool_close(journal);
+		elapsed = tsr_bench_now() - start;
+		printf("%-8s %12li %12.0f %11.0fx\n", (pass == 0) ? "spool" : "replay",
+				sector, sector / elapsed, sector / 75. / elapsed);
+		asprintf(&spool, "%s.01.pcm", journal->prefix);
+		file = strdup(journal->file);
+		tsr_journal_finish(journal, 1);
+	}
+
+	if (replayed != numsectors)
+	{
+		failed = 1;
+	}
+
+	if (failed)
+	{
+		printf("MISMATCH\n");
+	}
+
+	unlink(spool);
+	unlink(file);
+	rmdir(dir);
+	free(spool);
+	free(file);
+	free(pcm);
+
+	return failed;
+}
+
+/*
+ * Create a metainfo with a single dummy track.
+ *
+ */
+tsr_metainfo_t *tsr_bench_metainfo()
+{
+	tsr_metainfo_t *metainfo;
+
+	metainfo = tsr_metainfo_new(1);
+	metainfo->album = tsr_metainfo_str(metainfo, "tsrip-bench");
+	metainfo->trackinfos[0].title = tsr_metainfo_str(metainfo, "tsrip-bench");
+	metainfo->trackinfos[0].artist = tsr_metainfo_str(metainfo, "tsrip-bench");
+
+	return metainfo;
+}
+
+/*
+ * Benchmark the vorbis encoder with different numbers of sectors per
+ * encode call to show the per call overhead.
+ *
+ */
+int tsr_bench_batch(double seconds)
+{
+	int batches[] = {1, 8, 32, 64, 128, 256, 0};
+	int8_t *pcm;
+	long numsectors = 75 * 60, i, pos;
+	double start, elapsed, usec, usec1 = 0;
+	int b;
+	tsr_metainfo_t *metainfo;
+	tsr_trackfile_t *trackfile;
+	tsr_cfg_t cfg;
+
+	tsr_cfg_defaults(&cfg);
+	pcm = tsr_bench_noise(numsectors);
+	metainfo = tsr_bench_metainfo();
+	printf("%-8s %12s %12s %12s\n", "batch", "sectors/sec", "usec/sector",
+			"saved");
+
+	for (b = 0; batches[b]; b++)
+	{
+		trackfile = tsr_vorbisfile_init(0, "/dev/null", metainfo, 0.4, &cfg);
+		start = tsr_bench_now();
+		i = 0;
+
+		pos = 0;
+
+		do
+		{
+			if (pos + batches[b] > numsectors)
+			{
+				pos = 0;
+			}
+
+			trackfile->encode(trackfile, pcm + pos * CD_FRAMESIZE_RAW, batches[b]);
+			pos += batches[b];
+			i += batches[b];
+			elapsed = tsr_bench_now() - start;
+		} while (elapsed < seconds);
+
+		trackfile->finish(trackfile);
+		usec = elapsed * 1e6 / i;
+
+		if (b == 0)
+		{
+			usec1 = usec;
+		}
+
+		printf("%-8i %12.0f %12.2f %12.2f\n", batches[b], i / elapsed, usec,
+				usec1 - usec);
+	}
+
+	tsr_metainfo_free(metainfo);
+	free(pcm);
+
+	return 0;
+}
+
+/*
+ * A logarithmic sine sweep from 20 Hz to 20 kHz at -6 dB, the right channel
+ * runs a quarter period behind.
+ *
+ */
+void tsr_bench_sweep(int16_t *samples, long numframes)
+{
+	double phase = 0, freq, k;
+	long i;
+
+	k = log(20000. / 20.) / numframes;
+
+	for (i = 0; i < numframes; i++)
+	{
+		freq = 20. * exp(k * i);
+		phase += 2 * M_PI * freq / 44100.;
+		samples[i * 2] = (int16_t) (16383 * sin(phase));
+		samples[i * 2 + 1] = (int16_t) (16383 * cos(phase));
+	}
+}
+
+/*
+ * White noise at full scale.
+ *
+ */
+void tsr_bench_white(int16_t *samples, long numframes)
+{
+	unsigned int seed = 1;
+	long i;
+
+	for (i = 0; i < numframes * 2; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		samples[i] = (int16_t) (seed >> 8);
+	}
+}
+
+/*
+ * Digital silence.
+ *
+ */
+void tsr_bench_silence(int16_t *samples, long numframes)
+{
+	memset(samples, 0, numframes * 4);
+}
+
+/*
+ * A loudness war master: chords with a beat and some noise, driven far into
+ * clipping.
+ *
+ */
+void tsr_bench_loud(int16_t *samples, long numframes)
+{
+	static const double freqs[] = {55, 110, 220, 277.18, 329.63, 440, 3520};
+	unsigned int seed = 7;
+	double t, v, beat;
+	long i;
+	int c, f;
+
+	for (i = 0; i < numframes; i++)
+	{
+		t = i / 44100.;
+		beat = (fmod(t, 0.5) < 0.1) ? 1.0 : 0.4;
+
+		for (c = 0; c < 2; c++)
+		{
+			v = 0;
+
+			for (f = 0; f < 7; f++)
+			{
+				v += sin(2 * M_PI * freqs[f] * t + c * f) / 7;
+			}
+
+			seed = seed * 1103515245 + 12345;
+			v = 4 * (beat * v + ((int) (seed >> 16) % 2000 - 1000) / 10000.);
+			v = (v > 1) ? 1 : (v < -1) ? -1 : v;
+			samples[i * 2 + c] = (int16_t) (32767 * v);
+		}
+	}
+}
+
+tsr_bench_signal_t tsr_bench_signals[] =
+{
+	{"sweep", tsr_bench_sweep},
+	{"noise", tsr_bench_white},
+	{"silence", tsr_bench_silence},
+	{"loud", tsr_bench_loud},
+	{NULL, NULL}
+};
+
+/*
+ * Reset the peak resident set size of the process, so it can be measured
+ * for each run. Only works on linux, elsewhere the peak of the whole
+ * process is reported.
+ *
+ */
+void tsr_bench_reset_rss()
+{
+	int fd;
+
+	fd = open("/proc/self/clear_refs", O_WRONLY);
+
+	if (fd != -1)
+	{
+		if (write(fd, "5", 1) != 1)
+		{
+			/* the kernel is too old, use the process peak */
+		}
+
+		close(fd);
+	}
+}
+
+/*
+ * Get the peak resident set size in kilobytes.
+ *
+ */
+long tsr_bench_peak_rss()
+{
+	struct rusage usage;
+	FILE *status_s;
+	char line[128];
+	long kb = -1;
+
+	status_s = fopen("/proc/self/status", "r");
+
+	if (status_s != NULL)
+	{
+		while (fgets(line, sizeof(line), status_s))
+		{
+			if (sscanf(line, "VmHWM: %li", &kb) == 1)
+			{
+				break;
+			}
+		}
+
+		fclose(status_s);
+	}
+
+	if (kb == -1 && getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		kb = usage.ru_maxrss;
+	}
+
+	return kb;
+}
+
+/*
+ * Encode the synthetic signals with every configured output and quality,
+ * a track of --duration seconds each.
+ *
+ */
+int tsr_bench_encode(double seconds)
+{
+	int8_t *pcm;
+	long numsectors, i;
+	double start, elapsed;
+	int n, o, sig, fd;
+	char filename[] = "/tmp/tsrip-bench-XXXXXX";
+	struct stat st;
+	tsr_metainfo_t *metainfo;
+	tsr_trackfile_t *trackfile;
+	tsr_output_t *output;
+	tsr_cfg_t *cfg = &tsr_bench_cfg;
+
+	numsectors = (long) (tsr_bench_duration * 75);
+	numsectors = (numsectors > 0) ? numsectors : 1;
+	pcm = (int8_t *) malloc(numsectors * CD_FRAMESIZE_RAW);
+	fd = mkstemp(filename);
+
+	if (pcm == NULL || fd == -1)
+	{
+		perror("tsr_bench_encode");
+		exit(EXIT_FAILURE);
+	}
+
+	close(fd);
+	metainfo = tsr_bench_metainfo();
+	printf("%-8s %-6s %12s %10s %12s %10s\n", "signal", "output", "sectors/sec",
+			"realtime", "bytes", "peak kB");
+
+	for (sig = 0; tsr_bench_signals[sig].name != NULL; sig++)
+	{
+		tsr_bench_signals[sig].generate((int16_t *) pcm, numsectors * CD_FRAMESAMPLES);
+
+		for (o = 0; o < cfg->numoutputs; o++)
+		{
+			output = &cfg->outputs[o];
+			tsr_bench_reset_rss();
+			start = tsr_bench_now();
+
+			if (output->enctype == CFG_TYPE_FLAC)
+			{
+				trackfile = tsr_flacfile_init(0, filename, metainfo, cfg);
+			}
+			else
+			{
+				trackfile = tsr_vorbisfile_init(0, filename, metainfo,
+						output->quality, cfg);
+			}
+
+			for (i = 0; i < numsectors; i += n)
+			{
+				n = (numsectors - i < cfg->batch) ? numsectors - i : cfg->batch;
+				trackfile->encode(trackfile, pcm + i * CD_FRAMESIZE_RAW, n);
+			}
+
+			trackfile->finish(trackfile);
+			elapsed = tsr_bench_now() - start;
+
+			if (stat(filename, &st) == -1)
+			{
+				st.st_size = 0;
+			}
+
+			printf("%-8s %-6s %12.0f %9.1fx %12lli %10li\n", tsr_bench_signals[sig].name,
+					output->name, numsectors / elapsed, numsectors / 75. / elapsed,
+					(long long) st.st_size, tsr_bench_peak_rss());
+		}
+	}
+
+	unlink(filename);
+	tsr_metainfo_free(metainfo);
+	free(pcm);
+
+	return 0;
+}
+
+tsr_bench_t tsr_benches[] =
+{
+	{"pcm", tsr_bench_pcm, "Sample conversion kernels"},
+	{"accurip", tsr_bench_accurip, "AccurateRip checksum kernels"},
+	{"loudness", tsr_bench_loudness, "Loudness filter kernels"},
+	{"spool", tsr_bench_spool, "Spooling a track to the journal and replaying it"},
+	{"batch", tsr_bench_batch, "Vorbis encoding with different batch sizes"},
+	{"encode", tsr_bench_encode, "Encoding synthetic signals for each output"},
+	{NULL, NULL, NULL}
+};
+
+/*
+ * Print usage.
+ *
+ */
+void tsr_bench_print_usage()
+{
+	int i;
+
+	printf("Usage: tsrip-bench [options] <benchmark>...\n");
+	printf("	-s --seconds <n>		Run each benchmark for <n> seconds\n"
+	       "	-d --duration <n>		Seconds of audio to encode (encode)\n"
+	       "	-e --encoder <vorbis,flac>	The encoders to use (encode)\n"
+	       "	   --vorbisquality <1-10,...>	The vorbis qualities to use (encode)\n"
+	       "	   --flaclevel <0-8>		The flac compression level (encode)\n"
+	       "	   --batch <sectors>		Sectors per encode call (encode)\n"
+	       "	   --pagefill <bytes>		Target size of ogg pages (encode)\n"
+	       "	   --writebuffer <kbytes>	Size of the output buffer (encode)\n"
+	       "	-h --help			Print help\n"
+	       "Benchmarks:\n");
+
+	for (i = 0; tsr_benches[i].name != NULL; i++)
+	{
+		printf("	%-24s%s\n", tsr_benches[i].name, tsr_benches[i].description);
+	}
+}
+
+/*
+ * Main program.
+ *
+ */
+int main(int argc, char **argv)
+{
+	int option, loption, i, ok = 1, failed = 0;
+	double seconds = 1;
+	struct option lopts[] =
+	{
+		{"seconds", 1, 0, 's'},
+		{"duration", 1, 0, 'd'},
+		{"encoder", 1, 0, 'e'},
+		{"vorbisquality", 1, 0, 0},
+		{"flaclevel", 1, 0, 0},
+		{"batch", 1, 0, 0},
+		{"pagefill", 1, 0, 0},
+		{"writebuffer", 1, 0, 0},
+		{"help", 0, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	tsr_cfg_defaults(&tsr_bench_cfg);
+	tsr_cfg_set_encoder(&tsr_bench_cfg, "vorbis,flac");
+	tsr_cfg_set_vorbisqualiy(&tsr_bench_cfg, "1,4,8");
+
+	while ((option = getopt_long(argc, argv, "s:d:e:h", lopts, &loption)) != -1)
+	{
+		switch (option)
+		{
+			case 0:
+				if (!strcmp(lopts[loption].name, "vorbisquality"))
+				{
+					ok = tsr_cfg_set_vorbisqualiy(&tsr_bench_cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "flaclevel"))
+				{
+					ok = tsr_cfg_set_flaclevel(&tsr_bench_cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "batch"))
+				{
+					ok = tsr_cfg_set_batch(&tsr_bench_cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "pagefill"))
+				{
+					ok = tsr_cfg_set_pagefill(&tsr_bench_cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "writebuffer"))
+				{
+					ok = tsr_cfg_set_writebuffer(&tsr_bench_cfg, optarg);
+				}
+
+				if (!ok)
+				{
+					fprintf(stderr, "Invalid value %s for --%s.\n", optarg,
+							lopts[loption].name);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 's':
+				seconds = atof(optarg);
+				break;
+			case 'd':
+				tsr_bench_duration = atof(optarg);
+				break;
+			case 'e':
+				if (!tsr_cfg_set_encoder(&tsr_bench_cfg, optarg))
+				{
+					fprintf(stderr, "Invalid encoder %s.\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			default:
+				tsr_bench_print_usage();
+				exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (optind == argc)
+	{
+		tsr_bench_print_usage();
+		exit(EXIT_FAILURE);
+	}
+
+	tsr_cfg_outputs(&tsr_bench_cfg);
+
+	for (; optind < argc; optind++)
+	{
+		for (i = 0; tsr_benches[i].name != NULL; i++)
+		{
+			if (!strcmp(tsr_benches[i].name, argv[optind]))
+			{
+				break;
+			}
+		}
+
+		if (tsr_benches[i].name == NULL)
+		{
+			fprintf(stderr, "Unknown benchmark %s.\n", argv[optind]);
+			exit(EXIT_FAILURE);
+		}
+
+		printf("== %s\n", tsr_benches[i].name);
+		failed |= tsr_benches[i].run(seconds);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
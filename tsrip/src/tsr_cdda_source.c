@@ -0,0 +1,475 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_cdda_source.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Source reading a cd drive with cdparanoia.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <cdda_interface.h>
+#include <cdda_paranoia.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_source.h"
+#include "tsr_cdda_source.h"
+#include "tsr_toc.h"
+#include "tsr_crc32.h"
+#include "tsr_util.h"
+
+/*
+ * The source reading in this thread, the paranoia callback has no argument
+ * to pass it.
+ *
+ */
+static __thread tsr_cdda_source_t *tsr_cdda_reading;
+
+/*
+ * Callback of paranoia_read(), the position is in 16 bit words.
+ *
+ */
+static void tsr_cdda_source_cb(long inpos, int function)
+{
+	tsr_riplog_event(tsr_cdda_reading->source.riplog, inpos / CD_FRAMEWORDS,
+			function);
+}
+
+/*
+ * Sectors judged at once by the speed control, 2 seconds of audio. A
+ * window with TSR_SPEED_ERRORS errors halves the speed, TSR_SPEED_CLEAN
+ * clean windows in a row double it.
+ *
+ */
+#define TSR_SPEED_WINDOW 150
+#define TSR_SPEED_ERRORS 4
+#define TSR_SPEED_CLEAN 15
+
+/*
+ * Set the read speed of the drive, -1 is the fastest.
+ *
+ */
+static void tsr_cdda_source_speed(tsr_source_t *source, int speed)
+{
+	tsr_cdda_source_t *cdda = (tsr_cdda_source_t *) source;
+
+	cdda_speed_set(cdda->drive, speed);
+	cdda->speed = speed;
+	tsr_riplog_speed(source->riplog, speed);
+}
+
+/*
+ * Adapt the speed of the drive to the errors paranoia had to deal with in
+ * the last window: slow down where they cluster, speed up again after a
+ * clean stretch.
+ *
+ */
+static void tsr_cdda_source_adapt(tsr_cdda_source_t *cdda, long sector)
+{
+	long errors;
+	int speed = cdda->speed;
+
+	if (cdda->speedmin >= cdda->speedmax || speed <= 0
+			|| sector < cdda->window + TSR_SPEED_WINDOW)
+	{
+		return;
+	}
+
+	errors = tsr_riplog_errors(cdda->source.riplog);
+
+	if (errors - cdda->errors >= TSR_SPEED_ERRORS)
+	{
+		speed = (speed / 2 > cdda->speedmin) ? speed / 2 : cdda->speedmin;
+		cdda->clean = 0;
+	}
+	else if (errors > cdda->errors)
+	{
+		cdda->clean = 0;
+	}
+	else if (++cdda->clean >= TSR_SPEED_CLEAN)
+	{
+		speed = (speed * 2 < cdda->speedmax) ? speed * 2 : cdda->speedmax;
+		cdda->clean = 0;
+	}
+
+	cdda->window = sector;
+	cdda->errors = errors;
+
+	if (speed != cdda->speed)
+	{
+		tsr_cdda_source_speed(&cdda->source, speed);
+	}
+}
+
+/*
+ * Sectors read at once by test and copy, 2 seconds of audio.
+ *
+ */
+#define TSR_TESTCOPY_BLOCK 150
+
+/*
+ * Read count sectors into buf without paranoia, in chunks the drive can
+ * handle. Returns the number of sectors read before the first error.
+ *
+ */
+static long tsr_cdda_source_raw(tsr_cdda_source_t *cdda, char *buf, long sector,
+		long count)
+{
+	long done = 0, n, chunk;
+
+	chunk = (cdda->drive->nsectors > 0) ? cdda->drive->nsectors : 1;
+
+	while (done < count)
+	{
+		n = cdda_read(cdda->drive, buf + done * CD_FRAMESIZE_RAW, sector + done,
+				(count - done < chunk) ? count - done : chunk);
+
+		if (n <= 0)
+		{
+			break;
+		}
+
+		done += n;
+	}
+
+	return done;
+}
+
+/*
+ * The track of the given sector, -1 if it's not in a track.
+ *
+ */
+static int tsr_cdda_source_track(tsr_cdda_source_t *cdda, long sector)
+{
+	tsr_toc_t *toc = &cdda->source.toc;
+	int track;
+
+	for (track = 0; track < toc->numtracks; track++)
+	{
+		if (sector >= toc->firstsector[track] && sector <= toc->lastsector[track])
+		{
+			return track;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Test pass of test and copy: read the whole track without paranoia and
+ * keep the crc of every sector. Sectors the drive fails on are marked bad.
+ *
+ */
+static void tsr_cdda_source_test(tsr_cdda_source_t *cdda, int track)
+{
+	long fsec, lsec, s, n, got, i;
+
+	fsec = cdda->source.toc.firstsector[track];
+	lsec = cdda->source.toc.lastsector[track];
+	cdda->testcrcs = (uint32_t *) realloc(cdda->testcrcs,
+			(lsec - fsec + 1) * sizeof(uint32_t));
+	cdda->testbad = (char *) realloc(cdda->testbad, lsec - fsec + 1);
+
+	if (cdda->testcrcs == NULL || cdda->testbad == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	cdda->testcrc = 0;
+
+	for (s = fsec; s <= lsec; s += n)
+	{
+		n = (lsec - s + 1 < TSR_TESTCOPY_BLOCK) ? lsec - s + 1 : TSR_TESTCOPY_BLOCK;
+		got = tsr_cdda_source_raw(cdda, cdda->block, s, n);
+
+		for (i = 0; i < got; i++)
+		{
+			cdda->testcrcs[s - fsec + i] = tsr_crc32(0,
+					cdda->block + i * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
+			cdda->testbad[s - fsec + i] = 0;
+			cdda->testcrc = tsr_crc32(cdda->testcrc,
+					cdda->block + i * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
+		}
+
+		if (got < n)
+		{
+			/* skip the bad sector, the copy pass lets paranoia read it */
+			cdda->testbad[s - fsec + got] = 1;
+			tsr_riplog_event(cdda->source.riplog, s + got, TSR_RIPLOG_READERR);
+			n = got + 1;
+		}
+	}
+
+	cdda->tested = track;
+	cdda->copycrc = 0;
+	cdda->copied = fsec;
+	cdda->blockfirst = 1;
+	cdda->blocklast = 0;
+}
+
+/*
+ * Copy pass of test and copy: read the block starting at sector without
+ * paranoia and compare it to the test pass. Only the sectors which don't
+ * match are read again by paranoia. Returns 0 if paranoia failed, too.
+ *
+ */
+static int tsr_cdda_source_copy(tsr_cdda_source_t *cdda, long sector)
+{
+	long lsec, n, got, i, offset;
+	int track, seek = 1;
+	int16_t *read_buffer;
+	char ok[TSR_TESTCOPY_BLOCK];
+	char *buf;
+
+	if ((track = tsr_cdda_source_track(cdda, sector)) == -1)
+	{
+		return 0;
+	}
+
+	if (track != cdda->tested)
+	{
+		tsr_cdda_source_test(cdda, track);
+	}
+
+	lsec = cdda->source.toc.lastsector[track];
+	offset = sector - cdda->source.toc.firstsector[track];
+	n = (lsec - sector + 1 < TSR_TESTCOPY_BLOCK) ? lsec - sector + 1 : TSR_TESTCOPY_BLOCK;
+
+	for (i = 0; i < n; i += got + 1)
+	{
+		got = tsr_cdda_source_raw(cdda, cdda->block + i * CD_FRAMESIZE_RAW,
+				sector + i, n - i);
+		memset(ok + i, 1, got);
+
+		if (i + got < n)
+		{
+			ok[i + got] = 0;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		buf = cdda->block + i * CD_FRAMESIZE_RAW;
+
+		if (ok[i] && !cdda->testbad[offset + i]
+				&& tsr_crc32(0, buf, CD_FRAMESIZE_RAW) == cdda->testcrcs[offset + i])
+		{
+			seek = 1;
+			continue;
+		}
+
+		if (seek)
+		{
+			paranoia_seek(cdda->paranoia, sector + i, SEEK_SET);
+			seek = 0;
+		}
+
+		tsr_cdda_reading = cdda;
+		read_buffer = paranoia_read(cdda->paranoia, tsr_cdda_source_cb);
+
+		if (read_buffer == NULL)
+		{
+			return 0;
+		}
+
+		memcpy(buf, read_buffer, CD_FRAMESIZE_RAW);
+		tsr_riplog_reread(cdda->source.riplog, sector + i);
+	}
+
+	cdda->blockfirst = sector;
+	cdda->blocklast = sector + n - 1;
+
+	if (sector == cdda->copied)
+	{
+		cdda->copycrc = tsr_crc32(cdda->copycrc, cdda->block, n * CD_FRAMESIZE_RAW);
+		cdda->copied += n;
+
+		if (cdda->copied > lsec)
+		{
+			tsr_riplog_crcs(cdda->source.riplog, track, cdda->testcrc,
+					cdda->copycrc);
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Read a sector with test and copy.
+ *
+ */
+static char *tsr_cdda_source_testcopy(tsr_cdda_source_t *cdda, long sector)
+{
+	if ((sector < cdda->blockfirst || sector > cdda->blocklast)
+			&& !tsr_cdda_source_copy(cdda, sector))
+	{
+		return NULL;
+	}
+
+	return cdda->block + (sector - cdda->blockfirst) * CD_FRAMESIZE_RAW;
+}
+
+/*
+ * Read a sector, paranoia only seeks if the sectors are not read in order.
+ *
+ */
+static char *tsr_cdda_source_read(tsr_source_t *source, long sector)
+{
+	tsr_cdda_source_t *cdda = (tsr_cdda_source_t *) source;
+	char *read_buffer;
+
+	if (cdda->testcopy && !cdda->fast)
+	{
+		read_buffer = tsr_cdda_source_testcopy(cdda, sector);
+		tsr_riplog_delivered(source->riplog);
+		tsr_cdda_source_adapt(cdda, sector);
+
+		return read_buffer;
+	}
+
+	if (sector != cdda->cursor)
+	{
+		paranoia_seek(cdda->paranoia, sector, SEEK_SET);
+		tsr_riplog_seek(source->riplog);
+		cdda->window = sector;
+	}
+
+	tsr_cdda_reading = cdda;
+	read_buffer = (char *) paranoia_read(cdda->paranoia, tsr_cdda_source_cb);
+	tsr_riplog_delivered(source->riplog);
+	tsr_cdda_source_adapt(cdda, sector);
+	cdda->cursor = sector + 1;
+
+	return read_buffer;
+}
+
+/*
+ * Switch paranoia and test and copy off while the checksums of the tracks
+ * are checked against a database.
+ *
+ */
+static void tsr_cdda_source_fast(tsr_source_t *source, int fast)
+{
+	tsr_cdda_source_t *cdda = (tsr_cdda_source_t *) source;
+
+	cdda->fast = fast;
+	paranoia_modeset(cdda->paranoia, (fast) ? PARANOIA_MODE_DISABLE : cdda->mode);
+}
+
+/*
+ * Free paranoia and close the drive.
+ *
+ */
+static void tsr_cdda_source_close(tsr_source_t *source)
+{
+	tsr_cdda_source_t *cdda = (tsr_cdda_source_t *) source;
+
+	paranoia_free(cdda->paranoia);
+	cdda_close(cdda->drive);
+	tsr_riplog_free(source->riplog);
+	free(cdda->testcrcs);
+	free(cdda->testbad);
+	free(cdda->block);
+	free(cdda);
+}
+
+/*
+ * Open the cd drive, the first one found if device is NULL. Returns NULL
+ * if there is no drive or no disc.
+ *
+ */
+tsr_source_t *tsr_cdda_source_open(char *device, tsr_cfg_t *cfg)
+{
+	tsr_cdda_source_t *cdda;
+	cdrom_drive *drive;
+
+	drive = (device) ?
+		cdda_identify(device, CDDA_MESSAGE_FORGETIT, 0) : 
+		cdda_find_a_cdrom(CDDA_MESSAGE_FORGETIT, 0);
+		
+	if (drive == NULL)
+	{
+		errno = ENODEV;
+
+		return NULL;
+	}
+
+	/* an empty tray is polled by the daemon, the drive must not leak */
+	if (cdda_open(drive))
+	{
+		cdda_close(drive);
+		errno = ENODEV;
+
+		return NULL;
+	}
+
+	cdda = (tsr_cdda_source_t *) malloc(sizeof(tsr_cdda_source_t));
+
+	if (cdda == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	cdda->drive = drive;
+	cdda->paranoia = paranoia_init(drive);
+	paranoia_modeset(cdda->paranoia, cfg->paranoiamode);
+	cdda->mode = cfg->paranoiamode;
+	cdda->fast = 0;
+	cdda->cursor = -1;
+	cdda->source.name = drive->ioctl_device_name;
+	cdda->source.device = drive->ioctl_device_name;
+	tsr_toc_read(drive, &cdda->source.toc);
+	cdda->source.riplog = tsr_riplog_new(&cdda->source.toc);
+	cdda->source.read = tsr_cdda_source_read;
+	cdda->source.speed = tsr_cdda_source_speed;
+	cdda->source.fast = tsr_cdda_source_fast;
+	cdda->source.close = tsr_cdda_source_close;
+	cdda->speedmax = cfg->speedmax;
+	cdda->speedmin = (cfg->speedmin < cfg->speedmax) ? cfg->speedmin : cfg->speedmax;
+	cdda->window = 0;
+	cdda->errors = 0;
+	cdda->clean = 0;
+	cdda->testcopy = cfg->testcopy;
+	cdda->tested = -1;
+	cdda->testcrcs = NULL;
+	cdda->testbad = NULL;
+	cdda->block = NULL;
+	cdda->blockfirst = 1;
+	cdda->blocklast = 0;
+
+	if (cdda->testcopy)
+	{
+		cdda->block = (char *) malloc(TSR_TESTCOPY_BLOCK * CD_FRAMESIZE_RAW);
+
+		if (cdda->block == NULL)
+		{
+			tsr_exit_error(__FILE__, __LINE__, errno);
+		}
+	}
+
+	tsr_cdda_source_speed(&cdda->source, cdda->speedmax);
+
+	return &cdda->source;
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_cdda_source.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <cdda_interface.h>
+#include <cdda_paranoia.h>
+
+typedef struct _tsr_cdda_source_t
+{
+	tsr_source_t source;
+	cdrom_drive *drive;
+	cdrom_paranoia *paranoia;
+	long cursor;
+	int speed;
+	int speedmin;
+	int speedmax;
+	long window;
+	long errors;
+	int clean;
+	int mode;
+	int testcopy;
+	int fast;
+	int tested;
+	uint32_t *testcrcs;
+	char *testbad;
+	uint32_t testcrc;
+	uint32_t copycrc;
+	long copied;
+	char *block;
+	long blockfirst;
+	long blocklast;
+} tsr_cdda_source_t;
+
+tsr_source_t *tsr_cdda_source_open(char *device, tsr_cfg_t *cfg);
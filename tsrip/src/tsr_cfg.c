@@ -82,7 +82,12 @@ int tsr_cfg_set_stripspaces(tsr_cfg_t *cfg, char *val)
  */
 int tsr_cfg_set_paranoiamode(tsr_cfg_t *cfg, char *val)
 {
-	if (!strcmp(val, "off"))
+	if (!strcmp(val, "testcopy"))
+	{
+		/* paranoia only rereads the sectors which differ */
+		cfg->paranoiamode = PARANOIA_MODE_FULL;
+	}
+	else if (!strcmp(val, "off"))
 	{
 		cfg->paranoiamode = PARANOIA_MODE_DISABLE;
 	}
@@ -119,24 +124,363 @@ int tsr_cfg_set_paranoiamode(tsr_cfg_t *cfg, char *val)
 		return 0;
 	}
 
+	cfg->testcopy = !strcmp(val, "testcopy");
+
 	return 1;
 }
 
 /*
- * Set vorbis quality.
+ * Set vorbis quality, a comma separated list like "4,6" encodes every track
+ * once for each quality.
  *
  */
 int tsr_cfg_set_vorbisqualiy(tsr_cfg_t *cfg, char *val)
 {
-	int iquality;
-	float fquality;
+	float qualities[CFG_MAXQUALITIES];
+	int iquality, num = 0;
+	char *end;
+
+	while (1)
+	{
+		iquality = strtol(val, &end, 10);
+
+		if (end == val || iquality <= 0 || iquality > 10 || num == CFG_MAXQUALITIES)
+		{
+			return 0;
+		}
+
+		qualities[num++] = 0.1f * iquality;
+
+		if (*end == '\0')
+		{
+			break;
+		}
+		else if (*end != ',')
+		{
+			return 0;
+		}
+
+		val = end + 1;
+	}
+
+	memcpy(cfg->vorbisqualities, qualities, num * sizeof(float));
+	cfg->numqualities = num;
+
+	return 1;
+}
+
+/*
+ * Set the encoders to use, a comma separated list like "vorbis,flac"
+ * encodes every track with each of them.
+ *
+ */
+int tsr_cfg_set_encoder(tsr_cfg_t *cfg, char *val)
+{
+	char enctype = 0;
+	size_t len;
+
+	while (1)
+	{
+		len = strcspn(val, ",");
+
+		if (len == 6 && !strncmp(val, "vorbis", len))
+		{
+			enctype |= CFG_TYPE_VORBIS;
+		}
+		else if (len == 4 && !strncmp(val, "flac", len))
+		{
+			enctype |= CFG_TYPE_FLAC;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (val[len] == '\0')
+		{
+			break;
+		}
+
+		val += len + 1;
+	}
+
+	cfg->enctype = enctype;
+
+	return 1;
+}
+
+/*
+ * Set flac compression level.
+ *
+ */
+int tsr_cfg_set_flaclevel(tsr_cfg_t *cfg, char *val)
+{
+	int level;
+
+	level = atoi(val);
+
+	if (level >= 0 && level <= 8 && *val >= '0' && *val <= '9')
+	{
+		cfg->flaclevel = level;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set number of threads each flac encoder may use.
+ *
+ */
+int tsr_cfg_set_flacthreads(tsr_cfg_t *cfg, char *val)
+{
+	int threads;
+
+	threads = atoi(val);
+
+	if (threads > 0)
+	{
+		cfg->flacthreads = threads;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set the slowest speed the drive is slowed down to.
+ *
+ */
+int tsr_cfg_set_speedmin(tsr_cfg_t *cfg, char *val)
+{
+	int speed;
+
+	speed = atoi(val);
+
+	if (speed > 0)
+	{
+		cfg->speedmin = speed;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set the speed reading starts at.
+ *
+ */
+int tsr_cfg_set_speedmax(tsr_cfg_t *cfg, char *val)
+{
+	int speed;
+
+	speed = atoi(val);
+
+	if (speed > 0)
+	{
+		cfg->speedmax = speed;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set number of sectors buffered between the reader and the encoder.
+ *
+ */
+int tsr_cfg_set_ringsize(tsr_cfg_t *cfg, char *val)
+{
+	int ringsize;
+
+	ringsize = atoi(val);
+
+	if (ringsize > 1)
+	{
+		cfg->ringsize = ringsize;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set number of tracks encoded at once.
+ *
+ */
+int tsr_cfg_set_jobs(tsr_cfg_t *cfg, char *val)
+{
+	int jobs;
+
+	jobs = atoi(val);
+
+	if (jobs > 0)
+	{
+		cfg->jobs = jobs;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set number of sectors handed to the encoder at once.
+ *
+ */
+int tsr_cfg_set_batch(tsr_cfg_t *cfg, char *val)
+{
+	int batch;
+
+	batch = atoi(val);
+
+	if (batch > 0 && batch <= 1024)
+	{
+		cfg->batch = batch;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set size of the output buffer in kilobytes.
+ *
+ */
+int tsr_cfg_set_writebuffer(tsr_cfg_t *cfg, char *val)
+{
+	int kbytes;
+
+	kbytes = atoi(val);
+
+	if (kbytes >= 4)
+	{
+		cfg->writebuffer = (size_t) kbytes << 10;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set the number of bytes an ogg page should be filled with before it is
+ * written, 0 keeps the libogg default. Ogg pages can't hold more than 255
+ * segments of 255 bytes.
+ *
+ */
+int tsr_cfg_set_pagefill(tsr_cfg_t *cfg, char *val)
+{
+	int pagefill;
+
+	pagefill = atoi(val);
+
+	if (pagefill >= 0 && pagefill <= 255 * 255)
+	{
+		cfg->pagefill = pagefill;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set the read offset of the drive in samples for the AccurateRip
+ * checksums. It has to stay within the samples left out at the start and
+ * the end of the disc.
+ *
+ */
+int tsr_cfg_set_readoffset(tsr_cfg_t *cfg, char *val)
+{
+	char *end;
+	long offset;
+
+	offset = strtol(val, &end, 10);
+
+	if (end != val && *end == '\0' && offset >= -CFG_MAXREADOFFSET
+			&& offset <= CFG_MAXREADOFFSET)
+	{
+		cfg->readoffset = (int) offset;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Set the directory the journals of interrupted rips are kept in, "off"
+ * keeps no journal.
+ *
+ */
+int tsr_cfg_set_journal(tsr_cfg_t *cfg, char *val)
+{
+	free(cfg->journal);
+	cfg->journal = (!strcmp(val, "off")) ? NULL : strdup(val);
+
+	return 1;
+}
+
+/*
+ * Set which tracks have their sectors spooled to the journal while they are
+ * read: none, those paranoia reported errors for or all of them.
+ *
+ */
+int tsr_cfg_set_spool(tsr_cfg_t *cfg, char *val)
+{
+	if (!strcmp(val, "off"))
+	{
+		cfg->spool = CFG_SPOOL_OFF;
+	}
+	else if (!strcmp(val, "errors"))
+	{
+		cfg->spool = CFG_SPOOL_ERRORS;
+	}
+	else if (!strcmp(val, "on"))
+	{
+		cfg->spool = CFG_SPOOL_ON;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Set the directory the album information of the discs is cached in, "off"
+ * keeps no cache.
+ *
+ */
+int tsr_cfg_set_mbcache(tsr_cfg_t *cfg, char *val)
+{
+	free(cfg->mbcache);
+	cfg->mbcache = (!strcmp(val, "off")) ? NULL : strdup(val);
+
+	return 1;
+}
+
+/*
+ * Set the days a cached album information is used, 0 uses it forever.
+ *
+ */
+int tsr_cfg_set_mbcachettl(tsr_cfg_t *cfg, char *val)
+{
+	int ttl;
 
-	iquality = atoi(val);
+	ttl = atoi(val);
 
-	if (iquality > 0 && iquality <= 10)
+	if (ttl >= 0)
 	{
-		fquality = 0.1f * iquality;
-		cfg->vorbisquality = fquality;
+		cfg->mbcachettl = ttl;
 
 		return 1;
 	}
@@ -144,6 +488,139 @@ int tsr_cfg_set_vorbisqualiy(tsr_cfg_t *cfg, char *val)
 	return 0;
 }
 
+/*
+ * Set the sources the daemon takes the album information from, in the
+ * order they are tried: a comma separated list of cache, sidecar, first
+ * and placeholder.
+ *
+ */
+int tsr_cfg_set_policy(tsr_cfg_t *cfg, char *val)
+{
+	char *policy, *name, *saveptr;
+
+	policy = strdup(val);
+
+	for (name = strtok_r(policy, ",", &saveptr); name != NULL;
+			name = strtok_r(NULL, ",", &saveptr))
+	{
+		if (strcmp(name, "cache") && strcmp(name, "sidecar")
+				&& strcmp(name, "first") && strcmp(name, "placeholder"))
+		{
+			free(policy);
+
+			return 0;
+		}
+	}
+
+	free(policy);
+	free(cfg->policy);
+	cfg->policy = strdup(val);
+
+	return 1;
+}
+
+/*
+ * Set the seconds the daemon waits between looking for a disc.
+ *
+ */
+int tsr_cfg_set_poll(tsr_cfg_t *cfg, char *val)
+{
+	int poll;
+
+	poll = atoi(val);
+
+	if (poll > 0)
+	{
+		cfg->poll = poll;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Add a source the daemon rips discs from, next to the other drives.
+ *
+ */
+int tsr_cfg_add_drive(tsr_cfg_t *cfg, char *val)
+{
+	if (cfg->numdrives == CFG_MAXDRIVES)
+	{
+		return 0;
+	}
+
+	cfg->drives[cfg->numdrives++] = strdup(val);
+
+	return 1;
+}
+
+/*
+ * Set if the discs ripped are kept in an index in the music directory.
+ *
+ */
+int tsr_cfg_set_index(tsr_cfg_t *cfg, char *val)
+{
+	if (!strcmp(val, "on"))
+	{
+		cfg->index = 1;
+	}
+	else if (!strcmp(val, "off"))
+	{
+		cfg->index = 0;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Set if the loudness of the tracks is measured for ReplayGain tags.
+ *
+ */
+int tsr_cfg_set_replaygain(tsr_cfg_t *cfg, char *val)
+{
+	if (!strcmp(val, "on"))
+	{
+		cfg->replaygain = 1;
+	}
+	else if (!strcmp(val, "off"))
+	{
+		cfg->replaygain = 0;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Set if every disc is encoded into a single file with a cue sheet.
+ *
+ */
+int tsr_cfg_set_singlefile(tsr_cfg_t *cfg, char *val)
+{
+	if (!strcmp(val, "on"))
+	{
+		cfg->singlefile = 1;
+	}
+	else if (!strcmp(val, "off"))
+	{
+		cfg->singlefile = 0;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
 /*
  * Set if we should ask for multiple cd album.
  *
@@ -167,6 +644,59 @@ int tsr_cfg_set_multidisc(tsr_cfg_t *cfg, char *val)
 }
 
 
+/*
+ * Build the list of outputs every track is encoded to from the encoders and
+ * vorbis qualities. With several vorbis qualities the quality goes into the
+ * file extension, e.g. "q4.ogg".
+ *
+ */
+void tsr_cfg_outputs(tsr_cfg_t *cfg)
+{
+	int i, n = 0;
+	char buf[16];
+
+	free(cfg->outputs);
+	cfg->outputs = (tsr_output_t *) calloc(CFG_MAXQUALITIES + 1, sizeof(tsr_output_t));
+
+	if (cfg->outputs == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	for (i = 0; (cfg->enctype & CFG_TYPE_VORBIS) && i < cfg->numqualities; i++)
+	{
+		cfg->outputs[n].enctype = CFG_TYPE_VORBIS;
+		cfg->outputs[n].quality = cfg->vorbisqualities[i];
+
+		if (cfg->numqualities > 1)
+		{
+			snprintf(buf, sizeof(buf), "q%i.ogg",
+					(int) (cfg->vorbisqualities[i] * 10 + 0.5f));
+			cfg->outputs[n].ext = strdup(buf);
+			snprintf(buf, sizeof(buf), "q%i",
+					(int) (cfg->vorbisqualities[i] * 10 + 0.5f));
+			cfg->outputs[n].name = strdup(buf);
+		}
+		else
+		{
+			cfg->outputs[n].ext = strdup("ogg");
+			cfg->outputs[n].name = strdup("ogg");
+		}
+
+		n++;
+	}
+
+	if (cfg->enctype & CFG_TYPE_FLAC)
+	{
+		cfg->outputs[n].enctype = CFG_TYPE_FLAC;
+		cfg->outputs[n].ext = strdup("flac");
+		cfg->outputs[n].name = strdup("flac");
+		n++;
+	}
+
+	cfg->numoutputs = n;
+}
+
 /*
  * Load default configuration.
  *
@@ -176,11 +706,44 @@ void tsr_cfg_defaults(tsr_cfg_t *cfg)
 	cfg->musicdir = strdup(CFG_MUSICDIR);
 	cfg->device = strdup(CFG_DEVICE);
 	cfg->paranoiamode = PARANOIA_MODE_REPAIR;
-	cfg->vorbisquality = 0.4;
+	cfg->vorbisqualities[0] = 0.4;
+	cfg->numqualities = 1;
+	cfg->flaclevel = 5;
+	cfg->flacthreads = 1;
 	cfg->multidisc = 0;
 	cfg->stripspaces = 0;
 	cfg->lowercase = 0;
 	cfg->enctype = CFG_TYPE_VORBIS;
+	cfg->ringsize = CFG_RINGSIZE;
+	cfg->jobs = 1;
+	cfg->batch = CFG_BATCH;
+	cfg->writebuffer = CFG_WRITEBUFFER;
+	cfg->pagefill = 0;
+	cfg->image = NULL;
+	cfg->source = NULL;
+	cfg->stats = NULL;
+	cfg->riplog = NULL;
+	cfg->speedmin = CFG_SPEEDMIN;
+	cfg->speedmax = CFG_SPEEDMAX;
+	cfg->testcopy = 0;
+	cfg->accurip = NULL;
+	cfg->readoffset = 0;
+	cfg->journal = strdup(CFG_JOURNAL);
+	cfg->spool = CFG_SPOOL_ERRORS;
+	cfg->index = 1;
+	cfg->singlefile = 0;
+	cfg->replaygain = 1;
+	cfg->mbcache = strdup(CFG_MBCACHE);
+	cfg->mbcachettl = CFG_MBCACHETTL;
+	cfg->mbrefresh = 0;
+	cfg->mbimport = NULL;
+	cfg->daemon = 0;
+	cfg->policy = strdup(CFG_POLICY);
+	cfg->sidecar = NULL;
+	cfg->poll = CFG_POLL;
+	cfg->numdrives = 0;
+	cfg->outputs = NULL;
+	cfg->numoutputs = 0;
 }
 
 /*
@@ -234,10 +797,22 @@ int tsr_cfg_setopt(tsr_cfg_t *cfg, char *line)
 	{
 		return tsr_cfg_set_paranoiamode(cfg, val);
 	}
+	else if (!strcmp(line, "encoder"))
+	{
+		return tsr_cfg_set_encoder(cfg, val);
+	}
 	else if (!strcmp(line, "vorbisquality"))
 	{
 		return tsr_cfg_set_vorbisqualiy(cfg, val);
 	}
+	else if (!strcmp(line, "flaclevel"))
+	{
+		return tsr_cfg_set_flaclevel(cfg, val);
+	}
+	else if (!strcmp(line, "flacthreads"))
+	{
+		return tsr_cfg_set_flacthreads(cfg, val);
+	}
 	else if (!strcmp(line, "multidisc"))
 	{
 		return tsr_cfg_set_multidisc(cfg, val);
@@ -250,6 +825,93 @@ int tsr_cfg_setopt(tsr_cfg_t *cfg, char *line)
 	{
 		return tsr_cfg_set_lowercase(cfg, val);
 	}
+	else if (!strcmp(line, "ringsize"))
+	{
+		return tsr_cfg_set_ringsize(cfg, val);
+	}
+	else if (!strcmp(line, "jobs"))
+	{
+		return tsr_cfg_set_jobs(cfg, val);
+	}
+	else if (!strcmp(line, "batch"))
+	{
+		return tsr_cfg_set_batch(cfg, val);
+	}
+	else if (!strcmp(line, "writebuffer"))
+	{
+		return tsr_cfg_set_writebuffer(cfg, val);
+	}
+	else if (!strcmp(line, "pagefill"))
+	{
+		return tsr_cfg_set_pagefill(cfg, val);
+	}
+	else if (!strcmp(line, "speedmin"))
+	{
+		return tsr_cfg_set_speedmin(cfg, val);
+	}
+	else if (!strcmp(line, "speedmax"))
+	{
+		return tsr_cfg_set_speedmax(cfg, val);
+	}
+	else if (!strcmp(line, "accurip"))
+	{
+		free(cfg->accurip);
+		cfg->accurip = strdup(val);
+	}
+	else if (!strcmp(line, "readoffset"))
+	{
+		return tsr_cfg_set_readoffset(cfg, val);
+	}
+	else if (!strcmp(line, "mbcache"))
+	{
+		return tsr_cfg_set_mbcache(cfg, val);
+	}
+	else if (!strcmp(line, "mbcachettl"))
+	{
+		return tsr_cfg_set_mbcachettl(cfg, val);
+	}
+	else if (!strcmp(line, "index"))
+	{
+		return tsr_cfg_set_index(cfg, val);
+	}
+	else if (!strcmp(line, "singlefile"))
+	{
+		return tsr_cfg_set_singlefile(cfg, val);
+	}
+	else if (!strcmp(line, "replaygain"))
+	{
+		return tsr_cfg_set_replaygain(cfg, val);
+	}
+	else if (!strcmp(line, "policy"))
+	{
+		return tsr_cfg_set_policy(cfg, val);
+	}
+	else if (!strcmp(line, "sidecar"))
+	{
+		free(cfg->sidecar);
+		cfg->sidecar = strdup(val);
+	}
+	else if (!strcmp(line, "poll"))
+	{
+		return tsr_cfg_set_poll(cfg, val);
+	}
+	else if (!strcmp(line, "drive"))
+	{
+		return tsr_cfg_add_drive(cfg, val);
+	}
+	else if (!strcmp(line, "journal"))
+	{
+		return tsr_cfg_set_journal(cfg, val);
+	}
+	else if (!strcmp(line, "spool"))
+	{
+		return tsr_cfg_set_spool(cfg, val);
+	}
+	else if (!strcmp(line, "riplog"))
+	{
+		free(cfg->riplog);
+		cfg->riplog = strdup(val);
+	}
 	else
 	{
 		return 0;
@@ -22,11 +22,37 @@
 
 #define CFG_FILE ".tsriprc"
 #define CFG_MUSICDIR "~/music"
+#define CFG_JOURNAL "~/.tsrip"
+#define CFG_MBCACHE "~/.tsrip/mbcache"
+#define CFG_MBCACHETTL 90
+#define CFG_POLICY "cache,sidecar,first,placeholder"
+#define CFG_POLL 5
 #define CFG_DEVICE "/dev/cdrom"
+#define CFG_RINGSIZE 750
+#define CFG_SPEEDMIN 4
+#define CFG_SPEEDMAX 48
+#define CFG_BATCH 64
+#define CFG_WRITEBUFFER (4 << 20)
+#define CFG_MAXREADOFFSET 2938
 
 #define CFG_TYPE_VORBIS (char)1
 #define CFG_TYPE_FLAC   (char)1<<1
 
+#define CFG_SPOOL_OFF    0
+#define CFG_SPOOL_ERRORS 1
+#define CFG_SPOOL_ON     2
+
+#define CFG_MAXQUALITIES 8
+#define CFG_MAXDRIVES 16
+
+typedef struct _tsr_output_t
+{
+	char enctype;
+	float quality;
+	char *ext;
+	char *name;
+} tsr_output_t;
+
 typedef struct _tsr_cfg_t
 {
 	char *cfg_file;
@@ -34,15 +60,95 @@ typedef struct _tsr_cfg_t
 	char *musicdir;
 	char *device;
 	int paranoiamode;
-	float vorbisquality;
+	float vorbisqualities[CFG_MAXQUALITIES];
+	int numqualities;
+	int flaclevel;
+	int flacthreads;
 	int multidisc;
 	int stripspaces;
 	int lowercase;
 	char enctype;
+	int ringsize;
+	int jobs;
+	int batch;
+	size_t writebuffer;
+	int pagefill;
+	char *image;
+	char *source;
+	char *stats;
+	char *riplog;
+	int speedmin;
+	int speedmax;
+	int testcopy;
+	char *accurip;
+	int readoffset;
+	char *journal;
+	int spool;
+	int index;
+	int singlefile;
+	int replaygain;
+	char *mbcache;
+	int mbcachettl;
+	int mbrefresh;
+	char *mbimport;
+	int daemon;
+	char *policy;
+	char *sidecar;
+	int poll;
+	char *drives[CFG_MAXDRIVES];
+	int numdrives;
+	tsr_output_t *outputs;
+	int numoutputs;
 } tsr_cfg_t;
 
 int tsr_cfg_set_paranoiamode(tsr_cfg_t *cfg, char *val);
 
 int tsr_cfg_set_vorbisqualiy(tsr_cfg_t *cfg, char *val);
 
+int tsr_cfg_set_encoder(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_flaclevel(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_flacthreads(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_ringsize(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_speedmin(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_speedmax(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_jobs(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_batch(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_writebuffer(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_pagefill(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_readoffset(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_journal(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_spool(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_index(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_singlefile(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_replaygain(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_mbcache(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_mbcachettl(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_policy(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_set_poll(tsr_cfg_t *cfg, char *val);
+
+int tsr_cfg_add_drive(tsr_cfg_t *cfg, char *val);
+
+void tsr_cfg_outputs(tsr_cfg_t *cfg);
+
+void tsr_cfg_defaults(tsr_cfg_t *cfg);
+
 tsr_cfg_t *tsr_cfg_init();
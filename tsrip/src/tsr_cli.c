@@ -26,14 +26,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <getopt.h>
 #include <cdda_interface.h>
 #include <cdda_paranoia.h>
 
 #include "config.h"
+#include "tsr_types.h"
 #include "tsr_cfg.h"
-#include "tsr_vorbis_track.h"
+#include "tsr_encode.h"
+#include "tsr_source.h"
+#include "tsr_image.h"
+#include "tsr_toc.h"
 #include "tsr_mb.h"
+#include "tsr_mbcache.h"
+#include "tsr_daemon.h"
 #include "tsr_util.h"
 
 /*
@@ -58,7 +66,38 @@ void tsr_cli_print_usage()
 	       "	-s --stripspaces		Replace spaces by underscores\n"
 	       "	-l --lowercase			Lowercase ASCII chars in path\n"
 	       "	   --musicdir <dir>		Directory where files should be saved\n"
-	       "	   --vorbisquality <1-10>	The vorbis quality to use\n"
+	       "	-e --encoder <vorbis,flac>	The encoders to use\n"
+	       "	   --vorbisquality <1-10,...>	The vorbis qualities to use\n"
+	       "	   --flaclevel <0-8>		The flac compression level to use\n"
+	       "	   --flacthreads <n>		Threads per flac encoder\n"
+	       "	   --ringsize <sectors>	Sectors to buffer between reading and encoding\n"
+	       "	-j --jobs <n>			Encode up to <n> tracks at once\n"
+	       "	   --batch <sectors>		Sectors to hand to the encoder at once\n"
+	       "	   --writebuffer <kbytes>	Size of the output buffer per file\n"
+	       "	   --pagefill <bytes>		Target size of ogg pages\n"
+	       "	   --image <file.cue>		Only read the disc into an image\n"
+	       "	   --from-image <file.cue>	Encode an image instead of a disc\n"
+	       "	   --source <type:file>	Read from cdda, wav, cue or raw\n"
+	       "	   --stats <file>		Print timings and write them as json\n"
+	       "	   --riplog <file>		Append the read errors of the drive\n"
+	       "	   --accurip <file>		Check the tracks against a database\n"
+	       "	   --read-offset <samples>	Read offset of the drive for the checksums\n"
+	       "	   --journal <dir|off>		Where to keep journals to resume rips\n"
+	       "	   --spool <off|errors|on>	Which tracks to spool to the journal\n"
+	       "	   --index <on|off>		Skip discs which were ripped already\n"
+	       "	   --single-file		Encode the disc into one file with a cue sheet\n"
+	       "	   --replaygain <on|off>	Tag the track and album gain\n"
+	       "	   --mbcache <dir|off>		Where to cache the album information\n"
+	       "	   --mbcache-ttl <days>	Days to use cached album information\n"
+	       "	   --mbcache-refresh		Ask musicbrainz even for cached discs\n"
+	       "	   --mbcache-import <file>	Add the discs in <file> to the cache\n"
+	       "	   --daemon			Rip every disc put into the drive\n"
+	       "	   --policy <list>		Where the daemon takes album information from\n"
+	       "	   --sidecar <file>		Album information for the daemon\n"
+	       "	   --poll <seconds>		How often the daemon looks for a disc\n"
+	       "	   --drive <source>		Rip with the daemon from this source, too\n"
+	       "	   --speedmin <n>		Slowest speed to read a bad disc at\n"
+	       "	   --speedmax <n>		Speed to start reading at\n"
 	       "	-u --usage			Print usage information\n"
 	       "	-v --version			Print version\n"
 	       "	-h --help			Print help\n");
@@ -84,9 +123,13 @@ void tsr_cli_print_metainfo_head(tsr_metainfo_t *metainfo)
 
 	printf("Album \"%s\" ", metainfo->album);
 
-	if (!metainfo->ismultiple)
+	if (metainfo->numtracks == 0)
+	{
+		printf("by unknown artist\n");
+	}
+	else if (!metainfo->ismultiple)
 	{
-		printf("by %s\n", metainfo->trackinfos[0]->artist);
+		printf("by %s\n", metainfo->trackinfos[0].artist);
 	}
 	else
 	{
@@ -107,11 +150,11 @@ void tsr_cli_print_metainfo(tsr_metainfo_t *metainfo)
 
 	for (i = 0; i < metainfo->numtracks; i++)
 	{
-		printf("%i: %s", i + 1, metainfo->trackinfos[i]->title);
+		printf("%i: %s", i + 1, metainfo->trackinfos[i].title);
 
 		if (metainfo->ismultiple)
 		{
-			printf(", by %s", metainfo->trackinfos[i]->artist);
+			printf(", by %s", metainfo->trackinfos[i].artist);
 		}
 
 		printf("\n");
@@ -120,14 +163,6 @@ void tsr_cli_print_metainfo(tsr_metainfo_t *metainfo)
 	printf(" ----\n");
 }
 
-/*
- * Callback needed by paranoia_read(), urgs ...
- *
- */
-void cb(long a, int b)
-{
-}
-
 /*
  * Function to get a line from stdin and automatically strip the newline at
  * end.
@@ -161,35 +196,24 @@ char *tsr_cli_read_str()
 }
 
 /*
- * Get metainfo for a single album, identifyed by number.
+ * Read a line from stdin as string of the metainfo.
  *
  */
-tsr_metainfo_t *tsr_cli_metainfo_mb_bynum(musicbrainz_t mb_o, int numalbum)
+char *tsr_cli_read_field(tsr_metainfo_t *metainfo)
 {
-	int i;
-	tsr_metainfo_t *metainfo;
-
-	i = tsr_mb_album_numtracks(mb_o, numalbum);
-	metainfo = tsr_metainfo_new(i);
-	metainfo->numtracks = i;
-	metainfo->album = tsr_mb_album_name(mb_o, numalbum);
-	metainfo->ismultiple = tsr_mb_album_ismultiple(mb_o, numalbum);
+	char *input, *field;
 
-	for (i = 0; i < metainfo->numtracks; i++)
-	{
-		metainfo->trackinfos[i]->title = tsr_mb_track_title(mb_o,
-				numalbum, i + 1);
-		metainfo->trackinfos[i]->artist = tsr_mb_track_artist(mb_o,
-				numalbum, i + 1);
-	}
+	input = tsr_cli_read_str();
+	field = tsr_metainfo_str(metainfo, input);
+	free(input);
 
-	return metainfo;
+	return field;
 }
 
 /*
  * This function is dedicated to edit the artist on a normal album with one
- * artist. This function is special, because the artist is stored for each
- * track in the metainfo, even if the album only has one artist.
+ * artist. The artist is set for each track in the metainfo, even if the
+ * album only has one artist, all of them share the same string.
  *
  */
 void tsr_cli_artist_edit(tsr_metainfo_t *metainfo)
@@ -197,15 +221,12 @@ void tsr_cli_artist_edit(tsr_metainfo_t *metainfo)
 	char *artist;
 	int i;
 
-	artist = tsr_cli_read_str();
+	artist = tsr_cli_read_field(metainfo);
 	
 	for (i = 0; i < metainfo->numtracks; i++)
 	{
-		free(metainfo->trackinfos[i]->artist);
-		metainfo->trackinfos[i]->artist = strdup(artist);
+		metainfo->trackinfos[i].artist = artist;
 	}
-
-	free(artist);
 }
 
 /*
@@ -241,7 +262,7 @@ tsr_metainfo_t *tsr_cli_metainfo_mb_finish(tsr_metainfo_t *metainfo)
 		else if (*input == 'a')
 		{
 			printf("Enter new album name: ");
-			metainfo->album = tsr_cli_read_str();
+			metainfo->album = tsr_cli_read_field(metainfo);
 		}
 		else if (*input == 'r' && !metainfo->ismultiple)
 		{
@@ -251,12 +272,12 @@ tsr_metainfo_t *tsr_cli_metainfo_mb_finish(tsr_metainfo_t *metainfo)
 		else if (track > 0 && track <= metainfo->numtracks)
 		{
 			printf("Enter new title for track %i: ", track--);
-			metainfo->trackinfos[track]->title = tsr_cli_read_str();
+			metainfo->trackinfos[track].title = tsr_cli_read_field(metainfo);
 
 			if (metainfo->ismultiple)
 			{
 				printf("Enter new artist for track %i: ", track);
-				metainfo->trackinfos[track]->artist = tsr_cli_read_str();
+				metainfo->trackinfos[track].artist = tsr_cli_read_field(metainfo);
 			}
 
 		}
@@ -274,7 +295,8 @@ tsr_metainfo_t *tsr_cli_metainfo_mb_finish(tsr_metainfo_t *metainfo)
 }
 
 /*
- * Get meta information from musicbrainz database.
+ * Get meta information from musicbrainz database. Only the heads of the
+ * albums are listed, the titles of an album are got when it is viewed.
  *
  */
 tsr_metainfo_t *tsr_cli_metainfo_mb(musicbrainz_t mb_o, int numalbums)
@@ -287,7 +309,8 @@ tsr_metainfo_t *tsr_cli_metainfo_mb(musicbrainz_t mb_o, int numalbums)
 
 	if (numalbums == 1)
 	{
-		metainfo = tsr_cli_metainfo_mb_bynum(mb_o, 1);
+		metainfo = tsr_mb_album_head(mb_o, 1);
+		tsr_mb_album_tracks(mb_o, 1, metainfo);
 
 		return tsr_cli_metainfo_mb_finish(metainfo);
 	}
@@ -301,7 +324,7 @@ tsr_metainfo_t *tsr_cli_metainfo_mb(musicbrainz_t mb_o, int numalbums)
 
 	for (i = 0; i < numalbums; i++)
 	{
-		metainfos[i] = tsr_cli_metainfo_mb_bynum(mb_o, i + 1);
+		metainfos[i] = tsr_mb_album_head(mb_o, i + 1);
 	}
 
 	while (1)
@@ -334,6 +357,7 @@ tsr_metainfo_t *tsr_cli_metainfo_mb(musicbrainz_t mb_o, int numalbums)
 		{
 			tsr_metainfo_t *retval;
 
+			tsr_mb_album_tracks(mb_o, album, metainfos[album - 1]);
 			metainfo = tsr_cli_metainfo_mb_finish(metainfos[album - 1]);
 
 			if (metainfo == NULL)
@@ -369,12 +393,10 @@ tsr_metainfo_t *tsr_cli_metainfo_input(int numtracks)
 {
 	int i;
 	char *input;
-	char *artist;
+	char *artist = NULL;
 	tsr_metainfo_t *metainfo;
 
 	metainfo = tsr_metainfo_new(numtracks);
-	metainfo->numtracks = numtracks;
-	metainfo->album = NULL;
 	printf("Is this a multi-artist album? (y/N) ");
 	input = tsr_cli_read_str();
 	metainfo->ismultiple = (*input == 'y') ? 1 : 0;
@@ -383,58 +405,74 @@ tsr_metainfo_t *tsr_cli_metainfo_input(int numtracks)
 	if (!metainfo->ismultiple)
 	{
 		printf("Album artist: ");
-		artist = tsr_cli_read_str();
+		artist = tsr_cli_read_field(metainfo);
 	}
 
 	printf("Album: ");
-	metainfo->album = tsr_cli_read_str();
+	metainfo->album = tsr_cli_read_field(metainfo);
 
 	for (i = 0; i < numtracks; i++)
 	{
-		metainfo->trackinfos[i]->title = NULL;
-		metainfo->trackinfos[i]->artist = NULL;
 		printf("Title for Track %i: ", i + 1);
-		metainfo->trackinfos[i]->title = tsr_cli_read_str();
+		metainfo->trackinfos[i].title = tsr_cli_read_field(metainfo);
 
 		if (!metainfo->ismultiple)
 		{
-			metainfo->trackinfos[i]->artist = strdup(artist);
+			metainfo->trackinfos[i].artist = artist;
 		}
 		else
 		{
 			printf("Artist for Track %i: ", i + 1);
-			metainfo->trackinfos[i]->artist = tsr_cli_read_str();
+			metainfo->trackinfos[i].artist = tsr_cli_read_field(metainfo);
 		}
 	}
 
-	free(artist);
-
 	return metainfo;
 }
 
 /*
- * Get meta info, choose which way is ok ...
+ * Get meta info, choose which way is ok ... The cache is asked first, then
+ * musicbrainz, which looks up the disc by discid if byid is set, else the
+ * one in the drive. The information taken is cached.
  *
  */
-tsr_metainfo_t *tsr_cli_metainfo(musicbrainz_t mb_o, int numtracks)
+tsr_metainfo_t *tsr_cli_metainfo(musicbrainz_t mb_o, char *discid, int byid,
+		int numtracks, tsr_cfg_t *cfg)
 {
 	int numalbums;
 	char *input = NULL;
 	size_t read;
 	tsr_metainfo_t *metainfo = NULL;
+	tsr_metainfo_t *cached;
 
-	printf("Querying musicbrainz database...");
-	fflush(stdout);
-	numalbums = tsr_mb_numalbums(mb_o);
+	cached = tsr_mbcache_get(discid, cfg);
 
-	if (numalbums)
+	if (cached != NULL)
 	{
-		printf("\n");
-		metainfo = tsr_cli_metainfo_mb(mb_o, numalbums);
+		printf("Found the disc in the cache.\n");
+		metainfo = tsr_cli_metainfo_mb_finish(cached);
+
+		if (metainfo == NULL)
+		{
+			tsr_metainfo_free(cached);
+		}
 	}
-	else
+
+	if (metainfo == NULL)
 	{
-		printf(" Nothing found.\n");
+		printf("Querying musicbrainz database...");
+		fflush(stdout);
+		numalbums = tsr_mb_numalbums(mb_o, (byid) ? discid : NULL);
+
+		if (numalbums)
+		{
+			printf("\n");
+			metainfo = tsr_cli_metainfo_mb(mb_o, numalbums);
+		}
+		else
+		{
+			printf(" Nothing found.\n");
+		}
 	}
 
 	while (metainfo == NULL)
@@ -457,65 +495,12 @@ tsr_metainfo_t *tsr_cli_metainfo(musicbrainz_t mb_o, int numtracks)
 	if (input != NULL)
 		free(input);
 
-	return metainfo;
-}
-
-/*
- * Encode the specified track.
- *
- */
-void tsr_cli_encode_track(int tracknum, tsr_metainfo_t *metainfo, cdrom_drive
-		*drive, cdrom_paranoia *paranoia, tsr_cfg_t *cfg)
-{
-	char *filename, *read_buffer;
-	int rtrack;
-	long fsec, lsec, cursor, p, pp;
-	tsr_trackfile_t *trackfile;
-
-	filename = tsr_get_filename(cfg, metainfo, tracknum);
-	rtrack = tracknum + 1;
-	fsec = cdda_track_firstsector(drive, rtrack);
-	lsec = cdda_track_lastsector(drive, rtrack);
-	paranoia_seek(paranoia, fsec, SEEK_SET);
-	tsr_trackfile_encode_t *fp;
-
-	switch(cfg->enctype)
-	{
-		case CFG_TYPE_VORBIS:
-			trackfile = tsr_vorbisfile_init(tracknum, filename, metainfo, cfg->vorbisquality);
-			break;
-	}
-
-	cursor = fsec;
-	pp = 0;
-
-	while (cursor <= lsec)
+	if (metainfo != NULL && !tsr_mbcache_put(discid, metainfo, cfg))
 	{
-		read_buffer = (int8_t *) paranoia_read(paranoia, cb);
-
-		if (!read_buffer)
-		{
-			tsr_trackfile_fail(trackfile);
-			printf("\n");
-			fflush(stdout); fprintf(stderr, "\nError reading Track %i\n", rtrack);
-			exit(1);
-		}
-		
-		trackfile->encode(trackfile, read_buffer);
-		p = (cursor - fsec) * 100 / (lsec - fsec);
-		
-		if (p != pp)
-		{
-			printf("\rEncoding Track No. %02i/%02i... %3li%%", rtrack,
-					metainfo->numtracks, p);
-			fflush(stdout);
-		}
-
-		pp = p;
-		cursor++;
+		fprintf(stderr, "Can't cache the album information in %s.\n", cfg->mbcache);
 	}
 
-	trackfile->finish(trackfile);
+	return metainfo;
 }
 
 /*
@@ -533,14 +518,45 @@ void tsr_cli_handle_args(int argc, char **argv, tsr_cfg_t *cfg)
 		{"lowercase", 0, 0, 'l'},
 		{"paranoiamode", 1, 0, 'p'}, 
 		{"musicdir", 1, 0, 0},
+		{"encoder", 1, 0, 'e'},
 		{"vorbisquality", 1, 0, 0},
+		{"flaclevel", 1, 0, 0},
+		{"flacthreads", 1, 0, 0},
+		{"ringsize", 1, 0, 0},
+		{"jobs", 1, 0, 'j'},
+		{"batch", 1, 0, 0},
+		{"writebuffer", 1, 0, 0},
+		{"pagefill", 1, 0, 0},
+		{"image", 1, 0, 0},
+		{"from-image", 1, 0, 0},
+		{"source", 1, 0, 0},
+		{"stats", 1, 0, 0},
+		{"riplog", 1, 0, 0},
+		{"accurip", 1, 0, 0},
+		{"read-offset", 1, 0, 0},
+		{"journal", 1, 0, 0},
+		{"spool", 1, 0, 0},
+		{"index", 1, 0, 0},
+		{"single-file", 0, 0, 0},
+		{"replaygain", 1, 0, 0},
+		{"mbcache", 1, 0, 0},
+		{"mbcache-ttl", 1, 0, 0},
+		{"mbcache-refresh", 0, 0, 0},
+		{"mbcache-import", 1, 0, 0},
+		{"daemon", 0, 0, 0},
+		{"policy", 1, 0, 0},
+		{"sidecar", 1, 0, 0},
+		{"poll", 1, 0, 0},
+		{"drive", 1, 0, 0},
+		{"speedmin", 1, 0, 0},
+		{"speedmax", 1, 0, 0},
 		{"usage", 0, 0, 'u'},
 		{"help", 0, 0, 'h'},
 		{"version", 0, 0, 'v'},
 		{0, 0, 0, 0}
 	};
 
-	while ((option = getopt_long(argc, argv, "md:slp:uvh", lopts, &loption)) != -1)
+	while ((option = getopt_long(argc, argv, "md:slp:e:j:uvh", lopts, &loption)) != -1)
 	{
 		switch (option)
 		{
@@ -553,6 +569,134 @@ void tsr_cli_handle_args(int argc, char **argv, tsr_cfg_t *cfg)
 				{
 					tsr_cfg_set_vorbisqualiy(cfg, optarg);
 				}
+				else if (!strcmp(lopts[loption].name, "flaclevel"))
+				{
+					tsr_cfg_set_flaclevel(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "flacthreads"))
+				{
+					tsr_cfg_set_flacthreads(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "ringsize"))
+				{
+					tsr_cfg_set_ringsize(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "batch"))
+				{
+					tsr_cfg_set_batch(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "writebuffer"))
+				{
+					tsr_cfg_set_writebuffer(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "pagefill"))
+				{
+					tsr_cfg_set_pagefill(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "stats"))
+				{
+					cfg->stats = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "speedmin"))
+				{
+					tsr_cfg_set_speedmin(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "speedmax"))
+				{
+					tsr_cfg_set_speedmax(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "accurip"))
+				{
+					free(cfg->accurip);
+					cfg->accurip = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "read-offset"))
+				{
+					tsr_cfg_set_readoffset(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "mbcache"))
+				{
+					tsr_cfg_set_mbcache(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "mbcache-ttl"))
+				{
+					tsr_cfg_set_mbcachettl(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "mbcache-refresh"))
+				{
+					cfg->mbrefresh = 1;
+				}
+				else if (!strcmp(lopts[loption].name, "mbcache-import"))
+				{
+					cfg->mbimport = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "index"))
+				{
+					tsr_cfg_set_index(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "single-file"))
+				{
+					cfg->singlefile = 1;
+				}
+				else if (!strcmp(lopts[loption].name, "replaygain"))
+				{
+					tsr_cfg_set_replaygain(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "daemon"))
+				{
+					cfg->daemon = 1;
+				}
+				else if (!strcmp(lopts[loption].name, "policy"))
+				{
+					if (!tsr_cfg_set_policy(cfg, optarg))
+					{
+						fprintf(stderr, "Unknown metainfo policy %s\n", optarg);
+						exit(EXIT_FAILURE);
+					}
+				}
+				else if (!strcmp(lopts[loption].name, "sidecar"))
+				{
+					free(cfg->sidecar);
+					cfg->sidecar = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "poll"))
+				{
+					tsr_cfg_set_poll(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "drive"))
+				{
+					if (!tsr_cfg_add_drive(cfg, optarg))
+					{
+						fprintf(stderr, "Too many drives, %s is not used.\n", optarg);
+					}
+				}
+				else if (!strcmp(lopts[loption].name, "journal"))
+				{
+					tsr_cfg_set_journal(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "spool"))
+				{
+					tsr_cfg_set_spool(cfg, optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "riplog"))
+				{
+					free(cfg->riplog);
+					cfg->riplog = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "image"))
+				{
+					cfg->image = strdup(optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "from-image"))
+				{
+					free(cfg->source);
+					asprintf(&cfg->source, "cue:%s", optarg);
+				}
+				else if (!strcmp(lopts[loption].name, "source"))
+				{
+					free(cfg->source);
+					cfg->source = strdup(optarg);
+				}
 				break;
 			case 'm':
 				cfg->multidisc = 1;
@@ -569,6 +713,12 @@ void tsr_cli_handle_args(int argc, char **argv, tsr_cfg_t *cfg)
 			case 'p':
 				tsr_cfg_set_paranoiamode(cfg, optarg);
 				break;
+			case 'e':
+				tsr_cfg_set_encoder(cfg, optarg);
+				break;
+			case 'j':
+				tsr_cfg_set_jobs(cfg, optarg);
+				break;
 			case 'v':
 				tsr_cli_print_version();
 				exit(EXIT_SUCCESS);
@@ -582,45 +732,183 @@ void tsr_cli_handle_args(int argc, char **argv, tsr_cfg_t *cfg)
 	}
 }
 
+/*
+ * Tell if the files of the disc are in the index with the current settings
+ * already, and ask if it should be ripped again if all of them are. Returns
+ * 0 if it shouldn't.
+ *
+ */
+int tsr_cli_check_index(tsr_index_t *index, int numtracks, tsr_cfg_t *cfg)
+{
+	char *input;
+	int again;
+
+	if (index == NULL || index->numdone == 0)
+	{
+		return 1;
+	}
+
+	if (index->numdone < numtracks * cfg->numoutputs)
+	{
+		printf("%i of %i files of this disc are there already, only the "
+				"others are encoded.\n", index->numdone, numtracks * cfg->numoutputs);
+
+		return 1;
+	}
+
+	printf("This disc was ripped to %s already. Rip it again? (y/N) ",
+			(index->dir != NULL) ? index->dir : cfg->musicdir);
+	input = tsr_cli_read_str();
+	again = (*input == 'y') ? 1 : 0;
+	free(input);
+
+	if (again)
+	{
+		tsr_index_forget(index);
+	}
+
+	return again;
+}
+
+/*
+ * Return 1 if the source reads its pcm from stdin, a file list with "-".
+ *
+ */
+int tsr_cli_source_stdin(char *spec)
+{
+	char *list, *file, *save;
+	int found = 0;
+
+	if (spec == NULL || (strncmp(spec, "wav:", 4) && strncmp(spec, "raw:", 4)))
+	{
+		return 0;
+	}
+
+	list = strdup(spec + 4);
+
+	for (file = strtok_r(list, ",", &save); file != NULL;
+			file = strtok_r(NULL, ",", &save))
+	{
+		found |= !strcmp(file, "-");
+	}
+
+	free(list);
+
+	return found;
+}
+
 /*
  * Main program.
  *
  */
 int main(int argc, char **argv)
 {
-	int i;
-	cdrom_drive *drive = NULL;
-	cdrom_paranoia *paranoia;
+	tsr_source_t *source;
+	tsr_index_t *index;
+	tsr_rip_t *rip;
 	musicbrainz_t *mb_o;
 	tsr_metainfo_t *metainfo;
 	char *discinput;
+	char *discid;
 	size_t read;
+	int imported, tty = -1;
 	tsr_cfg_t *cfg;
 
 	cfg = tsr_cfg_init();
 	tsr_cli_handle_args(argc, argv, cfg);
-	printf("Initializing device... ");
+	tsr_cfg_outputs(cfg);
+
+	if (cfg->mbimport)
+	{
+		imported = tsr_mbcache_import(cfg->mbimport, cfg);
+
+		if (imported == -1)
+		{
+			fprintf(stderr, "Can't read %s: %s\n", cfg->mbimport, strerror(errno));
+
+			return EXIT_FAILURE;
+		}
+
+		printf("Imported %i discs into the cache.\n", imported);
+
+		return EXIT_SUCCESS;
+	}
+
+	if (cfg->daemon)
+	{
+		return tsr_daemon_run(cfg);
+	}
+
+	/* the source takes all of stdin, the questions are asked on the terminal */
+	if (tsr_cli_source_stdin(cfg->source) && !cfg->image
+			&& (tty = open("/dev/tty", O_RDONLY)) == -1)
+	{
+		fprintf(stderr, "Can't read the pcm from stdin without a terminal to "
+				"ask for the album information on: %s\n", strerror(errno));
+
+		return EXIT_FAILURE;
+	}
+
+	printf("Initializing %s... ", tsr_source_isdrive(cfg->source) ? "device" : "source");
 	fflush(stdout);
-	drive = (cfg->device) ?
-		cdda_identify(cfg->device, CDDA_MESSAGE_FORGETIT, 0) : 
-		cdda_find_a_cdrom(CDDA_MESSAGE_FORGETIT, 0);
-		
-	if (drive == NULL || cdda_open(drive))
+	source = tsr_source_open(cfg->source, cfg);
+
+	if (tty != -1)
 	{
-		char *device;
+		dup2(tty, STDIN_FILENO);
+		close(tty);
+		clearerr(stdin);
+	}
 
-		device = (drive == NULL) ? cfg->device : drive->ioctl_device_name;
-		fprintf(stderr, "Can't open cdrom drive %s.\n", device);
+	if (source == NULL)
+	{
+		if (tsr_source_isdrive(cfg->source))
+		{
+			fprintf(stderr, "Can't open cdrom drive %s.\n", cfg->device);
+		}
+		else
+		{
+			fprintf(stderr, "Can't open source %s: %s\n", cfg->source,
+					strerror(errno));
+		}
 
 		return EXIT_FAILURE;
 	}
 
-	printf("%s\n", drive->ioctl_device_name);
-	mb_o = tsr_mb_init(drive->ioctl_device_name);
-	metainfo = tsr_cli_metainfo(mb_o, drive->tracks);
+	printf("%s\n", source->name);
+
+	if (cfg->image)
+	{
+		tsr_image_capture(source, cfg->image, cfg);
+		tsr_source_close(source);
+		printf("\nWrote image %s.\n", cfg->image);
+
+		return EXIT_SUCCESS;
+	}
+
+	index = tsr_index_open(&source->toc, cfg);
+
+	if (!tsr_cli_check_index(index, source->toc.numtracks, cfg))
+	{
+		tsr_index_free(index);
+		tsr_source_close(source);
+
+		return EXIT_SUCCESS;
+	}
+
+	/* the drive reads while the metainfo is looked up and edited */
+	rip = tsr_encode_start(source, index, NULL, cfg);
+
+	/* the disc id keys the cache, without a drive musicbrainz needs it, too */
+	discid = tsr_toc_discid(&source->toc);
+	mb_o = tsr_mb_init(source->device);
+	metainfo = tsr_cli_metainfo(mb_o, discid, source->device == NULL,
+			source->toc.numtracks, cfg);
 
 	if (metainfo == NULL)
 	{
+		tsr_encode_abort(rip);
+
 		return EXIT_SUCCESS;
 	}
 
@@ -636,14 +924,14 @@ int main(int argc, char **argv)
 		metainfo->discnum = 0;
 	}
 
-	paranoia = paranoia_init(drive);
-	paranoia_modeset(paranoia, cfg->paranoiamode);
-	
-	for (i = 0; i < metainfo->numtracks; i++)
+	if (!tsr_encode_finish(rip, metainfo, 0))
 	{
-		tsr_cli_encode_track(i, metainfo, drive, paranoia, cfg);
+		return EXIT_FAILURE;
 	}
 
+	tsr_index_free(index);
+	tsr_source_close(source);
+	free(discid);
 	tsr_metainfo_free(metainfo);
 	printf("\nEncoded all tracks.\n");
 
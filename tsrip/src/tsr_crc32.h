@@ -15,17 +15,17 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *
  *
- * file: tsr_track.h
+ * file: tsr_crc32.h
  * Author: Sven Salzwedel <sven_salzwedel@web.de>
  *
  */
 
-#include "tsr_types.h"
+#ifndef TSR_CRC32_H
+#define TSR_CRC32_H
 
-tsr_trackfile_t *tsr_trackfile_init(int tracknum, char *filename, tsr_metainfo_t *metainfo);
-	
-void tsr_trackfile_encode_next(tsr_trackfile_t *track, char *read_buffer);
+#include <stdint.h>
+#include <stddef.h>
 
-void tsr_trackfile_fail(tsr_trackfile_t *trackfile);
+uint32_t tsr_crc32(uint32_t crc, const void *buf, size_t len);
 
-void tsr_trackfile_finish(tsr_trackfile_t *track);
+#endif
@@ -0,0 +1,151 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_cue.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Cue sheets of the files of whole discs. The tracks are written one after
+ * the other without gaps, so a track starts at the sum of the lengths of
+ * the tracks before it. The cue sheet is put into the tags of the file and
+ * next to it.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_loudness.h"
+#include "tsr_cue.h"
+#include "tsr_util.h"
+
+/*
+ * Write a line of the cue sheet with a quoted value and what follows it. A
+ * cue sheet can't quote the quote, so it is replaced.
+ *
+ */
+static void tsr_cue_field(FILE *fp, char *field, char *val, char *after)
+{
+	fprintf(fp, "%s \"", field);
+
+	for (; *val != '\0'; val++)
+	{
+		fputc((*val == '"') ? '\'' : *val, fp);
+	}
+
+	fprintf(fp, "\"%s\n", after);
+}
+
+/*
+ * Return the cue sheet of the disc with the given toc encoded into the
+ * file, which is named without its directory. Tracks the metainfo has no
+ * title for are numbered. If loudness is not NULL, the ReplayGain of the
+ * album and the tracks is noted in remarks.
+ *
+ */
+char *tsr_cue_new(tsr_toc_t *toc, tsr_metainfo_t *metainfo,
+		tsr_loudness_t *loudness, char *filename)
+{
+	char *cuesheet = NULL, *name, title[32];
+	double gain, peak;
+	size_t len = 0;
+	long offset = 0;
+	int track;
+	FILE *fp;
+
+	fp = open_memstream(&cuesheet, &len);
+
+	if (fp == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	name = strrchr(filename, '/');
+	fprintf(fp, "REM COMMENT \"tsrip\"\n");
+
+	if (loudness != NULL && tsr_loudness_album(loudness, &gain, &peak))
+	{
+		fprintf(fp, "REM REPLAYGAIN_ALBUM_GAIN %+.2f dB\n", gain);
+		fprintf(fp, "REM REPLAYGAIN_ALBUM_PEAK %.6f\n", peak);
+	}
+
+	tsr_cue_field(fp, "PERFORMER", (metainfo->numtracks == 0) ? "Unknown Artist" :
+			(metainfo->ismultiple) ? "Various Artists" :
+			metainfo->trackinfos[0].artist, "");
+	tsr_cue_field(fp, "TITLE", metainfo->album, "");
+	tsr_cue_field(fp, "FILE", (name != NULL) ? name + 1 : filename, " WAVE");
+
+	for (track = 0; track < toc->numtracks; track++)
+	{
+		fprintf(fp, "  TRACK %02i AUDIO\n", track + 1);
+
+		if (track < metainfo->numtracks)
+		{
+			tsr_cue_field(fp, "    TITLE", metainfo->trackinfos[track].title, "");
+			tsr_cue_field(fp, "    PERFORMER", metainfo->trackinfos[track].artist, "");
+		}
+		else
+		{
+			snprintf(title, sizeof(title), "Track %02i", track + 1);
+			tsr_cue_field(fp, "    TITLE", title, "");
+		}
+
+		if (loudness != NULL && tsr_loudness_track(loudness, track, &gain, &peak))
+		{
+			fprintf(fp, "    REM REPLAYGAIN_TRACK_GAIN %+.2f dB\n", gain);
+			fprintf(fp, "    REM REPLAYGAIN_TRACK_PEAK %.6f\n", peak);
+		}
+
+		/* minutes, seconds and frames of 1/75 second */
+		fprintf(fp, "    INDEX 01 %02li:%02li:%02li\n", offset / (60 * 75),
+				offset / 75 % 60, offset % 75);
+		offset += toc->lastsector[track] - toc->firstsector[track] + 1;
+	}
+
+	fclose(fp);
+
+	return cuesheet;
+}
+
+/*
+ * Write the cue sheet to the given file. Returns 0 if it can't be written.
+ *
+ */
+int tsr_cue_write(char *filename, char *cuesheet)
+{
+	FILE *fp;
+	int ok;
+
+	fp = fopen(filename, "w");
+
+	if (fp == NULL)
+	{
+		return 0;
+	}
+
+	ok = fputs(cuesheet, fp) != EOF;
+
+	return (fclose(fp) == 0) && ok;
+}
@@ -0,0 +1,26 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_cue.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+char *tsr_cue_new(tsr_toc_t *toc, tsr_metainfo_t *metainfo,
+		tsr_loudness_t *loudness, char *filename);
+
+int tsr_cue_write(char *filename, char *cuesheet);
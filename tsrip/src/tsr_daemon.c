@@ -0,0 +1,391 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_daemon.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The daemon mode, which rips every disc put into the drive without asking
+ * anything. The drive is polled until a disc can be opened, the disc is
+ * ripped while its album information is taken from the sources of the
+ * policy, in order:
+ *
+ *   cache        the album information cache
+ *   sidecar      a file with entries in the format of the cache
+ *   first        the first album musicbrainz has for the disc
+ *   placeholder  "Unknown Artist" and numbered tracks
+ *
+ * Then the disc is ejected and the daemon waits for the next one. A disc
+ * which can't be ripped doesn't stop the daemon. Every drive is watched by
+ * a thread of its own, the tracks of all drives are encoded by one pool of
+ * cfg->jobs threads. A disc is only ripped by one drive at a time, a copy
+ * of it in another drive waits until it is done, the index has it as
+ * ripped then.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_encode.h"
+#include "tsr_source.h"
+#include "tsr_index.h"
+#include "tsr_toc.h"
+#include "tsr_mb.h"
+#include "tsr_mbcache.h"
+#include "tsr_daemon.h"
+#include "tsr_util.h"
+
+/*
+ * The disc ids being ripped, one slot per drive.
+ *
+ */
+typedef struct _tsr_daemon_discs_t
+{
+	pthread_mutex_t lock;
+	char *ids[CFG_MAXDRIVES];
+} tsr_daemon_discs_t;
+
+/*
+ * A drive watched by the daemon.
+ *
+ */
+typedef struct _tsr_daemon_drive_t
+{
+	char *spec;
+	tsr_pool_t *pool;
+	tsr_daemon_discs_t *discs;
+	int slot;
+	int quiet;
+	tsr_cfg_t *cfg;
+	pthread_t thread;
+} tsr_daemon_drive_t;
+
+/*
+ * Take the disc for the drive. Returns 0 if another drive is ripping it.
+ *
+ */
+static int tsr_daemon_claim(tsr_daemon_drive_t *drive, char *discid)
+{
+	tsr_daemon_discs_t *discs = drive->discs;
+	int i, ok = 1;
+
+	pthread_mutex_lock(&discs->lock);
+
+	for (i = 0; i < CFG_MAXDRIVES; i++)
+	{
+		if (discs->ids[i] != NULL && !strcmp(discs->ids[i], discid))
+		{
+			ok = 0;
+		}
+	}
+
+	if (ok)
+	{
+		discs->ids[drive->slot] = discid;
+	}
+
+	pthread_mutex_unlock(&discs->lock);
+
+	return ok;
+}
+
+/*
+ * Let other drives rip the disc of the drive.
+ *
+ */
+static void tsr_daemon_release(tsr_daemon_drive_t *drive)
+{
+	pthread_mutex_lock(&drive->discs->lock);
+	drive->discs->ids[drive->slot] = NULL;
+	pthread_mutex_unlock(&drive->discs->lock);
+}
+
+/*
+ * Return metainfo with an unknown artist and numbered tracks.
+ *
+ */
+static tsr_metainfo_t *tsr_daemon_placeholder(char *discid, int numtracks)
+{
+	tsr_metainfo_t *metainfo;
+	char *album, title[32];
+	int i;
+
+	metainfo = tsr_metainfo_new(numtracks);
+	asprintf(&album, "Unknown %s", discid);
+	metainfo->album = tsr_metainfo_str(metainfo, album);
+	free(album);
+
+	for (i = 0; i < numtracks; i++)
+	{
+		snprintf(title, sizeof(title), "Track %02i", i + 1);
+		metainfo->trackinfos[i].title = tsr_metainfo_str(metainfo, title);
+		metainfo->trackinfos[i].artist = tsr_metainfo_str(metainfo, "Unknown Artist");
+	}
+
+	return metainfo;
+}
+
+/*
+ * Return the metainfo of the disc from the first source of the policy
+ * which has it, the name of the source is returned in from.
+ *
+ */
+static tsr_metainfo_t *tsr_daemon_metainfo(tsr_source_t *source, char *discid,
+		char **from, tsr_cfg_t *cfg)
+{
+	tsr_metainfo_t *metainfo = NULL;
+	musicbrainz_t mb_o;
+	char *policy, *name, *saveptr;
+
+	policy = strdup(cfg->policy);
+
+	for (name = strtok_r(policy, ",", &saveptr); metainfo == NULL && name != NULL;
+			name = strtok_r(NULL, ",", &saveptr))
+	{
+		*from = name;
+
+		if (!strcmp(name, "cache"))
+		{
+			metainfo = tsr_mbcache_get(discid, cfg);
+		}
+		else if (!strcmp(name, "sidecar") && cfg->sidecar != NULL)
+		{
+			metainfo = tsr_mbcache_find(cfg->sidecar, discid);
+		}
+		else if (!strcmp(name, "first"))
+		{
+			mb_o = tsr_mb_init(source->device);
+
+			if (tsr_mb_numalbums(mb_o, (source->device == NULL) ? discid : NULL))
+			{
+				metainfo = tsr_mb_album_head(mb_o, 1);
+				tsr_mb_album_tracks(mb_o, 1, metainfo);
+			}
+
+			mb_Delete(mb_o);
+		}
+		else if (!strcmp(name, "placeholder"))
+		{
+			metainfo = tsr_daemon_placeholder(discid, source->toc.numtracks);
+		}
+	}
+
+	*from = (metainfo != NULL) ? strdup(*from) : NULL;
+	free(policy);
+
+	return metainfo;
+}
+
+/*
+ * Rip the disc of the source. Returns 0 if it couldn't be ripped.
+ *
+ */
+static int tsr_daemon_rip(tsr_daemon_drive_t *drive, tsr_source_t *source,
+		char *discid)
+{
+	tsr_cfg_t *cfg = drive->cfg;
+	tsr_index_t *index;
+	tsr_rip_t *rip;
+	tsr_metainfo_t *metainfo;
+	char *from;
+	int ok = 1;
+
+	index = tsr_index_open(&source->toc, cfg);
+
+	if (index != NULL && index->numdone == source->toc.numtracks * cfg->numoutputs)
+	{
+		printf("Disc %s was ripped to %s already.\n", discid,
+				(index->dir != NULL) ? index->dir : cfg->musicdir);
+		tsr_index_free(index);
+
+		return 1;
+	}
+
+	rip = tsr_encode_start(source, index, drive->pool, cfg);
+	metainfo = tsr_daemon_metainfo(source, discid, &from, cfg);
+
+	if (metainfo == NULL)
+	{
+		fprintf(stderr, "No album information for disc %s.\n", discid);
+		tsr_encode_abort(rip);
+		tsr_index_free(index);
+
+		return 0;
+	}
+
+	printf("Ripping %s with the album information from %s.\n",
+			metainfo->album, from);
+	metainfo->discnum = 0;
+
+	/* the placeholder is not worth keeping, the cache has it already */
+	if (strcmp(from, "cache") && strcmp(from, "placeholder")
+			&& !tsr_mbcache_put(discid, metainfo, cfg))
+	{
+		fprintf(stderr, "Can't cache the album information in %s.\n", cfg->mbcache);
+	}
+
+	if (!tsr_encode_finish(rip, metainfo, drive->quiet))
+	{
+		fprintf(stderr, "Can't rip disc %s, it is left in %s.\n", discid,
+				cfg->musicdir);
+		ok = 0;
+	}
+
+	tsr_index_free(index);
+	tsr_metainfo_free(metainfo);
+	free(from);
+
+	return ok;
+}
+
+/*
+ * Thread function, rip every disc put into the drive. A disc is only ripped
+ * once while it stays in the drive, even if it can't be ejected.
+ *
+ */
+static void *tsr_daemon_watch(void *arg)
+{
+	tsr_daemon_drive_t *drive = (tsr_daemon_drive_t *) arg;
+	tsr_source_t *source;
+	char *discid, *device, *last = NULL;
+	int waiting = 0;
+
+	while (1)
+	{
+		source = tsr_source_open(drive->spec, drive->cfg);
+
+		if (source == NULL)
+		{
+			free(last);
+			last = NULL;
+			waiting = 0;
+			sleep(drive->cfg->poll);
+			continue;
+		}
+
+		discid = tsr_toc_discid(&source->toc);
+
+		if ((last != NULL && !strcmp(discid, last))
+				|| !tsr_daemon_claim(drive, discid))
+		{
+			if (!waiting && (last == NULL || strcmp(discid, last)))
+			{
+				printf("\nDisc %s in %s is ripped in another drive, waiting.\n",
+						discid, source->name);
+				fflush(stdout);
+				waiting = 1;
+			}
+
+			tsr_source_close(source);
+			free(discid);
+			sleep(drive->cfg->poll);
+			continue;
+		}
+
+		printf("\nFound disc %s in %s.\n", discid, source->name);
+		waiting = 0;
+
+		if (tsr_daemon_rip(drive, source, discid))
+		{
+			printf("\nDone with disc %s.\n", discid);
+		}
+
+		tsr_daemon_release(drive);
+
+		device = (source->device != NULL) ? strdup(source->device) : NULL;
+		tsr_source_close(source);
+		tsr_source_eject(device);
+		free(device);
+		free(last);
+		last = discid;
+		fflush(stdout);
+	}
+
+	return NULL;
+}
+
+/*
+ * Rip every disc put into the drives of cfg->drives, or into the source if
+ * there are none, until the daemon is killed. The progress is only printed
+ * with a single drive.
+ *
+ */
+int tsr_daemon_run(tsr_cfg_t *cfg)
+{
+	tsr_daemon_drive_t *drives;
+	tsr_daemon_discs_t discs;
+	tsr_pool_t *pool = NULL;
+	int numdrives, i, err;
+
+	numdrives = (cfg->numdrives > 0) ? cfg->numdrives : 1;
+	drives = (tsr_daemon_drive_t *) calloc(numdrives, sizeof(tsr_daemon_drive_t));
+
+	if (drives == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	if (cfg->jobs > 1)
+	{
+		pool = tsr_encode_pool_new(cfg);
+	}
+
+	memset(&discs, 0, sizeof(tsr_daemon_discs_t));
+	pthread_mutex_init(&discs.lock, NULL);
+
+	for (i = 0; i < numdrives; i++)
+	{
+		drives[i].spec = (cfg->numdrives > 0) ? cfg->drives[i] : cfg->source;
+		drives[i].pool = pool;
+		drives[i].discs = &discs;
+		drives[i].slot = i;
+		drives[i].quiet = numdrives > 1;
+		drives[i].cfg = cfg;
+		printf("Waiting for discs in %s.\n", (drives[i].spec != NULL) ?
+				drives[i].spec : cfg->device);
+	}
+
+	fflush(stdout);
+
+	for (i = 0; i < numdrives; i++)
+	{
+		err = pthread_create(&drives[i].thread, NULL, tsr_daemon_watch, &drives[i]);
+
+		if (err)
+		{
+			tsr_exit_error(__FILE__, __LINE__, err);
+		}
+	}
+
+	for (i = 0; i < numdrives; i++)
+	{
+		pthread_join(drives[i].thread, NULL);
+	}
+
+	return EXIT_SUCCESS;
+}
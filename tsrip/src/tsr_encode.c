@@ -0,0 +1,1127 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_encode.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Encoding of a whole disc. The reader thread reads every sector once, and
+ * every configured output gets its own encoder: either a thread which takes
+ * the sectors from the reader's ring while they are read, or, with --jobs,
+ * jobs for a pool of threads which encode whole spooled tracks.
+ *
+ * The rip starts as soon as the toc is known and runs in the background
+ * while the metainfo is looked up and edited. The files are written
+ * untagged under a temporary name, when the metainfo is final they get
+ * their tags in place and are renamed.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_encode.h"
+#include "tsr_vorbis_track.h"
+#include "tsr_flac_track.h"
+#include "tsr_reader.h"
+#include "tsr_pool.h"
+#include "tsr_tags.h"
+#include "tsr_cue.h"
+#include "tsr_toc.h"
+#include "tsr_util.h"
+
+/*
+ * An encoder for one output, reading from the reader's ring.
+ *
+ */
+typedef struct _tsr_encoder_t
+{
+	int output;
+	int tracknum;
+	long encoded;
+	long numsectors;
+	int done;
+	int failed;
+	char *discid;
+	tsr_toc_t *toc;
+	tsr_reader_t *reader;
+	tsr_stats_t *stats;
+	tsr_perf_t perf;
+	tsr_trackfile_t *discfile;
+	tsr_cfg_t *cfg;
+	pthread_t thread;
+} tsr_encoder_t;
+
+/*
+ * The rip running in the background, from the start of reading until the
+ * files got their tags and names.
+ *
+ */
+struct _tsr_rip_t
+{
+	tsr_source_t *source;
+	tsr_index_t *index;
+	tsr_journal_t *journal;
+	tsr_accurip_t *accurip;
+	tsr_loudness_t *loudness;
+	tsr_stats_t *stats;
+	tsr_reader_t *reader;
+	tsr_pool_t *pool;
+	tsr_toc_t tracks;
+	char *discid;
+	int reported;
+	int quiet;
+	int aborted;
+	int failed;
+	tsr_cfg_t *cfg;
+	pthread_t thread;
+};
+
+/*
+ * Data the pool threads need to create the trackfiles.
+ *
+ */
+typedef struct _tsr_encode_ctx_t
+{
+	char *discid;
+	tsr_journal_t *journal;
+	tsr_stats_t *stats;
+	tsr_cfg_t *cfg;
+} tsr_encode_ctx_t;
+
+/*
+ * Create the untagged trackfile for the given output of the disc.
+ *
+ */
+tsr_trackfile_t *tsr_encode_trackfile_init(int tracknum, char *discid,
+		tsr_output_t *output, tsr_cfg_t *cfg)
+{
+	char *filename;
+	tsr_trackfile_t *trackfile = NULL;
+
+	filename = tsr_get_tmpfilename(cfg, discid, tracknum, output->ext);
+
+	switch(output->enctype)
+	{
+		case CFG_TYPE_VORBIS:
+			trackfile = tsr_vorbisfile_init(tracknum, filename, NULL,
+					output->quality, cfg);
+			break;
+		case CFG_TYPE_FLAC:
+			trackfile = tsr_flacfile_init(tracknum, filename, NULL, cfg);
+			break;
+	}
+
+	return trackfile;
+}
+
+/*
+ * Encode the specified track, the sectors are taken from the reader's ring.
+ * Tracks the journal has as done are left out, if only this output is done
+ * the sectors are taken without encoding them. With a file per disc the
+ * tracks go into the file of the encoder, which is finished with the last
+ * track. Returns 0 if the reader failed.
+ *
+ */
+int tsr_encode_track(tsr_encoder_t *encoder, int tracknum)
+{
+	char *read_buffer;
+	char *filename;
+	int sectors, last, i;
+	long fsec, lsec, cursor;
+	tsr_trackfile_t *trackfile;
+	tsr_ring_t *ring = encoder->reader->ring;
+	tsr_stats_t *stats;
+	uint64_t t;
+
+	stats = (encoder->stats != NULL) ? &encoder->stats[tracknum] : NULL;
+
+	if (tsr_journal_skip(encoder->reader->journal, tracknum))
+	{
+		if (stats != NULL)
+		{
+			tsr_stats_finish(stats);
+		}
+
+		return 1;
+	}
+
+	fsec = encoder->toc->firstsector[tracknum];
+	lsec = encoder->toc->lastsector[tracknum];
+	last = !encoder->cfg->singlefile || tracknum == encoder->toc->numtracks - 1;
+	trackfile = NULL;
+
+	if (!tsr_journal_skip_output(encoder->reader->journal, tracknum, encoder->output))
+	{
+		if (!encoder->cfg->singlefile)
+		{
+			trackfile = tsr_encode_trackfile_init(tracknum, encoder->discid,
+					&encoder->cfg->outputs[encoder->output], encoder->cfg);
+		}
+		else if ((trackfile = encoder->discfile) == NULL)
+		{
+			trackfile = tsr_encode_trackfile_init(TSR_DISC, encoder->discid,
+					&encoder->cfg->outputs[encoder->output], encoder->cfg);
+			encoder->discfile = trackfile;
+		}
+
+		trackfile->stats = stats;
+	}
+
+	__atomic_store_n(&encoder->encoded, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&encoder->numsectors, lsec - fsec + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&encoder->tracknum, tracknum, __ATOMIC_RELAXED);
+	cursor = fsec;
+
+	while (cursor <= lsec)
+	{
+		sectors = (lsec - cursor + 1 < encoder->cfg->batch) ?
+			lsec - cursor + 1 : encoder->cfg->batch;
+		t = tsr_stats_start(stats);
+		read_buffer = tsr_ring_read_slots(ring, encoder->output, sectors, &sectors);
+		tsr_stats_stop(stats, TSR_STAGE_WAIT, t);
+
+		if (!read_buffer)
+		{
+			if (trackfile != NULL)
+			{
+				tsr_trackfile_fail(trackfile);
+			}
+
+			return 0;
+		}
+
+		if (trackfile != NULL)
+		{
+			trackfile->encode(trackfile, (int8_t *) read_buffer, sectors);
+		}
+
+		tsr_ring_read_commit(ring, encoder->output, sectors);
+		cursor += sectors;
+		__atomic_store_n(&encoder->encoded, cursor - fsec, __ATOMIC_RELAXED);
+	}
+
+	if (trackfile != NULL && last)
+	{
+		filename = trackfile->filename;
+
+		if (trackfile->finish(trackfile))
+		{
+			/* the file of the disc has all tracks, or none */
+			for (i = (encoder->cfg->singlefile) ? 0 : tracknum; i <= tracknum; i++)
+			{
+				tsr_journal_done(encoder->reader->journal, i, encoder->output,
+						filename);
+			}
+		}
+	}
+
+	if (stats != NULL)
+	{
+		tsr_perf_account(&encoder->perf, stats);
+		tsr_stats_finish(stats);
+	}
+
+	return 1;
+}
+
+/*
+ * Thread function, encode all tracks for one output.
+ *
+ */
+void *tsr_encode_run(void *arg)
+{
+	tsr_encoder_t *encoder = (tsr_encoder_t *) arg;
+	int i;
+
+	if (encoder->stats != NULL)
+	{
+		tsr_perf_open(&encoder->perf);
+	}
+
+	for (i = 0; i < encoder->toc->numtracks; i++)
+	{
+		if (!tsr_encode_track(encoder, i))
+		{
+			encoder->failed = 1;
+			break;
+		}
+	}
+
+	if (encoder->stats != NULL)
+	{
+		tsr_perf_close(&encoder->perf);
+	}
+
+	__atomic_store_n(&encoder->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ * Print the progress of all encoders in a single line.
+ *
+ */
+void tsr_encode_print_progress(tsr_encoder_t *encoders, int numencoders,
+		int numtracks)
+{
+	int i, tracknum, slowest = 0;
+	long p, pslowest = 100;
+
+	for (i = 0; i < numencoders; i++)
+	{
+		tracknum = __atomic_load_n(&encoders[i].tracknum, __ATOMIC_RELAXED);
+		p = __atomic_load_n(&encoders[i].encoded, __ATOMIC_RELAXED) * 100
+			/ __atomic_load_n(&encoders[i].numsectors, __ATOMIC_RELAXED);
+
+		if (i == 0 || tracknum < slowest || (tracknum == slowest && p < pslowest))
+		{
+			slowest = tracknum;
+			pslowest = p;
+		}
+	}
+
+	printf("\rEncoding Track No. %02i/%02i... %3li%%", slowest + 1, numtracks,
+			pslowest);
+
+	if (encoders[0].reader->source->riplog != NULL)
+	{
+		tsr_riplog_print_rates(encoders[0].reader->source->riplog);
+	}
+
+	for (i = 0; numencoders > 1 && i < numencoders; i++)
+	{
+		p = __atomic_load_n(&encoders[i].encoded, __ATOMIC_RELAXED) * 100
+			/ __atomic_load_n(&encoders[i].numsectors, __ATOMIC_RELAXED);
+		printf(" | %s %02i: %3li%%", encoders[i].cfg->outputs[encoders[i].output].name,
+				__atomic_load_n(&encoders[i].tracknum, __ATOMIC_RELAXED) + 1, p);
+	}
+
+	fflush(stdout);
+}
+
+/*
+ * Print the stats of the tracks which are done since the last call, in
+ * order of the tracks.
+ *
+ */
+void tsr_encode_report_tracks(tsr_stats_t *stats, int *reported, int numtracks)
+{
+	char title[32];
+
+	while (stats != NULL && *reported < numtracks
+			&& __atomic_load_n(&stats[*reported].end, __ATOMIC_ACQUIRE))
+	{
+		snprintf(title, sizeof(title), "Track %02i", *reported + 1);
+		printf("\n");
+		tsr_stats_print(stdout, &stats[*reported], title);
+		(*reported)++;
+	}
+}
+
+/*
+ * Print the stats of the whole disc and write the json report.
+ *
+ */
+void tsr_encode_report_disc(tsr_stats_t *stats, int numtracks, tsr_cfg_t *cfg)
+{
+	tsr_stats_t *disc;
+	int i;
+
+	disc = tsr_stats_new(1, 0);
+
+	for (i = 0; i < numtracks; i++)
+	{
+		tsr_stats_merge(disc, &stats[i]);
+	}
+
+	printf("\n");
+	tsr_stats_print(stdout, disc, "Disc");
+	free(disc);
+
+	if (!tsr_stats_write_json(cfg->stats, stats, numtracks))
+	{
+		fprintf(stderr, "Can't write stats to %s: %s\n", cfg->stats, strerror(errno));
+	}
+}
+
+/*
+ * Encode all tracks while they are read, one thread per output. The
+ * progress is only printed while the rip is not quiet.
+ *
+ */
+void tsr_encode_stream(tsr_rip_t *rip)
+{
+	tsr_encoder_t *encoders;
+	tsr_cfg_t *cfg = rip->cfg;
+	struct timespec ts = {0, 250000000L};
+	int i, err, done;
+
+	encoders = (tsr_encoder_t *) calloc(cfg->numoutputs, sizeof(tsr_encoder_t));
+
+	if (encoders == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	for (i = 0; i < cfg->numoutputs; i++)
+	{
+		encoders[i].output = i;
+		encoders[i].numsectors = 1;
+		encoders[i].discid = rip->discid;
+		encoders[i].toc = &rip->tracks;
+		encoders[i].reader = rip->reader;
+		encoders[i].stats = rip->stats;
+		encoders[i].cfg = cfg;
+		err = pthread_create(&encoders[i].thread, NULL, tsr_encode_run, &encoders[i]);
+
+		if (err)
+		{
+			tsr_exit_error(__FILE__, __LINE__, err);
+		}
+	}
+
+	do
+	{
+		nanosleep(&ts, NULL);
+
+		for (i = 0, done = 0; i < cfg->numoutputs; i++)
+		{
+			done += __atomic_load_n(&encoders[i].done, __ATOMIC_ACQUIRE);
+		}
+
+		if (!__atomic_load_n(&rip->quiet, __ATOMIC_ACQUIRE))
+		{
+			tsr_encode_print_progress(encoders, cfg->numoutputs,
+					rip->tracks.numtracks);
+			tsr_encode_report_tracks(rip->stats, &rip->reported,
+					rip->tracks.numtracks);
+		}
+	} while (done < cfg->numoutputs);
+
+	for (i = 0; i < cfg->numoutputs; i++)
+	{
+		pthread_join(encoders[i].thread, NULL);
+		rip->failed |= encoders[i].failed;
+	}
+
+	if (rip->failed && !__atomic_load_n(&rip->aborted, __ATOMIC_ACQUIRE))
+	{
+		printf("\n");
+		fflush(stdout); fprintf(stderr, "\nError reading Track %i\n",
+				rip->reader->failtrack);
+	}
+
+	free(encoders);
+}
+
+/*
+ * Encode a spooled track, called by the pool threads.
+ *
+ */
+void tsr_encode_job(tsr_job_t *job, void *arg)
+{
+	tsr_encode_ctx_t *ctx = (tsr_encode_ctx_t *) arg;
+	tsr_trackfile_t *trackfile;
+	tsr_stats_t *stats;
+	tsr_perf_t perf;
+	char *filename;
+	long i;
+	int sectors;
+
+	stats = (ctx->stats != NULL) ? &ctx->stats[job->tracknum] : NULL;
+
+	if (stats != NULL)
+	{
+		tsr_perf_open(&perf);
+	}
+
+	trackfile = tsr_encode_trackfile_init(job->tracknum, ctx->discid,
+			&ctx->cfg->outputs[job->output], ctx->cfg);
+	trackfile->stats = stats;
+
+	for (i = 0; i < job->spool->numsectors; i += sectors)
+	{
+		sectors = (job->spool->numsectors - i < ctx->cfg->batch) ?
+			job->spool->numsectors - i : ctx->cfg->batch;
+		trackfile->encode(trackfile, (int8_t *) job->spool->pcm + i * CD_FRAMESIZE_RAW,
+				sectors);
+		__atomic_store_n(&job->encoded, i + sectors, __ATOMIC_RELAXED);
+	}
+
+	filename = trackfile->filename;
+
+	if (trackfile->finish(trackfile))
+	{
+		tsr_journal_done(ctx->journal, job->tracknum, job->output, filename);
+	}
+
+	if (stats != NULL)
+	{
+		tsr_perf_account(&perf, stats);
+		tsr_perf_close(&perf);
+		tsr_stats_finish(stats);
+	}
+}
+
+/*
+ * Create a pool of cfg->jobs threads encoding spooled tracks, which can be
+ * shared by the rips of several drives.
+ *
+ */
+tsr_pool_t *tsr_encode_pool_new(tsr_cfg_t *cfg)
+{
+	return tsr_pool_new(cfg->jobs, tsr_encode_job);
+}
+
+/*
+ * Print the reading progress and the progress of all running jobs in a
+ * single line. rtrack is 0 when all tracks have been read, riplog may be
+ * NULL.
+ *
+ */
+void tsr_encode_print_jobs(tsr_job_t **jobs, int numjobs, int numtracks,
+		int rtrack, long p, tsr_riplog_t *riplog, tsr_cfg_t *cfg)
+{
+	int i;
+	long encoded;
+
+	if (rtrack > 0)
+	{
+		printf("\rReading Track No. %02i/%02i... %3li%%", rtrack, numtracks, p);
+
+		if (riplog != NULL)
+		{
+			tsr_riplog_print_rates(riplog);
+		}
+	}
+	else
+	{
+		printf("\rReading done.");
+	}
+
+	for (i = 0; i < numjobs; i++)
+	{
+		if (jobs[i] == NULL
+				|| __atomic_load_n(&jobs[i]->state, __ATOMIC_ACQUIRE) != TSR_JOB_RUNNING)
+		{
+			continue;
+		}
+
+		encoded = __atomic_load_n(&jobs[i]->encoded, __ATOMIC_RELAXED);
+		printf(" | %02i", jobs[i]->tracknum + 1);
+
+		if (cfg->numoutputs > 1)
+		{
+			printf(" %s", cfg->outputs[jobs[i]->output].name);
+		}
+
+		printf(": %3li%%", encoded * 100 / jobs[i]->numsectors);
+	}
+
+	printf("        ");
+	fflush(stdout);
+}
+
+/*
+ * Spool the specified track from the reader's ring into memory and hand it
+ * over to the encoder pool, once for every output which is not done yet.
+ * Tracks the journal has as done are left out. Returns 0 if the track
+ * can't be read or the rip was aborted.
+ *
+ */
+int tsr_encode_spool_track(int tracknum, tsr_rip_t *rip, tsr_queue_t *queue,
+		tsr_job_t **jobs, tsr_stats_t *stats)
+{
+	char *read_buffer;
+	int rtrack, sectors, i, refs;
+	long fsec, lsec, cursor, p, pp;
+	tsr_reader_t *reader = rip->reader;
+	tsr_toc_t *toc = &rip->tracks;
+	tsr_cfg_t *cfg = rip->cfg;
+	tsr_spool_t *spool;
+	uint64_t t;
+
+	if (tsr_journal_skip(reader->journal, tracknum))
+	{
+		for (i = 0; stats != NULL && i < cfg->numoutputs; i++)
+		{
+			tsr_stats_finish(stats);
+		}
+
+		return 1;
+	}
+
+	for (i = 0, refs = 0; i < cfg->numoutputs; i++)
+	{
+		if (!tsr_journal_skip_output(reader->journal, tracknum, i))
+		{
+			refs++;
+		}
+		else if (stats != NULL)
+		{
+			tsr_stats_finish(stats);
+		}
+	}
+
+	rtrack = tracknum + 1;
+	fsec = toc->firstsector[tracknum];
+	lsec = toc->lastsector[tracknum];
+	spool = tsr_spool_new(lsec - fsec + 1, refs);
+	pp = -1;
+
+	for (cursor = fsec; cursor <= lsec; cursor += sectors)
+	{
+		sectors = (lsec - cursor + 1 < cfg->batch) ? lsec - cursor + 1 : cfg->batch;
+		t = tsr_stats_start(stats);
+		read_buffer = tsr_ring_read_slots(reader->ring, 0, sectors, &sectors);
+		tsr_stats_stop(stats, TSR_STAGE_WAIT, t);
+
+		if (!read_buffer)
+		{
+			if (!__atomic_load_n(&rip->aborted, __ATOMIC_ACQUIRE))
+			{
+				printf("\n");
+				fflush(stdout); fprintf(stderr, "\nError reading Track %i\n",
+						reader->failtrack);
+			}
+
+			rip->failed = 1;
+			free(spool->pcm);
+			free(spool);
+
+			return 0;
+		}
+
+		memcpy(spool->pcm + (cursor - fsec) * CD_FRAMESIZE_RAW, read_buffer,
+				(size_t) sectors * CD_FRAMESIZE_RAW);
+		tsr_ring_read_commit(reader->ring, 0, sectors);
+		p = (cursor + sectors - fsec) * 100 / (lsec - fsec + 1);
+
+		if (p != pp && !__atomic_load_n(&rip->quiet, __ATOMIC_ACQUIRE))
+		{
+			tsr_encode_print_jobs(jobs, toc->numtracks * cfg->numoutputs,
+					toc->numtracks, rtrack, p, reader->source->riplog, cfg);
+		}
+
+		pp = p;
+	}
+
+	for (i = 0; i < cfg->numoutputs; i++)
+	{
+		if (tsr_journal_skip_output(reader->journal, tracknum, i))
+		{
+			continue;
+		}
+
+		jobs[tracknum * cfg->numoutputs + i] = tsr_job_new(tracknum, i, spool);
+		tsr_pool_submit(rip->pool, queue, jobs[tracknum * cfg->numoutputs + i]);
+	}
+
+	return 1;
+}
+
+/*
+ * Read all tracks into memory and encode them with the pool of the rip, or
+ * cfg->jobs tracks at once if it has none. The progress is only printed
+ * while the rip is not quiet.
+ *
+ */
+void tsr_encode_parallel(tsr_rip_t *rip)
+{
+	int i, numjobs, numtracks = rip->tracks.numtracks;
+	tsr_stats_t *stats = rip->stats;
+	tsr_cfg_t *cfg = rip->cfg;
+	tsr_encode_ctx_t ctx;
+	tsr_queue_t *queue;
+	tsr_pool_t *pool;
+	tsr_job_t **jobs;
+
+	ctx.discid = rip->discid;
+	ctx.journal = rip->journal;
+	ctx.stats = stats;
+	ctx.cfg = cfg;
+	numjobs = numtracks * cfg->numoutputs;
+	jobs = (tsr_job_t **) calloc(numjobs, sizeof(tsr_job_t *));
+
+	if (jobs == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	pool = rip->pool;
+
+	if (pool == NULL)
+	{
+		rip->pool = tsr_encode_pool_new(cfg);
+	}
+
+	queue = tsr_pool_queue_new(rip->pool, &ctx);
+
+	for (i = 0; i < numtracks; i++)
+	{
+		if (!tsr_encode_spool_track(i, rip, queue, jobs,
+					(stats != NULL) ? &stats[i] : NULL))
+		{
+			break;
+		}
+
+		if (!__atomic_load_n(&rip->quiet, __ATOMIC_ACQUIRE))
+		{
+			tsr_encode_report_tracks(stats, &rip->reported, numtracks);
+		}
+	}
+
+	while (tsr_pool_wait(rip->pool, queue, 250) > 0)
+	{
+		if (!__atomic_load_n(&rip->quiet, __ATOMIC_ACQUIRE))
+		{
+			tsr_encode_print_jobs(jobs, numjobs, numtracks, 0, 0, NULL, cfg);
+			tsr_encode_report_tracks(stats, &rip->reported, numtracks);
+		}
+	}
+
+	tsr_pool_queue_free(rip->pool, queue);
+
+	if (pool == NULL)
+	{
+		tsr_pool_free(rip->pool);
+		rip->pool = NULL;
+	}
+
+	for (i = 0; i < numjobs; i++)
+	{
+		free(jobs[i]);
+	}
+
+	free(jobs);
+}
+
+/*
+ * Append the read errors of the drive and the checksums of the tracks to
+ * the rip log.
+ *
+ */
+void tsr_encode_riplog(tsr_source_t *source, tsr_accurip_t *accurip,
+		tsr_metainfo_t *metainfo, tsr_cfg_t *cfg)
+{
+	FILE *fp;
+
+	if (source->riplog != NULL
+			&& !tsr_riplog_write(source->riplog, cfg->riplog, source->name, metainfo))
+	{
+		fprintf(stderr, "Can't write rip log %s: %s\n", cfg->riplog, strerror(errno));
+
+		return;
+	}
+
+	if (accurip == NULL)
+	{
+		return;
+	}
+
+	fp = (!strcmp(cfg->riplog, "-")) ? stdout : fopen(cfg->riplog, "a");
+
+	if (fp == NULL)
+	{
+		fprintf(stderr, "Can't write rip log %s: %s\n", cfg->riplog, strerror(errno));
+
+		return;
+	}
+
+	tsr_accurip_print(fp, accurip);
+	fprintf(fp, "\n");
+
+	if (fp != stdout)
+	{
+		fclose(fp);
+	}
+}
+
+/*
+ * Thread function, read the disc and encode all tracks. The file of a whole
+ * disc is always encoded while the disc is read.
+ *
+ */
+static void *tsr_encode_rip(void *arg)
+{
+	tsr_rip_t *rip = (tsr_rip_t *) arg;
+
+	if (rip->cfg->jobs > 1 && !rip->cfg->singlefile)
+	{
+		tsr_encode_parallel(rip);
+	}
+	else
+	{
+		tsr_encode_stream(rip);
+	}
+
+	return NULL;
+}
+
+/*
+ * Start reading the disc from the source once and encoding all tracks for
+ * all outputs, except the files the index has already. The rip is quiet
+ * until tsr_encode_finish, so the metainfo can be asked for meanwhile.
+ * index may be NULL, the tracks are encoded by pool if it is not NULL and
+ * cfg->jobs is more than one.
+ *
+ */
+tsr_rip_t *tsr_encode_start(tsr_source_t *source, tsr_index_t *index,
+		tsr_pool_t *pool, tsr_cfg_t *cfg)
+{
+	tsr_rip_t *rip;
+	int track, err;
+
+	rip = (tsr_rip_t *) calloc(1, sizeof(tsr_rip_t));
+
+	if (rip == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	rip->source = source;
+	rip->index = index;
+	rip->pool = pool;
+	rip->tracks = source->toc;
+	rip->discid = tsr_toc_discid(&source->toc);
+	rip->quiet = 1;
+	rip->cfg = cfg;
+
+	if (cfg->stats != NULL)
+	{
+		rip->stats = tsr_stats_new(rip->tracks.numtracks, cfg->numoutputs);
+	}
+
+	if (cfg->accurip != NULL || cfg->riplog != NULL || index != NULL)
+	{
+		rip->accurip = tsr_accurip_new(&source->toc, cfg->accurip,
+				cfg->readoffset);
+	}
+
+	if (cfg->replaygain)
+	{
+		rip->loudness = tsr_loudness_new(rip->tracks.numtracks);
+	}
+
+	rip->journal = tsr_journal_open(&source->toc, cfg);
+	tsr_index_mark(index, rip->journal);
+
+	for (track = 0; rip->loudness != NULL && track < rip->tracks.numtracks; track++)
+	{
+		if (rip->journal->measured[track])
+		{
+			tsr_loudness_restore(rip->loudness, track, rip->journal->peaks[track],
+					rip->journal->blocks[track], rip->journal->numblocks[track]);
+		}
+	}
+
+	if (tsr_journal_skipped(rip->journal) > 0)
+	{
+		printf("Resuming, %i of %i tracks are done already.\n",
+				tsr_journal_skipped(rip->journal), rip->tracks.numtracks);
+	}
+
+	rip->reader = tsr_reader_start(source, &rip->tracks, cfg->ringsize,
+			(cfg->jobs > 1 && !cfg->singlefile) ? 1 : cfg->numoutputs, rip->stats, rip->accurip,
+			rip->loudness, rip->journal);
+	err = pthread_create(&rip->thread, NULL, tsr_encode_rip, rip);
+
+	if (err)
+	{
+		tsr_exit_error(__FILE__, __LINE__, err);
+	}
+
+	return rip;
+}
+
+/*
+ * Free the rip and what it used.
+ *
+ */
+static void tsr_encode_free(tsr_rip_t *rip)
+{
+	if (rip->accurip != NULL)
+	{
+		tsr_accurip_free(rip->accurip);
+	}
+
+	if (rip->loudness != NULL)
+	{
+		tsr_loudness_free(rip->loudness);
+	}
+
+	free(rip->stats);
+	free(rip->discid);
+	free(rip);
+}
+
+/*
+ * Free a rip which was not finished. The files which are done are kept
+ * with the journal, so the next run picks them up, without a journal they
+ * are removed.
+ *
+ */
+static void tsr_encode_keep(tsr_rip_t *rip)
+{
+	char *file;
+	int i;
+
+	for (i = 0; rip->journal->file == NULL
+			&& i < rip->tracks.numtracks * rip->cfg->numoutputs; i++)
+	{
+		if ((file = rip->journal->files[i]) != NULL)
+		{
+			unlink(file);
+		}
+	}
+
+	tsr_journal_finish(rip->journal, 1);
+	tsr_encode_free(rip);
+}
+
+/*
+ * Stop the rip, as there is no metainfo for the disc.
+ *
+ */
+void tsr_encode_abort(tsr_rip_t *rip)
+{
+	__atomic_store_n(&rip->aborted, 1, __ATOMIC_RELEASE);
+	tsr_ring_close(rip->reader->ring, ECANCELED);
+	pthread_join(rip->thread, NULL);
+	tsr_reader_stop(rip->reader);
+	tsr_encode_keep(rip);
+}
+
+/*
+ * Write the tags with the cue sheet into the files of the whole disc, move
+ * them to their names and write the cue sheets next to them. A single
+ * output has the cue sheet named like the album, several add their
+ * extension.
+ *
+ */
+static void tsr_encode_tag_disc(tsr_rip_t *rip, tsr_metainfo_t *metainfo)
+{
+	tsr_output_t *output;
+	char **files = rip->journal->files, *filename, *cuefile, *cuesheet, **tags;
+	int numoutputs = rip->cfg->numoutputs, track, i;
+
+	for (i = 0; i < numoutputs; i++)
+	{
+		output = &rip->cfg->outputs[i];
+
+		if (files[i] == NULL)
+		{
+			continue;
+		}
+
+		filename = tsr_get_filename(rip->cfg, metainfo, TSR_DISC, output->ext);
+		cuesheet = tsr_cue_new(&rip->tracks, metainfo, rip->loudness, filename);
+		tags = tsr_tags_new_disc(metainfo, cuesheet);
+		tsr_tags_add_gain(tags, rip->loudness, TSR_DISC);
+
+		if (!tsr_tags_write(files[i], output, tags))
+		{
+			fprintf(stderr, "\nCan't write the tags of %s\n", filename);
+		}
+
+		tsr_tags_free(tags);
+
+		if (rename(files[i], filename) == -1)
+		{
+			fprintf(stderr, "\nCan't move %s to %s: %s\n", files[i], filename,
+					strerror(errno));
+			free(filename);
+			free(cuesheet);
+
+			continue;
+		}
+
+		if (numoutputs == 1)
+		{
+			asprintf(&cuefile, "%.*s.cue",
+					(int) (strlen(filename) - strlen(output->ext) - 1), filename);
+		}
+		else
+		{
+			asprintf(&cuefile, "%s.cue", filename);
+		}
+
+		if (!tsr_cue_write(cuefile, cuesheet))
+		{
+			fprintf(stderr, "\nCan't write the cue sheet %s: %s\n", cuefile,
+					strerror(errno));
+		}
+
+		for (track = 0; track < rip->tracks.numtracks; track++)
+		{
+			free(files[track * numoutputs + i]);
+			files[track * numoutputs + i] = strdup(filename);
+		}
+
+		free(cuefile);
+		free(cuesheet);
+		free(filename);
+	}
+}
+
+/*
+ * Write the tags of the files written by the rip and move them to their
+ * names. The files of tracks the metainfo has no information for are
+ * removed.
+ *
+ */
+void tsr_encode_tag_files(tsr_rip_t *rip, tsr_metainfo_t *metainfo)
+{
+	tsr_output_t *output;
+	char **file, *filename, **tags;
+	int track, i;
+
+	if (rip->cfg->singlefile)
+	{
+		tsr_encode_tag_disc(rip, metainfo);
+
+		return;
+	}
+
+	for (track = 0; track < rip->tracks.numtracks; track++)
+	{
+		for (i = 0; i < rip->cfg->numoutputs; i++)
+		{
+			file = &rip->journal->files[track * rip->cfg->numoutputs + i];
+			output = &rip->cfg->outputs[i];
+
+			if (*file == NULL)
+			{
+				continue;
+			}
+
+			if (track >= metainfo->numtracks)
+			{
+				unlink(*file);
+				free(*file);
+				*file = NULL;
+
+				continue;
+			}
+
+			filename = tsr_get_filename(rip->cfg, metainfo, track, output->ext);
+			tags = tsr_tags_new(track, metainfo);
+			tsr_tags_add_gain(tags, rip->loudness, track);
+
+			if (!tsr_tags_write(*file, output, tags))
+			{
+				fprintf(stderr, "\nCan't write the tags of %s\n", filename);
+			}
+
+			tsr_tags_free(tags);
+
+			if (rename(*file, filename) == -1)
+			{
+				fprintf(stderr, "\nCan't move %s to %s: %s\n", *file, filename,
+						strerror(errno));
+				free(filename);
+
+				continue;
+			}
+
+			free(*file);
+			*file = filename;
+		}
+	}
+}
+
+/*
+ * Finish the rip with the final metainfo: print the progress until all
+ * tracks are encoded unless quiet, then tag and rename the files and write
+ * the index and the rip log. Returns 0 if a track could not be read, the
+ * files done are kept for the next run then.
+ *
+ */
+int tsr_encode_finish(tsr_rip_t *rip, tsr_metainfo_t *metainfo, int quiet)
+{
+	tsr_cfg_t *cfg = rip->cfg;
+
+	if (metainfo->numtracks > rip->tracks.numtracks)
+	{
+		metainfo->numtracks = rip->tracks.numtracks;
+	}
+
+	__atomic_store_n(&rip->quiet, quiet, __ATOMIC_RELEASE);
+	pthread_join(rip->thread, NULL);
+	tsr_reader_stop(rip->reader);
+
+	if (rip->failed)
+	{
+		tsr_encode_keep(rip);
+
+		return 0;
+	}
+
+	tsr_encode_report_tracks(rip->stats, &rip->reported, rip->tracks.numtracks);
+
+	if (rip->loudness != NULL
+			&& tsr_loudness_measured(rip->loudness) < rip->tracks.numtracks)
+	{
+		fprintf(stderr, "\nThe ReplayGain album gain is left out, %i of %i tracks "
+				"were ripped before without measuring them.\n",
+				rip->tracks.numtracks - tsr_loudness_measured(rip->loudness),
+				rip->tracks.numtracks);
+	}
+
+	tsr_encode_tag_files(rip, metainfo);
+
+	if (!tsr_index_update(rip->index, rip->journal, rip->accurip))
+	{
+		fprintf(stderr, "Can't update the index %s: %s\n", rip->index->file,
+				strerror(errno));
+	}
+
+	tsr_journal_finish(rip->journal, 0);
+
+	if (cfg->riplog != NULL)
+	{
+		tsr_encode_riplog(rip->source, rip->accurip, metainfo, cfg);
+	}
+
+	if (rip->accurip != NULL && cfg->accurip != NULL)
+	{
+		printf("\n");
+		tsr_accurip_print(stdout, rip->accurip);
+	}
+
+	if (rip->stats != NULL)
+	{
+		tsr_encode_report_disc(rip->stats, rip->tracks.numtracks, cfg);
+	}
+
+	tsr_encode_free(rip);
+
+	return 1;
+}
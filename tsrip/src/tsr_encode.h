@@ -0,0 +1,39 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_encode.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include "tsr_source.h"
+#include "tsr_index.h"
+#include "tsr_pool.h"
+
+typedef struct _tsr_rip_t tsr_rip_t;
+
+tsr_trackfile_t *tsr_encode_trackfile_init(int tracknum, char *discid,
+		tsr_output_t *output, tsr_cfg_t *cfg);
+
+tsr_pool_t *tsr_encode_pool_new(tsr_cfg_t *cfg);
+
+tsr_rip_t *tsr_encode_start(tsr_source_t *source, tsr_index_t *index,
+		tsr_pool_t *pool, tsr_cfg_t *cfg);
+
+void tsr_encode_abort(tsr_rip_t *rip);
+
+int tsr_encode_finish(tsr_rip_t *rip, tsr_metainfo_t *metainfo, int quiet);
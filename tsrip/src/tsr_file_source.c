@@ -0,0 +1,402 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_file_source.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Sources reading files: wav files with one track each, or raw 16 bit
+ * little endian stereo pcm as one track, from a file or from stdin. Files are
+ * mapped into memory, a pipe on stdin is read into memory first since its
+ * length has to be known before encoding starts.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_source.h"
+#include "tsr_file_source.h"
+#include "tsr_util.h"
+
+/*
+ * Read an unaligned little endian integer of len bytes.
+ *
+ */
+static uint32_t tsr_le(const char *p, int len)
+{
+	uint32_t v = 0;
+
+	while (len--)
+	{
+		v = (v << 8) | (unsigned char) p[len];
+	}
+
+	return v;
+}
+
+/*
+ * Map the file into memory, or read it if it can't be mapped like a pipe.
+ * "-" is stdin. Returns 0 and sets errno on failure.
+ *
+ */
+static int tsr_filemap_open(tsr_filemap_t *fmap, char *file)
+{
+	struct stat st;
+	size_t size = 0;
+	ssize_t n;
+	char *buf;
+	int fd, err;
+
+	fd = (!strcmp(file, "-")) ? STDIN_FILENO : open(file, O_RDONLY);
+
+	if (fd == -1)
+	{
+		return 0;
+	}
+
+	if (fstat(fd, &st) == -1)
+	{
+		err = errno;
+
+		if (fd != STDIN_FILENO)
+		{
+			close(fd);
+		}
+
+		errno = err;
+
+		return 0;
+	}
+
+	if (S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		fmap->mapsize = st.st_size;
+		fmap->map = (char *) mmap(NULL, fmap->mapsize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (fmap->map != MAP_FAILED)
+		{
+			madvise(fmap->map, fmap->mapsize, MADV_SEQUENTIAL);
+			fmap->mapped = 1;
+			fmap->data = fmap->map;
+			fmap->datasize = fmap->mapsize;
+
+			if (fd != STDIN_FILENO)
+			{
+				close(fd);
+			}
+
+			return 1;
+		}
+	}
+
+	fmap->mapsize = 1 << 20;
+	fmap->map = (char *) malloc(fmap->mapsize);
+
+	while (fmap->map != NULL && (n = read(fd, fmap->map + size,
+					fmap->mapsize - size)) != 0)
+	{
+		if (n == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			err = errno;
+			free(fmap->map);
+
+			if (fd != STDIN_FILENO)
+			{
+				close(fd);
+			}
+
+			errno = err;
+
+			return 0;
+		}
+
+		size += n;
+
+		if (size == fmap->mapsize)
+		{
+			fmap->mapsize *= 2;
+			buf = (char *) realloc(fmap->map, fmap->mapsize);
+
+			if (buf == NULL)
+			{
+				free(fmap->map);
+			}
+
+			fmap->map = buf;
+		}
+	}
+
+	if (fmap->map == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, ENOMEM);
+	}
+
+	if (fd != STDIN_FILENO)
+	{
+		close(fd);
+	}
+
+	fmap->mapped = 0;
+	fmap->data = fmap->map;
+	fmap->datasize = size;
+
+	return 1;
+}
+
+/*
+ * Unmap or free the file.
+ *
+ */
+static void tsr_filemap_close(tsr_filemap_t *fmap)
+{
+	if (fmap->mapped)
+	{
+		munmap(fmap->map, fmap->mapsize);
+	}
+	else
+	{
+		free(fmap->map);
+	}
+}
+
+/*
+ * Find the pcm data of a wav file, only 16 bit stereo at 44.1 kHz can be
+ * encoded without resampling. Returns 0 if it's no such file.
+ *
+ */
+static int tsr_filemap_wav(tsr_filemap_t *fmap)
+{
+	char *p, *end;
+	uint32_t len;
+	int fmt = 0;
+
+	end = fmap->map + fmap->datasize;
+
+	if (fmap->datasize < 12 || memcmp(fmap->map, "RIFF", 4)
+			|| memcmp(fmap->map + 8, "WAVE", 4))
+	{
+		return 0;
+	}
+
+	for (p = fmap->map + 12; end - p >= 8; p += 8 + len + (len & 1))
+	{
+		len = tsr_le(p + 4, 4);
+
+		if (!memcmp(p, "fmt ", 4) && len >= 16 && end - p >= 24)
+		{
+			/* 1 is pcm, 0xfffe is extensible, which holds pcm here */
+			fmt = (tsr_le(p + 8, 2) == 1 || tsr_le(p + 8, 2) == 0xfffe)
+				&& tsr_le(p + 10, 2) == 2 && tsr_le(p + 12, 4) == 44100
+				&& tsr_le(p + 22, 2) == 16;
+		}
+		else if (!memcmp(p, "data", 4))
+		{
+			fmap->data = p + 8;
+
+			/* streamed wav files may have no or a wrong length */
+			fmap->datasize = (len == 0 || len > (size_t) (end - p - 8)) ?
+				(size_t) (end - p - 8) : len;
+
+			return fmt;
+		}
+
+		if ((size_t) (end - p - 8) < len)
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Get a sector, the sectors of all files follow each other.
+ *
+ */
+static char *tsr_file_source_read(tsr_source_t *source, long sector)
+{
+	tsr_file_source_t *fsource = (tsr_file_source_t *) source;
+	tsr_filemap_t *fmap;
+	size_t offset, len;
+
+	while (fsource->cur > 0 && sector < source->toc.firstsector[fsource->cur])
+	{
+		fsource->cur--;
+	}
+
+	while (fsource->cur < fsource->nummaps - 1
+			&& sector > source->toc.lastsector[fsource->cur])
+	{
+		fsource->cur++;
+	}
+
+	fmap = &fsource->maps[fsource->cur];
+	offset = (size_t) (sector - source->toc.firstsector[fsource->cur])
+		* CD_FRAMESIZE_RAW;
+
+	if (offset >= fmap->datasize)
+	{
+		return NULL;
+	}
+
+	len = fmap->datasize - offset;
+
+	return tsr_source_pcm(source, fmap->data + offset,
+			(len < CD_FRAMESIZE_RAW) ? len : CD_FRAMESIZE_RAW);
+}
+
+/*
+ * Unmap all files and free the source.
+ *
+ */
+static void tsr_file_source_close(tsr_source_t *source)
+{
+	tsr_file_source_t *fsource = (tsr_file_source_t *) source;
+	int i;
+
+	for (i = 0; i < fsource->nummaps; i++)
+	{
+		tsr_filemap_close(&fsource->maps[i]);
+	}
+
+	free(source->name);
+	free(fsource);
+}
+
+/*
+ * Create a source for the files in the list separated by commas. If wav is
+ * set, the files are wav files. Every file is a track.
+ *
+ */
+static tsr_source_t *tsr_file_source_open(char *files, int wav)
+{
+	tsr_file_source_t *fsource;
+	tsr_toc_t *toc;
+	char *list, *file, *save;
+	long sectors = 0;
+	int err;
+
+	fsource = (tsr_file_source_t *) malloc(sizeof(tsr_file_source_t));
+	list = strdup(files);
+
+	if (fsource == NULL || list == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	toc = &fsource->source.toc;
+	fsource->nummaps = 0;
+	fsource->cur = 0;
+	err = 0;
+
+	for (file = strtok_r(list, ",", &save); file != NULL && !err;
+			file = strtok_r(NULL, ",", &save))
+	{
+		if (fsource->nummaps == TSR_MAXTRACKS)
+		{
+			err = E2BIG;
+		}
+		else if (!tsr_filemap_open(&fsource->maps[fsource->nummaps], file))
+		{
+			err = errno;
+		}
+		else if ((wav && !tsr_filemap_wav(&fsource->maps[fsource->nummaps]))
+				|| fsource->maps[fsource->nummaps].datasize == 0)
+		{
+			tsr_filemap_close(&fsource->maps[fsource->nummaps]);
+			err = EINVAL;
+		}
+		else
+		{
+			toc->firstsector[fsource->nummaps] = sectors;
+			sectors += (fsource->maps[fsource->nummaps].datasize
+					+ CD_FRAMESIZE_RAW - 1) / CD_FRAMESIZE_RAW;
+			toc->lastsector[fsource->nummaps] = sectors - 1;
+			fsource->nummaps++;
+		}
+	}
+
+	free(list);
+
+	if (!err && fsource->nummaps == 0)
+	{
+		err = EINVAL;
+	}
+
+	if (err)
+	{
+		while (fsource->nummaps > 0)
+		{
+			tsr_filemap_close(&fsource->maps[--fsource->nummaps]);
+		}
+
+		free(fsource);
+		errno = err;
+
+		return NULL;
+	}
+
+	toc->numtracks = fsource->nummaps;
+	toc->leadout = sectors;
+	fsource->source.name = strdup(files);
+	fsource->source.device = NULL;
+	fsource->source.read = tsr_file_source_read;
+	fsource->source.speed = NULL;
+	fsource->source.fast = NULL;
+	fsource->source.riplog = NULL;
+	fsource->source.close = tsr_file_source_close;
+
+	return &fsource->source;
+}
+
+/*
+ * Open wav files, separated by commas, as tracks.
+ *
+ */
+tsr_source_t *tsr_wav_source_open(char *files)
+{
+	return tsr_file_source_open(files, 1);
+}
+
+/*
+ * Open raw pcm as a single track, "-" is stdin.
+ *
+ */
+tsr_source_t *tsr_raw_source_open(char *file)
+{
+	return tsr_file_source_open(file, 0);
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_file_source.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <stddef.h>
+
+typedef struct _tsr_filemap_t
+{
+	char *map;
+	size_t mapsize;
+	char *data;
+	size_t datasize;
+	int mapped;
+} tsr_filemap_t;
+
+typedef struct _tsr_file_source_t
+{
+	tsr_source_t source;
+	int nummaps;
+	int cur;
+	tsr_filemap_t maps[TSR_MAXTRACKS];
+} tsr_file_source_t;
+
+tsr_source_t *tsr_wav_source_open(char *files);
+
+tsr_source_t *tsr_raw_source_open(char *file);
@@ -0,0 +1,267 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_flac_track.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <cdda_interface.h>
+#include <FLAC/stream_encoder.h>
+#include <FLAC/metadata.h>
+
+#include "config.h"
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_flac_track.h"
+#include "tsr_pcm.h"
+#include "tsr_tags.h"
+#include "tsr_util.h"
+#include "tsr_writer.h"
+
+/*
+ * Write callback for libFLAC.
+ *
+ */
+static FLAC__StreamEncoderWriteStatus tsr_flacfile_write(const FLAC__StreamEncoder
+		*encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples,
+		uint32_t current_frame, void *client_data)
+{
+	tsr_flacfile_t *flacfile = (tsr_flacfile_t *) client_data;
+	uint64_t t;
+
+	t = tsr_stats_start(flacfile->trackfile.stats);
+	tsr_writer_write(flacfile->trackfile.writer, buffer, bytes);
+
+	if (flacfile->trackfile.stats != NULL)
+	{
+		t = tsr_stats_now() - t;
+		tsr_stats_add(flacfile->trackfile.stats, TSR_STAGE_WRITE, t);
+		flacfile->writetime += t;
+	}
+
+	return flacfile->trackfile.writer->error ?
+		FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR :
+		FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+/*
+ * Seek callback for libFLAC, needed to write the final stream info.
+ *
+ */
+static FLAC__StreamEncoderSeekStatus tsr_flacfile_seek(const FLAC__StreamEncoder
+		*encoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	tsr_flacfile_t *flacfile = (tsr_flacfile_t *) client_data;
+
+	if (tsr_writer_seek(flacfile->trackfile.writer, absolute_byte_offset))
+	{
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	}
+
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+/*
+ * Tell callback for libFLAC.
+ *
+ */
+static FLAC__StreamEncoderTellStatus tsr_flacfile_tell(const FLAC__StreamEncoder
+		*encoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	tsr_flacfile_t *flacfile = (tsr_flacfile_t *) client_data;
+
+	*absolute_byte_offset = tsr_writer_tell(flacfile->trackfile.writer);
+
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+
+/*
+ * Add a tag, given as "NAME=value", to the vorbis comment block.
+ *
+ */
+static void tsr_flacfile_add_tag(tsr_flacfile_t *flacfile, char *tag)
+{
+	FLAC__StreamMetadata_VorbisComment_Entry entry;
+
+	entry.length = strlen(tag);
+	entry.entry = (FLAC__byte *) tag;
+
+	if (!FLAC__metadata_object_vorbiscomment_append_comment(flacfile->metadata[0],
+				entry, 1))
+	{
+		tsr_exit_error(__FILE__, __LINE__, ENOMEM);
+	}
+}
+
+/*
+ * Encode next buffer of the given number of sectors. The cd samples are
+ * only widened to 32 bit, libFLAC takes integers.
+ *
+ */
+void tsr_flacfile_encode_next(tsr_trackfile_t *trackfile, int8_t *read_buffer,
+		int sectors)
+{
+	tsr_flacfile_t *flacfile = (tsr_flacfile_t *) trackfile;
+	uint64_t t;
+
+	if (sectors > flacfile->maxsectors)
+	{
+		free(flacfile->samples);
+		flacfile->samples = (FLAC__int32 *) malloc(sectors * CD_FRAMESAMPLES
+				* 2 * sizeof(FLAC__int32));
+
+		if (flacfile->samples == NULL)
+		{
+			tsr_exit_error(__FILE__, __LINE__, errno);
+		}
+
+		flacfile->maxsectors = sectors;
+	}
+
+	t = tsr_stats_start(trackfile->stats);
+	tsr_pcm_widen(read_buffer, flacfile->samples, sectors * CD_FRAMESAMPLES * 2);
+	tsr_stats_stop(trackfile->stats, TSR_STAGE_PCM, t);
+	t = tsr_stats_start(trackfile->stats);
+	flacfile->writetime = 0;
+
+	if (!flacfile->error && !FLAC__stream_encoder_process_interleaved(
+				flacfile->encoder, flacfile->samples,
+				sectors * CD_FRAMESAMPLES))
+	{
+		flacfile->error = 1;
+	}
+
+	/* the writes done by libFLAC are accounted on their own */
+	if (trackfile->stats != NULL)
+	{
+		tsr_stats_add(trackfile->stats, TSR_STAGE_ANALYSIS,
+				tsr_stats_now() - t - flacfile->writetime);
+	}
+}
+
+/* 
+ * Finish file. Returns 0 if it could not be written completely.
+ *
+ */
+int tsr_flacfile_finish(tsr_trackfile_t *trackfile)
+{
+	tsr_flacfile_t *flacfile = (tsr_flacfile_t *) trackfile;
+	int ok = 1;
+
+	if (!FLAC__stream_encoder_finish(flacfile->encoder))
+	{
+		flacfile->error = 1;
+	}
+
+	FLAC__stream_encoder_delete(flacfile->encoder);
+	FLAC__metadata_object_delete(flacfile->metadata[0]);
+	FLAC__metadata_object_delete(flacfile->metadata[1]);
+
+	if (tsr_writer_close(trackfile->writer) || flacfile->error)
+	{
+		fprintf(stderr, "\nError writing %s\n", trackfile->filename);
+		ok = 0;
+	}
+
+	free(flacfile->samples);
+	free(flacfile);
+
+	return ok;
+}
+
+/* 
+ * Initialize file, flac encoder and tags. Without metainfo the file is only
+ * tagged with the encoder, the tags are written later by tsr_tags_write.
+ *
+ */
+tsr_trackfile_t *tsr_flacfile_init(int tracknum, char *filename,
+		tsr_metainfo_t *metainfo, tsr_cfg_t *cfg)
+{
+	tsr_flacfile_t *flacfile;
+	FLAC__StreamEncoderInitStatus status;
+	char **tags;
+	int i;
+
+	flacfile = (tsr_flacfile_t *) malloc(sizeof(tsr_flacfile_t));
+
+	if (flacfile == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	flacfile->trackfile.writer = tsr_writer_open(filename, cfg->writebuffer);
+
+	if (!flacfile->trackfile.writer)
+	{
+		perror("tsr_flacfile_init: open");
+		exit(1);
+	}
+
+	flacfile->trackfile.filename = filename;
+	flacfile->trackfile.stats = NULL;
+	flacfile->writetime = 0;
+	flacfile->trackfile.encode = tsr_flacfile_encode_next;
+	flacfile->trackfile.finish = tsr_flacfile_finish;
+	flacfile->samples = NULL;
+	flacfile->maxsectors = 0;
+	flacfile->error = 0;
+	flacfile->encoder = FLAC__stream_encoder_new();
+	flacfile->metadata[0] = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+	flacfile->metadata[1] = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
+
+	if (!flacfile->encoder || !flacfile->metadata[0] || !flacfile->metadata[1])
+	{
+		tsr_exit_error(__FILE__, __LINE__, ENOMEM);
+	}
+
+	tags = tsr_tags_new(tracknum, metainfo);
+
+	for (i = 0; tags[i] != NULL; i++)
+	{
+		tsr_flacfile_add_tag(flacfile, tags[i]);
+	}
+
+	tsr_tags_free(tags);
+	flacfile->metadata[1]->length = (tracknum == TSR_DISC) ?
+		TSR_TAGS_DISC_PADDING : TSR_TAGS_PADDING;
+
+	FLAC__stream_encoder_set_channels(flacfile->encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(flacfile->encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(flacfile->encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(flacfile->encoder, cfg->flaclevel);
+	FLAC__stream_encoder_set_metadata(flacfile->encoder, flacfile->metadata, 2);
+#ifdef HAVE_FLAC__STREAM_ENCODER_SET_NUM_THREADS
+	FLAC__stream_encoder_set_num_threads(flacfile->encoder, cfg->flacthreads);
+#endif
+	status = FLAC__stream_encoder_init_stream(flacfile->encoder, tsr_flacfile_write,
+			tsr_flacfile_seek, tsr_flacfile_tell, NULL, flacfile);
+
+	if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+	{
+		fprintf(stderr, "tsr_flacfile_init: Can't initialize flac encoder.\n");
+		exit(1);
+	}
+
+	return (tsr_trackfile_t *) flacfile;
+}
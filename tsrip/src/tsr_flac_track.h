@@ -0,0 +1,40 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_flac_track.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <FLAC/stream_encoder.h>
+#include <FLAC/metadata.h>
+
+#include "tsr_types.h"
+
+typedef struct _tsr_flacfile_t
+{
+	tsr_trackfile_t trackfile;
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamMetadata *metadata[2];
+	FLAC__int32 *samples;
+	int maxsectors;
+	int error;
+	uint64_t writetime;
+} tsr_flacfile_t;
+
+tsr_trackfile_t *tsr_flacfile_init(int tracknum, char *filename,
+		tsr_metainfo_t *metainfo, tsr_cfg_t *cfg);
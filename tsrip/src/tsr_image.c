@@ -0,0 +1,440 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_image.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Raw disc images. An image is a single file with the audio of all tracks as
+ * raw little endian 16 bit stereo pcm, as cdparanoia returns it on x86, and
+ * a cue sheet with the track offsets. The cue sheet also keeps the position
+ * of the first track and the lead-out on the disc in REM lines, which are
+ * needed to compute the musicbrainz disc id. Images are mapped into memory
+ * and read as a source.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cdda_interface.h>
+
+#include "config.h"
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_source.h"
+#include "tsr_image.h"
+#include "tsr_reader.h"
+#include "tsr_util.h"
+
+/*
+ * Get the name of the pcm file for the given cue sheet, the .cue suffix is
+ * replaced by .bin.
+ *
+ */
+char *tsr_image_binfile(char *cuefile)
+{
+	char *binfile;
+	size_t len;
+
+	len = strlen(cuefile);
+
+	if (len > 4 && !strcasecmp(cuefile + len - 4, ".cue"))
+	{
+		len -= 4;
+	}
+
+	if (asprintf(&binfile, "%.*s.bin", (int) len, cuefile) == -1)
+	{
+		tsr_exit_error(__FILE__, __LINE__, ENOMEM);
+	}
+
+	return binfile;
+}
+
+/*
+ * Write the cue sheet for the image binfile, returns 0 and sets errno on
+ * failure.
+ *
+ */
+int tsr_image_write_cue(char *cuefile, char *binfile, tsr_toc_t *toc)
+{
+	FILE *cue_s;
+	char *name;
+	long offset;
+	int i, err;
+
+	cue_s = fopen(cuefile, "w");
+
+	if (cue_s == NULL)
+	{
+		return 0;
+	}
+
+	name = strdup(binfile);
+	fprintf(cue_s, "REM TSRIP FIRSTSECTOR %li\n", toc->firstsector[0]);
+	fprintf(cue_s, "REM TSRIP LEADOUT %li\n", toc->leadout);
+	fprintf(cue_s, "FILE \"%s\" BINARY\n", basename(name));
+	free(name);
+
+	for (i = 0; i < toc->numtracks; i++)
+	{
+		offset = toc->firstsector[i] - toc->firstsector[0];
+		fprintf(cue_s, "  TRACK %02i AUDIO\n", i + 1);
+		fprintf(cue_s, "    INDEX 01 %02li:%02li:%02li\n", offset / (60 * 75),
+				(offset / 75) % 60, offset % 75);
+	}
+
+	err = ferror(cue_s);
+
+	if (fclose(cue_s) || err)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Parse the cue sheet into the image's toc, returns 0 if it is not a cue
+ * sheet for a single binary file.
+ *
+ */
+static int tsr_image_parse_cue(tsr_image_t *image, char *cuefile)
+{
+	FILE *cue_s;
+	char line[512];
+	char name[256];
+	char *dir;
+	int track, m, s, f, ok = 1;
+	long firstsector = 0;
+
+	cue_s = fopen(cuefile, "r");
+
+	if (cue_s == NULL)
+	{
+		return 0;
+	}
+
+	image->binfile = NULL;
+	image->source.toc.numtracks = 0;
+	image->source.toc.leadout = -1;
+
+	while (ok && fgets(line, sizeof(line), cue_s))
+	{
+		if (sscanf(line, " REM TSRIP FIRSTSECTOR %ld", &firstsector) == 1
+				|| sscanf(line, " REM TSRIP LEADOUT %ld", &image->source.toc.leadout) == 1)
+		{
+			continue;
+		}
+		else if (sscanf(line, " FILE \"%255[^\"]\" BINARY", name) == 1)
+		{
+			if (image->binfile != NULL)
+			{
+				ok = 0;
+				break;
+			}
+
+			dir = strdup(cuefile);
+
+			if (name[0] == '/')
+			{
+				image->binfile = strdup(name);
+			}
+			else if (asprintf(&image->binfile, "%s/%s", dirname(dir), name) == -1)
+			{
+				tsr_exit_error(__FILE__, __LINE__, ENOMEM);
+			}
+
+			free(dir);
+		}
+		else if (sscanf(line, " TRACK %d", &track) == 1)
+		{
+			ok = (strstr(line, "AUDIO") != NULL && track == image->source.toc.numtracks + 1
+					&& track <= TSR_MAXTRACKS);
+			image->source.toc.numtracks = track;
+		}
+		else if (sscanf(line, " INDEX 01 %d:%d:%d", &m, &s, &f) == 3)
+		{
+			ok = (image->source.toc.numtracks > 0);
+
+			if (ok)
+			{
+				image->source.toc.firstsector[image->source.toc.numtracks - 1] =
+					(m * 60 + s) * 75 + f;
+			}
+		}
+	}
+
+	fclose(cue_s);
+
+	if (!ok || image->binfile == NULL || image->source.toc.numtracks == 0)
+	{
+		free(image->binfile);
+
+		return 0;
+	}
+
+	for (track = 0; track < image->source.toc.numtracks; track++)
+	{
+		image->source.toc.firstsector[track] += firstsector;
+	}
+
+	return 1;
+}
+
+/*
+ * Get the given sector of the image.
+ *
+ */
+static char *tsr_image_read(tsr_source_t *source, long sector)
+{
+	tsr_image_t *image = (tsr_image_t *) source;
+
+	return tsr_source_pcm(source, image->pcm + (size_t) (sector
+				- source->toc.firstsector[0]) * CD_FRAMESIZE_RAW, CD_FRAMESIZE_RAW);
+}
+
+/*
+ * Unmap and free the image.
+ *
+ */
+static void tsr_image_close(tsr_source_t *source)
+{
+	tsr_image_t *image = (tsr_image_t *) source;
+
+	munmap(image->pcm, image->size);
+	free(image->binfile);
+	free(image);
+}
+
+/*
+ * Free a partly opened image and set errno, returns NULL.
+ *
+ */
+static tsr_image_t *tsr_image_fail(tsr_image_t *image, int fd, int err)
+{
+	if (fd != -1)
+	{
+		close(fd);
+	}
+
+	free(image->binfile);
+	free(image);
+	errno = err;
+
+	return NULL;
+}
+
+/*
+ * Open the image described by the cue sheet and map it into memory. Returns
+ * NULL and sets errno on failure.
+ *
+ */
+tsr_image_t *tsr_image_open(char *cuefile)
+{
+	tsr_image_t *image;
+	struct stat st;
+	long sectors;
+	int fd, i;
+
+	image = (tsr_image_t *) malloc(sizeof(tsr_image_t));
+
+	if (image == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	errno = 0;
+
+	if (!tsr_image_parse_cue(image, cuefile))
+	{
+		free(image);
+		errno = errno ? errno : EINVAL;
+
+		return NULL;
+	}
+
+	fd = open(image->binfile, O_RDONLY);
+
+	if (fd == -1 || fstat(fd, &st) == -1)
+	{
+		return tsr_image_fail(image, fd, errno);
+	}
+
+	if (st.st_size == 0 || st.st_size % CD_FRAMESIZE_RAW)
+	{
+		return tsr_image_fail(image, fd, EINVAL);
+	}
+
+	image->size = st.st_size;
+	image->pcm = (char *) mmap(NULL, image->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (image->pcm == MAP_FAILED)
+	{
+		return tsr_image_fail(image, fd, errno);
+	}
+
+	close(fd);
+
+	/* the image is read once from start to end */
+	madvise(image->pcm, image->size, MADV_SEQUENTIAL);
+	sectors = image->size / CD_FRAMESIZE_RAW;
+
+	for (i = 0; i < image->source.toc.numtracks; i++)
+	{
+		image->source.toc.lastsector[i] = (i + 1 < image->source.toc.numtracks) ?
+			image->source.toc.firstsector[i + 1] - 1 :
+			image->source.toc.firstsector[0] + sectors - 1;
+
+		if (image->source.toc.lastsector[i] < image->source.toc.firstsector[i])
+		{
+			tsr_image_close(&image->source);
+			errno = EINVAL;
+
+			return NULL;
+		}
+	}
+
+	if (image->source.toc.leadout == -1)
+	{
+		image->source.toc.leadout = image->source.toc.firstsector[0] + sectors;
+	}
+
+	image->source.name = image->binfile;
+	image->source.device = NULL;
+	image->source.read = tsr_image_read;
+	image->source.speed = NULL;
+	image->source.fast = NULL;
+	image->source.riplog = NULL;
+	image->source.close = tsr_image_close;
+
+	return image;
+}
+
+/*
+ * Read the whole disc from the source into an image next to the cue sheet,
+ * the pcm goes to the .bin file. A drive starts at full speed.
+ *
+ */
+void tsr_image_capture(tsr_source_t *source, char *cuefile, tsr_cfg_t *cfg)
+{
+	tsr_toc_t *toc = &source->toc;
+	tsr_reader_t *reader;
+	tsr_writer_t *writer;
+	char *binfile, *read_buffer;
+	long cursor, lsec, p, pp = -1;
+	int sectors, err;
+#ifdef WORDS_BIGENDIAN
+	char *swapped;
+#endif
+
+	binfile = tsr_image_binfile(cuefile);
+	writer = tsr_writer_open(binfile, cfg->writebuffer);
+
+	if (writer == NULL)
+	{
+		fprintf(stderr, "Can't create image %s: %s\n", binfile, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+#ifdef WORDS_BIGENDIAN
+	swapped = (char *) malloc((size_t) cfg->batch * CD_FRAMESIZE_RAW);
+
+	if (swapped == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+#endif
+
+	reader = tsr_reader_start(source, toc, cfg->ringsize, 1, NULL, NULL, NULL, NULL);
+	lsec = toc->lastsector[toc->numtracks - 1];
+
+	for (cursor = toc->firstsector[0]; cursor <= lsec; cursor += sectors)
+	{
+		sectors = (lsec - cursor + 1 < cfg->batch) ? lsec - cursor + 1 : cfg->batch;
+		read_buffer = tsr_ring_read_slots(reader->ring, 0, sectors, &sectors);
+
+		if (!read_buffer)
+		{
+			tsr_writer_close(writer);
+			unlink(binfile);
+			printf("\n");
+			fflush(stdout); fprintf(stderr, "\nError reading Track %i\n", reader->failtrack);
+			exit(1);
+		}
+
+#ifdef WORDS_BIGENDIAN
+		swab(read_buffer, swapped, (size_t) sectors * CD_FRAMESIZE_RAW);
+		tsr_writer_write(writer, swapped, (size_t) sectors * CD_FRAMESIZE_RAW);
+#else
+		tsr_writer_write(writer, read_buffer, (size_t) sectors * CD_FRAMESIZE_RAW);
+#endif
+		tsr_ring_read_commit(reader->ring, 0, sectors);
+		p = (cursor + sectors - toc->firstsector[0]) * 100
+			/ (lsec - toc->firstsector[0] + 1);
+
+		if (p != pp)
+		{
+			printf("\rReading disc into %s... %3li%%", binfile, p);
+
+			if (source->riplog != NULL)
+			{
+				tsr_riplog_print_rates(source->riplog);
+			}
+
+			fflush(stdout);
+		}
+
+		pp = p;
+	}
+
+	tsr_reader_stop(reader);
+#ifdef WORDS_BIGENDIAN
+	free(swapped);
+#endif
+
+	if (source->riplog != NULL && cfg->riplog != NULL
+			&& !tsr_riplog_write(source->riplog, cfg->riplog, source->name, NULL))
+	{
+		fprintf(stderr, "\nCan't write rip log %s: %s\n", cfg->riplog,
+				strerror(errno));
+	}
+
+	err = tsr_writer_close(writer);
+
+	if (err || !tsr_image_write_cue(cuefile, binfile, toc))
+	{
+		errno = err ? err : errno;
+		fprintf(stderr, "\nCan't write image %s: %s\n", cuefile, strerror(errno));
+		unlink(binfile);
+		exit(EXIT_FAILURE);
+	}
+
+	free(binfile);
+}
+
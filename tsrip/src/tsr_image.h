@@ -0,0 +1,46 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_image.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_IMAGE_H
+#define TSR_IMAGE_H
+
+#include <stddef.h>
+
+#include "tsr_source.h"
+
+typedef struct _tsr_image_t
+{
+	tsr_source_t source;
+	char *binfile;
+	char *pcm;
+	size_t size;
+} tsr_image_t;
+
+char *tsr_image_binfile(char *cuefile);
+
+int tsr_image_write_cue(char *cuefile, char *binfile, tsr_toc_t *toc);
+
+void tsr_image_capture(tsr_source_t *source, char *cuefile, tsr_cfg_t *cfg);
+
+tsr_image_t *tsr_image_open(char *cuefile);
+
+#endif
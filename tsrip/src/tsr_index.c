@@ -0,0 +1,360 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_index.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The index of the discs ripped to the music directory, so a copy of a disc
+ * which was ripped already isn't ripped again. It is a directory in the
+ * music directory with a file per disc id, which has a line per file
+ * written:
+ *
+ *   <track> <settings> <crc32> <path>
+ *
+ * The settings are the encoder with its quality or level, a file only
+ * counts as done if it is still there and was encoded with the settings of
+ * an output in use. Looking up a disc only opens its file, which is read
+ * with a shared and updated with an exclusive lock, so several rips can use
+ * the index at once.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_index.h"
+#include "tsr_toc.h"
+#include "tsr_util.h"
+
+#define TSR_INDEX_DIR ".tsrip-index"
+
+/*
+ * Return the settings of the output as written to the index, the file of a
+ * whole disc doesn't count for the files of its tracks.
+ *
+ */
+static char *tsr_index_settings(tsr_output_t *output, tsr_cfg_t *cfg)
+{
+	char *settings;
+
+	if (output->enctype == CFG_TYPE_FLAC)
+	{
+		asprintf(&settings, "flac-%i%s", cfg->flaclevel,
+				(cfg->singlefile) ? "-disc" : "");
+	}
+	else
+	{
+		asprintf(&settings, "vorbis-%.2f%s", output->quality,
+				(cfg->singlefile) ? "-disc" : "");
+	}
+
+	return settings;
+}
+
+/*
+ * Mark the outputs whose files are listed in fp and still there.
+ *
+ */
+static void tsr_index_read(tsr_index_t *index, FILE *fp)
+{
+	char *line = NULL, *name, *settings, *slash;
+	size_t len = 0;
+	int track, output, pos;
+	struct stat st;
+
+	while (getline(&line, &len, fp) != -1)
+	{
+		line[strcspn(line, "\n")] = '\0';
+
+		if (sscanf(line, "%i %ms %*s %n", &track, &name, &pos) != 2)
+		{
+			continue;
+		}
+
+		for (output = 0; track >= 1 && track <= index->toc->numtracks
+				&& output < index->cfg->numoutputs; output++)
+		{
+			settings = tsr_index_settings(&index->cfg->outputs[output], index->cfg);
+
+			if (!strcmp(settings, name) && !((index->done[track - 1] >> output) & 1)
+					&& stat(line + pos, &st) == 0)
+			{
+				index->done[track - 1] |= 1u << output;
+				index->numdone++;
+
+				if (index->dir == NULL && (slash = strrchr(line + pos, '/')) != NULL)
+				{
+					index->dir = strndup(line + pos, slash - line - pos);
+				}
+			}
+
+			free(settings);
+		}
+
+		free(name);
+	}
+
+	free(line);
+}
+
+/*
+ * Look up the disc with the given toc in the index of the music directory.
+ * Returns NULL if no index is kept.
+ *
+ */
+tsr_index_t *tsr_index_open(tsr_toc_t *toc, tsr_cfg_t *cfg)
+{
+	tsr_index_t *index;
+	char *dir, *discid;
+	int fd;
+	FILE *fp;
+
+	if (!cfg->index)
+	{
+		return NULL;
+	}
+
+	if (*cfg->musicdir == '~')
+	{
+		asprintf(&dir, "%s%s/%s", getenv("HOME"), cfg->musicdir + 1, TSR_INDEX_DIR);
+	}
+	else
+	{
+		asprintf(&dir, "%s/%s", cfg->musicdir, TSR_INDEX_DIR);
+	}
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+	{
+		fprintf(stderr, "Can't create index %s: %s\n", dir, strerror(errno));
+		free(dir);
+
+		return NULL;
+	}
+
+	index = (tsr_index_t *) calloc(1, sizeof(tsr_index_t));
+
+	if (index == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	discid = tsr_toc_discid(toc);
+	asprintf(&index->file, "%s/%s", dir, discid);
+	free(discid);
+	free(dir);
+	index->toc = toc;
+	index->cfg = cfg;
+	fd = open(index->file, O_RDONLY);
+
+	if (fd != -1)
+	{
+		flock(fd, LOCK_SH);
+		fp = fdopen(fd, "r");
+		tsr_index_read(index, fp);
+		fclose(fp);
+	}
+
+	return index;
+}
+
+/*
+ * Forget the files found for the disc, so all of them are written again.
+ *
+ */
+void tsr_index_forget(tsr_index_t *index)
+{
+	memset(index->done, 0, sizeof(index->done));
+	index->numdone = 0;
+}
+
+/*
+ * Mark the outputs found in the index as done in the journal, so they are
+ * not encoded again.
+ *
+ */
+void tsr_index_mark(tsr_index_t *index, tsr_journal_t *journal)
+{
+	int track;
+
+	for (track = 0; index != NULL && track < index->toc->numtracks; track++)
+	{
+		tsr_journal_mark(journal, track, index->done[track]);
+	}
+}
+
+/*
+ * Return the file written for the output of the track in this rip, or
+ * NULL.
+ *
+ */
+static char *tsr_index_written(tsr_index_t *index, tsr_journal_t *journal,
+		int track, int output)
+{
+	if ((index->done[track] >> output) & 1)
+	{
+		return NULL;
+	}
+
+	return journal->files[track * index->cfg->numoutputs + output];
+}
+
+/*
+ * Return 1 if the line of the index is replaced by a file written in this
+ * rip.
+ *
+ */
+static int tsr_index_replaced(tsr_index_t *index, tsr_journal_t *journal,
+		char *line)
+{
+	char *name, *settings;
+	int track, output, replaced = 0;
+
+	if (sscanf(line, "%i %ms", &track, &name) != 2)
+	{
+		return 0;
+	}
+
+	for (output = 0; track >= 1 && track <= index->toc->numtracks
+			&& output < index->cfg->numoutputs; output++)
+	{
+		settings = tsr_index_settings(&index->cfg->outputs[output], index->cfg);
+
+		if (!strcmp(settings, name)
+				&& tsr_index_written(index, journal, track - 1, output) != NULL)
+		{
+			replaced = 1;
+		}
+
+		free(settings);
+	}
+
+	free(name);
+
+	return replaced;
+}
+
+/*
+ * Add the files written in this rip, as recorded by the journal, to the
+ * index, with the crc32 of the tracks if accurip is not NULL. Returns 0
+ * if the index can't be written.
+ *
+ */
+int tsr_index_update(tsr_index_t *index, tsr_journal_t *journal,
+		tsr_accurip_t *accurip)
+{
+	char *line = NULL, *kept = NULL, *settings, *path;
+	size_t len = 0, keptlen = 0;
+	int fd, track, output;
+	FILE *fp, *mem;
+
+	if (index == NULL)
+	{
+		return 1;
+	}
+
+	fd = open(index->file, O_RDWR | O_CREAT, 0644);
+
+	if (fd == -1 || flock(fd, LOCK_EX) == -1 || (fp = fdopen(fd, "r+")) == NULL)
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+
+		return 0;
+	}
+
+	mem = open_memstream(&kept, &keptlen);
+
+	if (mem == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	while (getline(&line, &len, fp) != -1)
+	{
+		if (!tsr_index_replaced(index, journal, line))
+		{
+			fputs(line, mem);
+		}
+	}
+
+	free(line);
+	fclose(mem);
+	rewind(fp);
+	ftruncate(fd, 0);
+	fputs(kept, fp);
+	free(kept);
+
+	for (track = 0; track < index->toc->numtracks; track++)
+	{
+		for (output = 0; output < index->cfg->numoutputs; output++)
+		{
+			if ((path = tsr_index_written(index, journal, track, output)) == NULL)
+			{
+				continue;
+			}
+
+			settings = tsr_index_settings(&index->cfg->outputs[output], index->cfg);
+			fprintf(fp, "%i %s ", track + 1, settings);
+			free(settings);
+
+			if (accurip != NULL && accurip->tracks[track].samples > 0)
+			{
+				fprintf(fp, "%08X %s\n", accurip->tracks[track].crc32, path);
+			}
+			else
+			{
+				fprintf(fp, "- %s\n", path);
+			}
+		}
+	}
+
+	fflush(fp);
+	fdatasync(fd);
+
+	return fclose(fp) == 0;
+}
+
+/*
+ * Free the index.
+ *
+ */
+void tsr_index_free(tsr_index_t *index)
+{
+	if (index == NULL)
+	{
+		return;
+	}
+
+	free(index->dir);
+	free(index->file);
+	free(index);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_index.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_INDEX_H
+#define TSR_INDEX_H
+
+#include "tsr_journal.h"
+#include "tsr_accurip.h"
+
+/*
+ * The entry of a disc in the index, a bit per output for every track whose
+ * file is there with the current settings.
+ *
+ */
+typedef struct _tsr_index_t
+{
+	char *file;
+	tsr_toc_t *toc;
+	tsr_cfg_t *cfg;
+	unsigned int done[TSR_MAXTRACKS];
+	int numdone;
+	char *dir;
+} tsr_index_t;
+
+tsr_index_t *tsr_index_open(tsr_toc_t *toc, tsr_cfg_t *cfg);
+
+void tsr_index_forget(tsr_index_t *index);
+
+void tsr_index_mark(tsr_index_t *index, tsr_journal_t *journal);
+
+int tsr_index_update(tsr_index_t *index, tsr_journal_t *journal,
+		tsr_accurip_t *accurip);
+
+void tsr_index_free(tsr_index_t *index);
+
+#endif
@@ -0,0 +1,737 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_journal.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The journal of a disc keeps track of the outputs which have been written
+ * completely, so an interrupted rip only reads the tracks which are not
+ * done yet. It is kept in the journal directory under the disc id, the
+ * first line is the toc of the disc. Every finished output adds a line
+ *
+ *   done <track> <output> <size> <filename>
+ *
+ * which is only trusted on the next run if the file still has this size and
+ * the same name. The files are the untagged ones of tsr_get_tmpfilename,
+ * they only get their final names when the rip is done.
+ *
+ * The sectors of a track paranoia reported errors for, or of every track
+ * if asked for, are spooled to <discid>.<track>.pcm from the first sector
+ * with an error on, so the hard part of a damaged track doesn't have to be
+ * read again after an interruption. Whenever the spool is synced a line
+ *
+ *   spool <track> <first> <sectors>
+ *
+ * records the range of sectors of the track it holds, only these are
+ * replayed on the next run. The spool file is removed when the track is
+ * done.
+ *
+ * The loudness of a track is recorded once it is read with a line
+ *
+ *   loudness <track> <peak> <block>...
+ *
+ * holding its peak and the mean square of every gating block in hex, so
+ * the album gain can be computed when the tracks which are done are not
+ * read again. Without a journal directory the outputs which are done are
+ * only kept in memory and nothing is spooled.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_journal.h"
+#include "tsr_toc.h"
+#include "tsr_util.h"
+
+/*
+ * Spooled sectors written before they are synced to the disk, 10 seconds.
+ *
+ */
+#define TSR_JOURNAL_SYNC 750
+
+/*
+ * Return the toc line of the journal.
+ *
+ */
+static char *tsr_journal_header(tsr_toc_t *toc)
+{
+	char *header, *line;
+	int i;
+
+	asprintf(&header, "toc %i %li", toc->numtracks, toc->leadout);
+
+	for (i = 0; i < toc->numtracks; i++)
+	{
+		line = header;
+		asprintf(&header, "%s %li", line, toc->firstsector[i]);
+		free(line);
+	}
+
+	return header;
+}
+
+/*
+ * Return the name of the spool file of the given track.
+ *
+ */
+static char *tsr_journal_spoolfile(tsr_journal_t *journal, int track)
+{
+	char *file;
+
+	asprintf(&file, "%s.%02i.pcm", journal->prefix, track + 1);
+
+	return file;
+}
+
+/*
+ * Write the loudness line of a track.
+ *
+ */
+static void tsr_journal_loudness_line(FILE *fp, int track, double peak,
+		const double *blocks, long numblocks)
+{
+	long i;
+
+	fprintf(fp, "loudness %i %a", track + 1, peak);
+
+	for (i = 0; i < numblocks; i++)
+	{
+		fprintf(fp, " %a", blocks[i]);
+	}
+
+	fprintf(fp, "\n");
+}
+
+/*
+ * Take the peak and the blocks of a loudness line, the line read last for
+ * a track holds.
+ *
+ */
+static void tsr_journal_load_loudness(tsr_journal_t *journal, int track,
+		double peak, char *blocks)
+{
+	long max = 0;
+	char *end;
+	double block;
+
+	free(journal->blocks[track]);
+	journal->blocks[track] = NULL;
+	journal->numblocks[track] = 0;
+
+	for (block = strtod(blocks, &end); end != blocks;
+			block = strtod(blocks, &end))
+	{
+		if (journal->numblocks[track] == max)
+		{
+			max = (max > 0) ? max * 2 : 1024;
+			journal->blocks[track] = (double *) realloc(journal->blocks[track],
+					max * sizeof(double));
+
+			if (journal->blocks[track] == NULL)
+			{
+				tsr_exit_error(__FILE__, __LINE__, errno);
+			}
+		}
+
+		journal->blocks[track][journal->numblocks[track]++] = block;
+		blocks = end;
+	}
+
+	journal->peaks[track] = peak;
+	journal->measured[track] = 1;
+}
+
+/*
+ * Check the done lines of an existing journal and keep the outputs whose
+ * files are still there and would be written to the same name now.
+ *
+ */
+static void tsr_journal_load(tsr_journal_t *journal, FILE *fp, char *header,
+		char *discid, tsr_cfg_t *cfg)
+{
+	char *line = NULL, *name, *filename, *expected, *file;
+	size_t len = 0;
+	long long size;
+	long first, sectors;
+	int track, output, pos;
+	double peak;
+	struct stat st;
+
+	if (getline(&line, &len, fp) == -1 || strncmp(line, header, strlen(header))
+			|| line[strlen(header)] != '\n')
+	{
+		free(line);
+
+		return;
+	}
+
+	while (getline(&line, &len, fp) != -1)
+	{
+		line[strcspn(line, "\n")] = '\0';
+
+		if (sscanf(line, "spool %i %li %li", &track, &first, &sectors) == 3
+				&& track >= 1 && track <= journal->toc->numtracks
+				&& first >= 0 && sectors >= 0)
+		{
+			journal->spoolfirst[track - 1] = first;
+			journal->spooled[track - 1] = sectors;
+
+			continue;
+		}
+
+		if (sscanf(line, "loudness %i %lf%n", &track, &peak, &pos) == 2
+				&& track >= 1 && track <= journal->toc->numtracks)
+		{
+			tsr_journal_load_loudness(journal, track - 1, peak, line + pos);
+
+			continue;
+		}
+
+		if (sscanf(line, "done %i %ms %lli %n", &track, &name, &size, &pos) != 3)
+		{
+			continue;
+		}
+
+		filename = line + pos;
+
+		for (output = 0; output < cfg->numoutputs
+				&& strcmp(cfg->outputs[output].name, name); output++);
+
+		free(name);
+
+		if (output == cfg->numoutputs || track < 1 || track > journal->toc->numtracks)
+		{
+			continue;
+		}
+
+		expected = tsr_get_tmpfilename(cfg, discid, track - 1,
+				cfg->outputs[output].ext);
+
+		if (!strcmp(expected, filename) && stat(filename, &st) == 0
+				&& st.st_size == size)
+		{
+			journal->done[track - 1] |= 1u << output;
+			journal->files[(track - 1) * cfg->numoutputs + output] = strdup(filename);
+			fprintf(journal->fp, "%s\n", line);
+		}
+
+		free(expected);
+	}
+
+	free(line);
+
+	/* the loudness of the tracks which are done, the spools of the others */
+	for (track = 0; track < journal->toc->numtracks; track++)
+	{
+		if (journal->measured[track] && tsr_journal_skip(journal, track))
+		{
+			tsr_journal_loudness_line(journal->fp, track, journal->peaks[track],
+					journal->blocks[track], journal->numblocks[track]);
+		}
+		else
+		{
+			free(journal->blocks[track]);
+			journal->blocks[track] = NULL;
+			journal->measured[track] = 0;
+		}
+
+
+		file = tsr_journal_spoolfile(journal, track);
+
+		if (journal->spooled[track] > 0 && !tsr_journal_skip(journal, track)
+				&& stat(file, &st) == 0
+				&& st.st_size >= (off_t) journal->spooled[track] * CD_FRAMESIZE_RAW)
+		{
+			fprintf(journal->fp, "spool %i %li %li\n", track + 1,
+					journal->spoolfirst[track], journal->spooled[track]);
+		}
+		else
+		{
+			journal->spooled[track] = 0;
+		}
+
+		free(file);
+	}
+}
+
+/*
+ * Open the journal of the disc with the given toc in the journal directory
+ * and check which outputs of a previous run are done. If no journal is
+ * kept, only the outputs done in this run are recorded.
+ *
+ */
+tsr_journal_t *tsr_journal_open(tsr_toc_t *toc, tsr_cfg_t *cfg)
+{
+	tsr_journal_t *journal;
+	char *dir, *discid, *header, *tmp;
+	FILE *fp;
+
+	journal = (tsr_journal_t *) calloc(1, sizeof(tsr_journal_t));
+
+	if (journal == NULL || (journal->files = (char **) calloc(toc->numtracks
+					* cfg->numoutputs, sizeof(char *))) == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	journal->toc = toc;
+	journal->cfg = cfg;
+	journal->spoolfd = -1;
+	journal->spooltrack = -1;
+	pthread_mutex_init(&journal->lock, NULL);
+
+	if (cfg->journal == NULL)
+	{
+		return journal;
+	}
+
+	if (*cfg->journal == '~')
+	{
+		asprintf(&dir, "%s%s", getenv("HOME"), cfg->journal + 1);
+	}
+	else
+	{
+		dir = strdup(cfg->journal);
+	}
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+	{
+		fprintf(stderr, "Can't create journal directory %s: %s\n", dir,
+				strerror(errno));
+		free(dir);
+
+		return journal;
+	}
+
+	discid = tsr_toc_discid(toc);
+	asprintf(&journal->prefix, "%s/%s", dir, discid);
+	asprintf(&tmp, "%s.journal.new", journal->prefix);
+	free(dir);
+
+	/* the journal is written anew with the done lines which still hold */
+	journal->fp = fopen(tmp, "w");
+
+	if (journal->fp == NULL)
+	{
+		fprintf(stderr, "Can't write journal %s: %s\n", tmp, strerror(errno));
+		free(journal->prefix);
+		journal->prefix = NULL;
+		free(discid);
+		free(tmp);
+
+		return journal;
+	}
+
+	asprintf(&journal->file, "%s.journal", journal->prefix);
+
+	header = tsr_journal_header(toc);
+	fprintf(journal->fp, "%s\n", header);
+	fp = fopen(journal->file, "r");
+
+	if (fp != NULL)
+	{
+		tsr_journal_load(journal, fp, header, discid, cfg);
+		fclose(fp);
+	}
+
+	fflush(journal->fp);
+	rename(tmp, journal->file);
+	free(discid);
+	free(header);
+	free(tmp);
+
+	return journal;
+}
+
+/*
+ * Return 1 if all outputs of the track are done, the track is neither read
+ * nor encoded then.
+ *
+ */
+int tsr_journal_skip(tsr_journal_t *journal, int track)
+{
+	unsigned int done;
+
+	if (journal == NULL)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&journal->lock);
+	done = journal->done[track];
+	pthread_mutex_unlock(&journal->lock);
+
+	return done == (1u << journal->cfg->numoutputs) - 1;
+}
+
+/*
+ * Return 1 if the given output of the track is done.
+ *
+ */
+int tsr_journal_skip_output(tsr_journal_t *journal, int track, int output)
+{
+	unsigned int done;
+
+	if (journal == NULL)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&journal->lock);
+	done = journal->done[track];
+	pthread_mutex_unlock(&journal->lock);
+
+	return (done >> output) & 1;
+}
+
+/*
+ * Mark the outputs of the track which are known to be done elsewhere, they
+ * are not recorded in the journal.
+ *
+ */
+void tsr_journal_mark(tsr_journal_t *journal, int track, unsigned int outputs)
+{
+	pthread_mutex_lock(&journal->lock);
+	journal->done[track] |= outputs;
+	pthread_mutex_unlock(&journal->lock);
+}
+
+/*
+ * Return the number of tracks which are done.
+ *
+ */
+int tsr_journal_skipped(tsr_journal_t *journal)
+{
+	int track, skipped = 0;
+
+	for (track = 0; journal != NULL && track < journal->toc->numtracks; track++)
+	{
+		skipped += tsr_journal_skip(journal, track);
+	}
+
+	return skipped;
+}
+
+/*
+ * Start spooling the track. Returns the number of sectors spooled by a
+ * previous run, which tsr_journal_spool_read hands out instead of reading
+ * them again.
+ *
+ */
+long tsr_journal_spool_open(tsr_journal_t *journal, int track)
+{
+	char *file;
+
+	if (journal == NULL || journal->prefix == NULL)
+	{
+		return 0;
+	}
+
+	journal->spooltrack = track;
+	journal->unsynced = 0;
+
+	if (journal->spooled[track] == 0)
+	{
+		return 0;
+	}
+
+	/* what was written after the last sync is not trusted */
+	file = tsr_journal_spoolfile(journal, track);
+	journal->spoolfd = open(file, O_RDWR);
+	free(file);
+
+	if (journal->spoolfd == -1 || ftruncate(journal->spoolfd,
+				(off_t) journal->spooled[track] * CD_FRAMESIZE_RAW) == -1)
+	{
+		tsr_journal_spool_close(journal);
+		journal->spooled[track] = 0;
+
+		return 0;
+	}
+
+	return journal->spooled[track];
+}
+
+/*
+ * Read the given sector of the track, counted from its start, from the
+ * spool. Returns 0 if it is not spooled, it has to be read from the source
+ * then.
+ *
+ */
+int tsr_journal_spool_read(tsr_journal_t *journal, long sector, char *buf)
+{
+	int track;
+
+	if (journal == NULL || journal->spoolfd == -1)
+	{
+		return 0;
+	}
+
+	track = journal->spooltrack;
+
+	if (sector < journal->spoolfirst[track]
+			|| sector >= journal->spoolfirst[track] + journal->spooled[track])
+	{
+		return 0;
+	}
+
+	if (pread(journal->spoolfd, buf, CD_FRAMESIZE_RAW,
+				(off_t) (sector - journal->spoolfirst[track]) * CD_FRAMESIZE_RAW)
+			!= CD_FRAMESIZE_RAW)
+	{
+		/* the sectors from here on are read and spooled again */
+		journal->spooled[track] = sector - journal->spoolfirst[track];
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Sync the spool and record the range of sectors it holds in the journal.
+ *
+ */
+static void tsr_journal_spool_sync(tsr_journal_t *journal)
+{
+	int track = journal->spooltrack;
+
+	fdatasync(journal->spoolfd);
+	journal->unsynced = 0;
+	pthread_mutex_lock(&journal->lock);
+
+	if (journal->fp != NULL)
+	{
+		fprintf(journal->fp, "spool %i %li %li\n", track + 1,
+				journal->spoolfirst[track], journal->spooled[track]);
+		fflush(journal->fp);
+		fdatasync(fileno(journal->fp));
+	}
+
+	pthread_mutex_unlock(&journal->lock);
+}
+
+/*
+ * Spool the given sector of the track read from the source, damaged tells
+ * if paranoia reported errors for the track so far. Spooling starts with
+ * the first damaged sector unless all tracks are spooled, and only goes
+ * on with the sector after the last one spooled.
+ *
+ */
+void tsr_journal_spool_write(tsr_journal_t *journal, long sector, char *buf,
+		int damaged)
+{
+	char *file;
+	int track;
+
+	if (journal == NULL || journal->spooltrack == -1
+			|| journal->cfg->spool == CFG_SPOOL_OFF)
+	{
+		return;
+	}
+
+	track = journal->spooltrack;
+
+	if (journal->spooled[track] == 0)
+	{
+		if (journal->cfg->spool == CFG_SPOOL_ERRORS && !damaged)
+		{
+			return;
+		}
+
+		file = tsr_journal_spoolfile(journal, track);
+		journal->spoolfd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		journal->spoolfirst[track] = sector;
+		free(file);
+	}
+	else if (sector != journal->spoolfirst[track] + journal->spooled[track])
+	{
+		return;
+	}
+
+	if (journal->spoolfd == -1 || pwrite(journal->spoolfd, buf, CD_FRAMESIZE_RAW,
+				(off_t) journal->spooled[track] * CD_FRAMESIZE_RAW) != CD_FRAMESIZE_RAW)
+	{
+		/* the spool can't be written, the track is read without */
+		tsr_journal_spool_close(journal);
+
+		return;
+	}
+
+	journal->spooled[track]++;
+
+	if (++journal->unsynced >= TSR_JOURNAL_SYNC)
+	{
+		tsr_journal_spool_sync(journal);
+	}
+}
+
+/*
+ * Stop spooling the track read last.
+ *
+ */
+void tsr_journal_spool_close(tsr_journal_t *journal)
+{
+	if (journal == NULL)
+	{
+		return;
+	}
+
+	if (journal->spoolfd != -1)
+	{
+		if (journal->unsynced > 0)
+		{
+			tsr_journal_spool_sync(journal);
+		}
+
+		close(journal->spoolfd);
+		journal->spoolfd = -1;
+	}
+
+	journal->spooltrack = -1;
+}
+
+/*
+ * Record the peak and the gating blocks of a track which was read
+ * completely.
+ *
+ */
+void tsr_journal_loudness(tsr_journal_t *journal, int track, double peak,
+		const double *blocks, long numblocks)
+{
+	if (journal == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&journal->lock);
+
+	if (journal->fp != NULL)
+	{
+		tsr_journal_loudness_line(journal->fp, track, peak, blocks, numblocks);
+		fflush(journal->fp);
+	}
+
+	pthread_mutex_unlock(&journal->lock);
+}
+
+/*
+ * Record the output of the track written to filename as done. When all
+ * outputs of the track are done, its spool file is removed.
+ *
+ */
+void tsr_journal_done(tsr_journal_t *journal, int track, int output,
+		char *filename)
+{
+	struct stat st;
+	char *file;
+
+	if (journal == NULL || stat(filename, &st) == -1)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&journal->lock);
+	journal->done[track] |= 1u << output;
+	free(journal->files[track * journal->cfg->numoutputs + output]);
+	journal->files[track * journal->cfg->numoutputs + output] = strdup(filename);
+
+	if (journal->fp != NULL)
+	{
+		fprintf(journal->fp, "done %i %s %lli %s\n", track + 1,
+				journal->cfg->outputs[output].name, (long long) st.st_size,
+				filename);
+		fflush(journal->fp);
+		fdatasync(fileno(journal->fp));
+	}
+
+	if (journal->prefix != NULL
+			&& journal->done[track] == (1u << journal->cfg->numoutputs) - 1)
+	{
+		file = tsr_journal_spoolfile(journal, track);
+		unlink(file);
+		free(file);
+	}
+
+	pthread_mutex_unlock(&journal->lock);
+}
+
+/*
+ * Close the journal and free it. Unless it is kept for the next run, the
+ * journal and its spool files are removed once all tracks are done.
+ *
+ */
+void tsr_journal_finish(tsr_journal_t *journal, int keep)
+{
+	char *file;
+	int track, i;
+
+	if (journal == NULL)
+	{
+		return;
+	}
+
+	tsr_journal_spool_close(journal);
+
+	if (journal->fp != NULL)
+	{
+		fclose(journal->fp);
+	}
+
+	if (journal->file != NULL && !keep
+			&& tsr_journal_skipped(journal) == journal->toc->numtracks)
+	{
+		for (track = 0; track < journal->toc->numtracks; track++)
+		{
+			file = tsr_journal_spoolfile(journal, track);
+			unlink(file);
+			free(file);
+		}
+
+		unlink(journal->file);
+	}
+
+	for (i = 0; i < journal->toc->numtracks * journal->cfg->numoutputs; i++)
+	{
+		free(journal->files[i]);
+	}
+
+	for (track = 0; track < journal->toc->numtracks; track++)
+	{
+		free(journal->blocks[track]);
+	}
+
+	pthread_mutex_destroy(&journal->lock);
+	free(journal->files);
+	free(journal->prefix);
+	free(journal->file);
+	free(journal);
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_journal.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_JOURNAL_H
+#define TSR_JOURNAL_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * The journal of a disc, a bit per output for every track which is done,
+ * the files written for them, the range of sectors spooled for every
+ * track, counted from its start, and the loudness of the tracks which are
+ * done as measured by an earlier run.
+ *
+ */
+typedef struct _tsr_journal_t
+{
+	char *file;
+	char *prefix;
+	FILE *fp;
+	tsr_toc_t *toc;
+	tsr_cfg_t *cfg;
+	unsigned int done[TSR_MAXTRACKS];
+	char **files;
+	int spoolfd;
+	int spooltrack;
+	long spoolfirst[TSR_MAXTRACKS];
+	long spooled[TSR_MAXTRACKS];
+	long unsynced;
+	int measured[TSR_MAXTRACKS];
+	double peaks[TSR_MAXTRACKS];
+	double *blocks[TSR_MAXTRACKS];
+	long numblocks[TSR_MAXTRACKS];
+	pthread_mutex_t lock;
+} tsr_journal_t;
+
+tsr_journal_t *tsr_journal_open(tsr_toc_t *toc, tsr_cfg_t *cfg);
+
+int tsr_journal_skip(tsr_journal_t *journal, int track);
+
+int tsr_journal_skip_output(tsr_journal_t *journal, int track, int output);
+
+void tsr_journal_mark(tsr_journal_t *journal, int track, unsigned int outputs);
+
+int tsr_journal_skipped(tsr_journal_t *journal);
+
+long tsr_journal_spool_open(tsr_journal_t *journal, int track);
+
+int tsr_journal_spool_read(tsr_journal_t *journal, long sector, char *buf);
+
+void tsr_journal_spool_write(tsr_journal_t *journal, long sector, char *buf,
+		int damaged);
+
+void tsr_journal_spool_close(tsr_journal_t *journal);
+
+void tsr_journal_loudness(tsr_journal_t *journal, int track, double peak,
+		const double *blocks, long numblocks);
+
+void tsr_journal_done(tsr_journal_t *journal, int track, int output,
+		char *filename);
+
+void tsr_journal_finish(tsr_journal_t *journal, int keep);
+
+#endif
@@ -0,0 +1,497 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_loudness.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Loudness of the tracks and the album after EBU R128 (ITU-R BS.1770),
+ * computed while the sectors are read, for the ReplayGain 2.0 tags. The
+ * samples are K-weighted by a shelving and a high pass biquad, the mean
+ * square of both channels is taken over blocks of 400 ms every 100 ms.
+ * Blocks below -70 LUFS and those 10 LU below the mean of the others are
+ * gated out, the mean of the rest is the loudness. The blocks of all
+ * tracks are kept, so the album is gated as a whole. The peak is the
+ * highest sample.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <cdda_interface.h>
+
+#include "config.h"
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_loudness.h"
+#include "tsr_util.h"
+
+#if defined(HAVE_IMMINTRIN_H) && (defined(__x86_64__) || defined(__i386__))
+#define TSR_LOUDNESS_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Plain C kernel, works everywhere. The biquads are transposed direct form
+ * II, coef has b0, b1, b2, a1 and a2 of both, state two values per channel
+ * and biquad, the channels next to each other.
+ *
+ */
+static void tsr_loudness_filter_c(const int16_t *pcm, long samples,
+		const double *coef, double *state, double *energy, double *peak)
+{
+	double x, y;
+	long i;
+	int c;
+
+	for (i = 0; i < samples; i++)
+	{
+		for (c = 0; c < 2; c++)
+		{
+			x = pcm[i * 2 + c] * (1.0 / 32768);
+
+			if (fabs(x) > *peak)
+			{
+				*peak = fabs(x);
+			}
+
+			y = coef[0] * x + state[c];
+			state[c] = coef[1] * x - coef[3] * y + state[2 + c];
+			state[2 + c] = coef[2] * x - coef[4] * y;
+			x = y;
+			y = coef[5] * x + state[4 + c];
+			state[4 + c] = coef[6] * x - coef[8] * y + state[6 + c];
+			state[6 + c] = coef[7] * x - coef[9] * y;
+			*energy += y * y;
+		}
+	}
+}
+
+static int tsr_loudness_supported_c(void)
+{
+	return 1;
+}
+
+#ifdef TSR_LOUDNESS_X86
+
+/*
+ * SSE2 kernel, the left and the right channel go through the filters in
+ * the two lanes at once.
+ *
+ */
+__attribute__((target("sse2")))
+static void tsr_loudness_filter_sse2(const int16_t *pcm, long samples,
+		const double *coef, double *state, double *energy, double *peak)
+{
+	const __m128d scale = _mm_set1_pd(1.0 / 32768);
+	const __m128d sign = _mm_set1_pd(-0.0);
+	__m128d b[6], a[4], s[4], x, y, acc, top;
+	__m128i frame;
+	double out[2];
+	int32_t pair;
+	long i;
+	int k;
+
+	for (k = 0; k < 2; k++)
+	{
+		b[k * 3] = _mm_set1_pd(coef[k * 5]);
+		b[k * 3 + 1] = _mm_set1_pd(coef[k * 5 + 1]);
+		b[k * 3 + 2] = _mm_set1_pd(coef[k * 5 + 2]);
+		a[k * 2] = _mm_set1_pd(coef[k * 5 + 3]);
+		a[k * 2 + 1] = _mm_set1_pd(coef[k * 5 + 4]);
+	}
+
+	for (k = 0; k < 4; k++)
+	{
+		s[k] = _mm_loadu_pd(state + k * 2);
+	}
+
+	acc = _mm_setzero_pd();
+	top = _mm_set1_pd(*peak);
+
+	for (i = 0; i < samples; i++)
+	{
+		/* sign extend both samples of the frame to 32 bit */
+		memcpy(&pair, pcm + i * 2, sizeof(pair));
+		frame = _mm_cvtsi32_si128(pair);
+		frame = _mm_srai_epi32(_mm_unpacklo_epi16(frame, frame), 16);
+		x = _mm_mul_pd(_mm_cvtepi32_pd(frame), scale);
+		top = _mm_max_pd(top, _mm_andnot_pd(sign, x));
+
+		y = _mm_add_pd(_mm_mul_pd(b[0], x), s[0]);
+		s[0] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b[1], x), _mm_mul_pd(a[0], y)), s[1]);
+		s[1] = _mm_sub_pd(_mm_mul_pd(b[2], x), _mm_mul_pd(a[1], y));
+		x = y;
+		y = _mm_add_pd(_mm_mul_pd(b[3], x), s[2]);
+		s[2] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b[4], x), _mm_mul_pd(a[2], y)), s[3]);
+		s[3] = _mm_sub_pd(_mm_mul_pd(b[5], x), _mm_mul_pd(a[3], y));
+		acc = _mm_add_pd(acc, _mm_mul_pd(y, y));
+	}
+
+	for (k = 0; k < 4; k++)
+	{
+		_mm_storeu_pd(state + k * 2, s[k]);
+	}
+
+	_mm_storeu_pd(out, acc);
+	*energy += out[0] + out[1];
+	_mm_storeu_pd(out, top);
+	*peak = (out[0] > out[1]) ? out[0] : out[1];
+}
+
+static int tsr_loudness_supported_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+#endif
+
+/*
+ * All kernels, the best one last.
+ *
+ */
+tsr_loudness_kernel_t tsr_loudness_kernels[] =
+{
+	{"c", tsr_loudness_filter_c, tsr_loudness_supported_c},
+#ifdef TSR_LOUDNESS_X86
+	{"sse2", tsr_loudness_filter_sse2, tsr_loudness_supported_sse2},
+#endif
+	{NULL, NULL, NULL}
+};
+
+static tsr_loudness_filter_t tsr_loudness_best = NULL;
+
+/*
+ * Filter samples with the best supported kernel.
+ *
+ */
+static void tsr_loudness_filter(const int16_t *pcm, long samples,
+		const double *coef, double *state, double *energy, double *peak)
+{
+	tsr_loudness_filter_t best;
+	int i;
+
+	best = __atomic_load_n(&tsr_loudness_best, __ATOMIC_RELAXED);
+
+	if (best == NULL)
+	{
+		for (i = 0; tsr_loudness_kernels[i].name != NULL; i++)
+		{
+			if (tsr_loudness_kernels[i].supported())
+			{
+				best = tsr_loudness_kernels[i].filter;
+			}
+		}
+
+		__atomic_store_n(&tsr_loudness_best, best, __ATOMIC_RELAXED);
+	}
+
+	best(pcm, samples, coef, state, energy, peak);
+}
+
+/*
+ * Create the loudness of a disc with numtracks tracks. The K-weighting
+ * filters are designed for 44.1 kHz like BS.1770 does for 48 kHz.
+ *
+ */
+tsr_loudness_t *tsr_loudness_new(int numtracks)
+{
+	tsr_loudness_t *loudness;
+	double k, q, vh, vb, a0;
+
+	loudness = (tsr_loudness_t *) calloc(1, sizeof(tsr_loudness_t));
+
+	if (loudness == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	loudness->numtracks = numtracks;
+
+	/* high shelf, +4 dB above 1.5 kHz */
+	k = tan(M_PI * 1681.974450955533 / 44100);
+	q = 0.7071752369554196;
+	vh = pow(10, 3.999843853973347 / 20);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1 + k / q + k * k;
+	loudness->coef[0] = (vh + vb * k / q + k * k) / a0;
+	loudness->coef[1] = 2 * (k * k - vh) / a0;
+	loudness->coef[2] = (vh - vb * k / q + k * k) / a0;
+	loudness->coef[3] = 2 * (k * k - 1) / a0;
+	loudness->coef[4] = (1 - k / q + k * k) / a0;
+
+	/* high pass at 38 Hz */
+	k = tan(M_PI * 38.13547087602444 / 44100);
+	q = 0.5003270373238773;
+	a0 = 1 + k / q + k * k;
+	loudness->coef[5] = 1;
+	loudness->coef[6] = -2;
+	loudness->coef[7] = 1;
+	loudness->coef[8] = 2 * (k * k - 1) / a0;
+	loudness->coef[9] = (1 - k / q + k * k) / a0;
+
+	return loudness;
+}
+
+/*
+ * Start the loudness of a track, what was measured of it before is
+ * dropped.
+ *
+ */
+void tsr_loudness_start(tsr_loudness_t *loudness, int track)
+{
+	tsr_loudness_track_t *t = &loudness->tracks[track];
+	double *blocks = t->blocks;
+	long maxblocks = t->maxblocks;
+
+	memset(t, 0, sizeof(tsr_loudness_track_t));
+	t->blocks = blocks;
+	t->maxblocks = maxblocks;
+}
+
+/*
+ * Add a gating block of the last four steps to the track.
+ *
+ */
+static void tsr_loudness_block(tsr_loudness_track_t *t)
+{
+	if (t->numblocks == t->maxblocks)
+	{
+		t->maxblocks = (t->maxblocks > 0) ? t->maxblocks * 2 : 1024;
+		t->blocks = (double *) realloc(t->blocks, t->maxblocks * sizeof(double));
+
+		if (t->blocks == NULL)
+		{
+			tsr_exit_error(__FILE__, __LINE__, errno);
+		}
+	}
+
+	t->blocks[t->numblocks++] = (t->steps[0] + t->steps[1] + t->steps[2]
+			+ t->steps[3]) / (4 * TSR_LOUDNESS_STEP);
+}
+
+/*
+ * Measure sectors of pcm of the track.
+ *
+ */
+void tsr_loudness_update(tsr_loudness_t *loudness, int track, const char *pcm,
+		int sectors)
+{
+	tsr_loudness_track_t *t = &loudness->tracks[track];
+	const int16_t *samples = (const int16_t *) pcm;
+	long left = (long) sectors * CD_FRAMESAMPLES, n;
+
+	while (left > 0)
+	{
+		n = TSR_LOUDNESS_STEP - t->stepsamples;
+		n = (left < n) ? left : n;
+		tsr_loudness_filter(samples, n, loudness->coef, t->state, &t->energy,
+				&t->peak);
+		samples += n * 2;
+		left -= n;
+		t->stepsamples += n;
+
+		if (t->stepsamples < TSR_LOUDNESS_STEP)
+		{
+			continue;
+		}
+
+		t->steps[t->numsteps++ % 4] = t->energy;
+		t->energy = 0;
+		t->stepsamples = 0;
+
+		if (t->numsteps >= 4)
+		{
+			tsr_loudness_block(t);
+		}
+	}
+}
+
+/*
+ * Mark the track as measured completely, a step which is not complete is
+ * left out.
+ *
+ */
+void tsr_loudness_finish(tsr_loudness_t *loudness, int track)
+{
+	loudness->tracks[track].done = 1;
+}
+
+/*
+ * Set the peak and the gating blocks of a track measured by an earlier run,
+ * which is measured completely then.
+ *
+ */
+void tsr_loudness_restore(tsr_loudness_t *loudness, int track, double peak,
+		const double *blocks, long numblocks)
+{
+	tsr_loudness_track_t *t = &loudness->tracks[track];
+
+	if (numblocks > t->maxblocks)
+	{
+		t->maxblocks = numblocks;
+		t->blocks = (double *) realloc(t->blocks, t->maxblocks * sizeof(double));
+
+		if (t->blocks == NULL)
+		{
+			tsr_exit_error(__FILE__, __LINE__, errno);
+		}
+	}
+
+	memcpy(t->blocks, blocks, numblocks * sizeof(double));
+	t->numblocks = numblocks;
+	t->peak = peak;
+	t->done = 1;
+}
+
+/*
+ * Return the number of tracks measured completely.
+ *
+ */
+int tsr_loudness_measured(tsr_loudness_t *loudness)
+{
+	int track, measured = 0;
+
+	for (track = 0; track < loudness->numtracks; track++)
+	{
+		measured += loudness->tracks[track].done;
+	}
+
+	return measured;
+}
+
+/*
+ * Gate the blocks of the tracks first to last and return their loudness in
+ * lufs. Returns 0 if they are too short or silent.
+ *
+ */
+static int tsr_loudness_gate(tsr_loudness_t *loudness, int first, int last,
+		double *lufs)
+{
+	tsr_loudness_track_t *t;
+	double absolute, relative, sum;
+	long count, i;
+	int pass, track;
+
+	absolute = pow(10, (-70 + 0.691) / 10);
+	relative = absolute;
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (track = first, sum = 0, count = 0; track <= last; track++)
+		{
+			t = &loudness->tracks[track];
+
+			for (i = 0; i < t->numblocks; i++)
+			{
+				if (t->blocks[i] > absolute && t->blocks[i] > relative)
+				{
+					sum += t->blocks[i];
+					count++;
+				}
+			}
+		}
+
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		/* 10 LU below the blocks above the absolute gate */
+		relative = sum / count * 0.1;
+	}
+
+	*lufs = -0.691 + 10 * log10(sum / count);
+
+	return 1;
+}
+
+/*
+ * Get the ReplayGain of the track in dB and its peak. Returns 0 if it was
+ * not measured completely or is silent.
+ *
+ */
+int tsr_loudness_track(tsr_loudness_t *loudness, int track, double *gain,
+		double *peak)
+{
+	double lufs;
+
+	if (!loudness->tracks[track].done
+			|| !tsr_loudness_gate(loudness, track, track, &lufs))
+	{
+		return 0;
+	}
+
+	*gain = TSR_LOUDNESS_REFERENCE - lufs;
+	*peak = loudness->tracks[track].peak;
+
+	return 1;
+}
+
+/*
+ * Get the ReplayGain of the album in dB and its peak. Returns 0 if not all
+ * tracks were measured completely or it is silent.
+ *
+ */
+int tsr_loudness_album(tsr_loudness_t *loudness, double *gain, double *peak)
+{
+	double lufs;
+	int track;
+
+	for (track = 0, *peak = 0; track < loudness->numtracks; track++)
+	{
+		if (!loudness->tracks[track].done)
+		{
+			return 0;
+		}
+
+		if (loudness->tracks[track].peak > *peak)
+		{
+			*peak = loudness->tracks[track].peak;
+		}
+	}
+
+	if (!tsr_loudness_gate(loudness, 0, loudness->numtracks - 1, &lufs))
+	{
+		return 0;
+	}
+
+	*gain = TSR_LOUDNESS_REFERENCE - lufs;
+
+	return 1;
+}
+
+/*
+ * Free the loudness.
+ *
+ */
+void tsr_loudness_free(tsr_loudness_t *loudness)
+{
+	int track;
+
+	for (track = 0; track < TSR_MAXTRACKS; track++)
+	{
+		free(loudness->tracks[track].blocks);
+	}
+
+	free(loudness);
+}
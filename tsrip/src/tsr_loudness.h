@@ -0,0 +1,100 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_loudness.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_LOUDNESS_H
+#define TSR_LOUDNESS_H
+
+#include <stdint.h>
+
+/*
+ * The loudness ReplayGain 2.0 adjusts to, in LUFS.
+ *
+ */
+#define TSR_LOUDNESS_REFERENCE -18.0
+
+/*
+ * Samples of a step of the gating blocks, 100 ms. A block has four steps.
+ *
+ */
+#define TSR_LOUDNESS_STEP 4410
+
+/*
+ * Loudness of a track in the making: the filter state of both channels,
+ * the energy of the last steps and the mean square of every gating block,
+ * which is kept for the album.
+ *
+ */
+typedef struct _tsr_loudness_track_t
+{
+	double state[8];
+	double steps[4];
+	double energy;
+	long stepsamples;
+	long numsteps;
+	double *blocks;
+	long numblocks;
+	long maxblocks;
+	double peak;
+	int done;
+} tsr_loudness_track_t;
+
+typedef struct _tsr_loudness_t
+{
+	int numtracks;
+	double coef[10];
+	tsr_loudness_track_t tracks[TSR_MAXTRACKS];
+} tsr_loudness_t;
+
+typedef void (*tsr_loudness_filter_t)(const int16_t *pcm, long samples,
+		const double *coef, double *state, double *energy, double *peak);
+
+typedef struct _tsr_loudness_kernel_t
+{
+	char *name;
+	tsr_loudness_filter_t filter;
+	int (*supported)(void);
+} tsr_loudness_kernel_t;
+
+extern tsr_loudness_kernel_t tsr_loudness_kernels[];
+
+tsr_loudness_t *tsr_loudness_new(int numtracks);
+
+void tsr_loudness_start(tsr_loudness_t *loudness, int track);
+
+void tsr_loudness_update(tsr_loudness_t *loudness, int track, const char *pcm,
+		int sectors);
+
+void tsr_loudness_finish(tsr_loudness_t *loudness, int track);
+
+void tsr_loudness_restore(tsr_loudness_t *loudness, int track, double peak,
+		const double *blocks, long numblocks);
+
+int tsr_loudness_measured(tsr_loudness_t *loudness);
+
+int tsr_loudness_track(tsr_loudness_t *loudness, int track, double *gain,
+		double *peak);
+
+int tsr_loudness_album(tsr_loudness_t *loudness, double *gain, double *peak);
+
+void tsr_loudness_free(tsr_loudness_t *loudness);
+
+#endif
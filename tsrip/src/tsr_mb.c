@@ -26,6 +26,11 @@
 #include <errno.h>
 #include <musicbrainz/mb_c.h>
 
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_mb.h"
+#include "tsr_util.h"
+
 /*
  * Initialize musicbrainz, set utf, set device etc.
  *
@@ -35,21 +40,32 @@ musicbrainz_t tsr_mb_init(char *device)
 	musicbrainz_t mb_o;
 	
 	mb_o = mb_New();
-	mb_SetDevice(mb_o, device);
+
+	if (device != NULL)
+	{
+		mb_SetDevice(mb_o, device);
+	}
+
 	mb_UseUTF8(mb_o, 1);
 
 	return mb_o;
 }
 
 /* 
- * Get number of albums found for cd in drive.
+ * Get number of albums found for cd in drive, or for the given disc id if
+ * it is not NULL.
  *
  */
-int tsr_mb_numalbums(musicbrainz_t mb_o)
+int tsr_mb_numalbums(musicbrainz_t mb_o, char *discid)
 {
-	int c = 0;
+	int c = 0, found;
+	char *args[2] = {discid, NULL};
+
+	found = (discid != NULL) ?
+		mb_QueryWithArgs(mb_o, MBQ_GetCDInfoFromCDIndexId, args) :
+		mb_Query(mb_o, MBQ_GetCDInfo);
 
-	if (mb_Query(mb_o, MBQ_GetCDInfo))
+	if (found)
 	{
 		c = mb_GetResultInt(mb_o, MBE_GetNumAlbums);
 	}
@@ -57,103 +73,92 @@ int tsr_mb_numalbums(musicbrainz_t mb_o)
 	return (c > 0) ? c : 0;
 }
 
-/* 
- * Get number of tracks for the given album number.
+/*
+ * Select the album with the given number, from the top of the result.
  *
  */
-int tsr_mb_album_numtracks(musicbrainz_t mb_o, int numalbum)
+static void tsr_mb_select(musicbrainz_t mb_o, int numalbum)
 {
-	int tracks;
-
+	mb_Select(mb_o, MBS_Rewind);
 	mb_Select1(mb_o, MBS_SelectAlbum, numalbum);
-	tracks = mb_GetResultInt(mb_o, MBE_AlbumGetNumTracks);
-
-	return tracks;
 }
 
 /*
- * Get name for the given album number.
+ * Get the given data of the selected album, for the track number if it is
+ * greater than 0, as string of the metainfo.
  *
  */
-char *tsr_mb_album_name(musicbrainz_t mb_o, int numalbum)
+static char *tsr_mb_data(musicbrainz_t mb_o, tsr_metainfo_t *metainfo,
+		char *name, int numtrack)
 {
 	char buf[256];
 
-	mb_Select1(mb_o, MBS_SelectAlbum, numalbum);
-	mb_GetResultData(mb_o, MBE_AlbumGetAlbumName, buf, 256);
-	buf[255] = '\0';
-
-	return strdup(buf);
-}
-
-/*
- * Get artist for the given album and track number.
- *
- */
-char *tsr_mb_track_artist(musicbrainz_t mb_o, int numalbum, int numtrack)
-{	
-	char buf[256];
-	int len;
+	if (numtrack > 0)
+	{
+		mb_GetResultData1(mb_o, name, buf, 256, numtrack);
+	}
+	else
+	{
+		mb_GetResultData(mb_o, name, buf, 256);
+	}
 
-	mb_Select1(mb_o, MBS_SelectAlbum, numalbum);
-	mb_GetResultData1(mb_o, MBE_AlbumGetArtistName, buf, 256, numtrack);
 	buf[255] = '\0';
 
-	return strdup(buf);
-
+	return tsr_metainfo_str(metainfo, buf);
 }
 
-/* 
- * Check if the album identifyed by numalbum is a multiartist album.
+/*
+ * Get the head of the album identifyed by numalbum: its name, number of
+ * tracks and the artists of the tracks, from a single selection of the
+ * album. The titles are left NULL until tsr_mb_album_tracks is called.
  *
  */
-int tsr_mb_album_ismultiple(musicbrainz_t mb_o, int numalbum)
+tsr_metainfo_t *tsr_mb_album_head(musicbrainz_t mb_o, int numalbum)
 {
-	int i;
-	char *artist;
-	char *partist = NULL;
+	tsr_metainfo_t *metainfo;
+	int i, numtracks;
+
+	tsr_mb_select(mb_o, numalbum);
+	numtracks = mb_GetResultInt(mb_o, MBE_AlbumGetNumTracks);
+	numtracks = (numtracks > 0) ? numtracks : 0;
+	metainfo = tsr_metainfo_new(numtracks);
+	metainfo->album = tsr_mb_data(mb_o, metainfo, MBE_AlbumGetAlbumName, 0);
 
-	for (i = 1; i <= tsr_mb_album_numtracks(mb_o, numalbum); i++)
+	for (i = 0; i < numtracks; i++)
 	{
-		artist = tsr_mb_track_artist(mb_o, numalbum, i);
+		metainfo->trackinfos[i].artist = tsr_mb_data(mb_o, metainfo,
+				MBE_AlbumGetArtistName, i + 1);
 
-		if (!partist)
+		/* the artists are interned, equal ones are the same string */
+		if (i > 0 && metainfo->trackinfos[i].artist != metainfo->trackinfos[0].artist)
 		{
-			partist = strdup(artist);
-		}
-		else
-		{
-			if (!strcmp(partist, artist))
-			{
-				free(artist);
-			}
-			else
-			{
-				free(partist);
-				free(artist);
-
-				return 1;
-			}
+			metainfo->ismultiple = 1;
 		}
 	}
-	
-	free(partist);
-	
-	return 0;
+
+	return metainfo;
 }
 
-/* 
- * Get track name for the given album and track number.
+/*
+ * Fill in the titles of the album identifyed by numalbum, whose head was
+ * got by tsr_mb_album_head. Nothing is asked for if they are there
+ * already.
  *
  */
-char *tsr_mb_track_title(musicbrainz_t mb_o, int numalbum, int numtrack)
+void tsr_mb_album_tracks(musicbrainz_t mb_o, int numalbum, tsr_metainfo_t *metainfo)
 {
-	char buf[256];
-	int len;
+	int i;
 
-	mb_Select1(mb_o, MBS_SelectAlbum, numalbum);
-	mb_GetResultData1(mb_o, MBE_AlbumGetTrackName, buf, 256, numtrack);
-	buf[255] = '\0';
+	if (metainfo->numtracks == 0 || metainfo->trackinfos[0].title != NULL)
+	{
+		return;
+	}
+
+	tsr_mb_select(mb_o, numalbum);
 
-	return strdup(buf);
+	for (i = 0; i < metainfo->numtracks; i++)
+	{
+		metainfo->trackinfos[i].title = tsr_mb_data(mb_o, metainfo,
+				MBE_AlbumGetTrackName, i + 1);
+	}
 }
@@ -24,14 +24,8 @@
 
 musicbrainz_t tsr_mb_init(char *device);
 
-int tsr_mb_numalbums(musicbrainz_t mb_o);
+int tsr_mb_numalbums(musicbrainz_t mb_o, char *discid);
 
-int tsr_mb_album_numtracks(musicbrainz_t mb_o, int numalbum);
+tsr_metainfo_t *tsr_mb_album_head(musicbrainz_t mb_o, int numalbum);
 
-int tsr_mb_album_ismultiple(musicbrainz_t mb_o, int numalbum);
-
-char *tsr_mb_album_name(musicbrainz_t mb_o, int numalbum);
-	
-char *tsr_mb_track_artist(musicbrainz_t mb_o, int numalbum, int numtrack);
-
-char *tsr_mb_track_title(musicbrainz_t mb_o, int numalbum, int numtrack);
+void tsr_mb_album_tracks(musicbrainz_t mb_o, int numalbum, tsr_metainfo_t *metainfo);
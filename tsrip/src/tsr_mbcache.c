@@ -0,0 +1,366 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_mbcache.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * A cache of the album information of the discs, so a disc which was ripped
+ * before is known without asking musicbrainz. The cache is a directory with
+ * a file per musicbrainz disc id, which holds the information the user took
+ * for the disc:
+ *
+ *   disc <discid>
+ *   album <album>
+ *   multiple <0|1>
+ *   tracks <n>
+ *   artist <track> <artist>
+ *   title <track> <title>
+ *   end
+ *
+ * Entries older than the ttl are not used. A file with any number of such
+ * entries can be imported into the cache or be looked up directly.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_mbcache.h"
+#include "tsr_util.h"
+
+/*
+ * Return the cache directory, with a leading ~ replaced by the home
+ * directory.
+ *
+ */
+static char *tsr_mbcache_dir(tsr_cfg_t *cfg)
+{
+	char *dir;
+
+	if (*cfg->mbcache == '~')
+	{
+		asprintf(&dir, "%s%s", getenv("HOME"), cfg->mbcache + 1);
+	}
+	else
+	{
+		dir = strdup(cfg->mbcache);
+	}
+
+	return dir;
+}
+
+/*
+ * Read the next entry from fp, its disc id is returned in discid. Returns
+ * NULL at the end of the file or if the entry is broken.
+ *
+ */
+static tsr_metainfo_t *tsr_mbcache_read(FILE *fp, char **discid)
+{
+	tsr_metainfo_t *metainfo = NULL;
+	char *line = NULL, *val, *album = NULL;
+	size_t len = 0;
+	int numtracks, track, pos, ok = 0, i, ismultiple = 0;
+	char **field;
+
+	*discid = NULL;
+
+	while (getline(&line, &len, fp) != -1)
+	{
+		line[strcspn(line, "\n")] = '\0';
+		val = strchr(line, ' ');
+		val = (val != NULL) ? val + 1 : line + strlen(line);
+
+		if (!strcmp(line, "end"))
+		{
+			ok = metainfo != NULL;
+			break;
+		}
+		else if (!strncmp(line, "disc ", 5) && *discid == NULL)
+		{
+			*discid = strdup(val);
+		}
+		else if (!strncmp(line, "album ", 6))
+		{
+			free(album);
+			album = strdup(val);
+		}
+		else if (!strncmp(line, "multiple ", 9))
+		{
+			ismultiple = atoi(val);
+		}
+		else if (!strncmp(line, "tracks ", 7) && metainfo == NULL
+				&& (numtracks = atoi(val)) > 0 && numtracks <= TSR_MAXTRACKS)
+		{
+			metainfo = tsr_metainfo_new(numtracks);
+		}
+		else if (metainfo != NULL && (!strncmp(line, "artist ", 7) || !strncmp(line, "title ", 6))
+				&& sscanf(val, "%i %n", &track, &pos) == 1
+				&& track >= 1 && track <= metainfo->numtracks)
+		{
+			field = (*line == 'a') ? &metainfo->trackinfos[track - 1].artist :
+				&metainfo->trackinfos[track - 1].title;
+			*field = tsr_metainfo_str(metainfo, val + pos);
+		}
+	}
+
+	free(line);
+
+	for (i = 0; ok && i < metainfo->numtracks; i++)
+	{
+		ok = metainfo->trackinfos[i].title != NULL
+			&& metainfo->trackinfos[i].artist != NULL;
+	}
+
+	if (metainfo != NULL && album != NULL)
+	{
+		metainfo->album = tsr_metainfo_str(metainfo, album);
+		metainfo->ismultiple = ismultiple;
+	}
+
+	ok = ok && album != NULL;
+	free(album);
+
+	if (!ok || *discid == NULL)
+	{
+		if (metainfo != NULL)
+		{
+			tsr_metainfo_free(metainfo);
+		}
+
+		free(*discid);
+		*discid = NULL;
+
+		return NULL;
+	}
+
+	return metainfo;
+}
+
+/*
+ * Return the cached information of the disc, or NULL if it is not in the
+ * cache, older than the ttl or a refresh was asked for.
+ *
+ */
+tsr_metainfo_t *tsr_mbcache_get(char *discid, tsr_cfg_t *cfg)
+{
+	tsr_metainfo_t *metainfo;
+	char *dir, *file, *cached;
+	struct stat st;
+	FILE *fp;
+
+	if (cfg->mbcache == NULL || cfg->mbrefresh)
+	{
+		return NULL;
+	}
+
+	dir = tsr_mbcache_dir(cfg);
+	asprintf(&file, "%s/%s", dir, discid);
+	fp = fopen(file, "r");
+	free(file);
+	free(dir);
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+
+	if (cfg->mbcachettl > 0 && fstat(fileno(fp), &st) == 0
+			&& time(NULL) - st.st_mtime > (time_t) cfg->mbcachettl * 86400)
+	{
+		fclose(fp);
+
+		return NULL;
+	}
+
+	metainfo = tsr_mbcache_read(fp, &cached);
+	fclose(fp);
+
+	if (metainfo != NULL && strcmp(cached, discid))
+	{
+		tsr_metainfo_free(metainfo);
+		metainfo = NULL;
+	}
+
+	free(cached);
+
+	return metainfo;
+}
+
+/*
+ * Write the information of the disc to the cache. The entry is written to
+ * a temporary file of its own first, so other rips never see half of it.
+ * Returns 0 if it can't be written.
+ *
+ */
+int tsr_mbcache_put(char *discid, tsr_metainfo_t *metainfo, tsr_cfg_t *cfg)
+{
+	char *dir, *file, *tmp, *slash;
+	FILE *fp;
+	int fd, i, ok;
+
+	if (cfg->mbcache == NULL)
+	{
+		return 1;
+	}
+
+	/* create the cache directory and its parent */
+	dir = tsr_mbcache_dir(cfg);
+	slash = strrchr(dir, '/');
+
+	if (slash != NULL && slash != dir)
+	{
+		*slash = '\0';
+		mkdir(dir, 0755);
+		*slash = '/';
+	}
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+	{
+		free(dir);
+
+		return 0;
+	}
+
+	asprintf(&file, "%s/%s", dir, discid);
+	asprintf(&tmp, "%s.XXXXXX", file);
+	free(dir);
+	fd = mkstemp(tmp);
+	fp = (fd != -1) ? fdopen(fd, "w") : NULL;
+
+	if (fp == NULL)
+	{
+		if (fd != -1)
+		{
+			close(fd);
+			unlink(tmp);
+		}
+
+		free(file);
+		free(tmp);
+
+		return 0;
+	}
+
+	fprintf(fp, "disc %s\nalbum %s\nmultiple %i\ntracks %i\n", discid,
+			metainfo->album, metainfo->ismultiple, metainfo->numtracks);
+
+	for (i = 0; i < metainfo->numtracks; i++)
+	{
+		fprintf(fp, "artist %i %s\ntitle %i %s\n", i + 1,
+				metainfo->trackinfos[i].artist, i + 1,
+				metainfo->trackinfos[i].title);
+	}
+
+	fprintf(fp, "end\n");
+	ok = fclose(fp) == 0 && rename(tmp, file) == 0;
+
+	if (!ok)
+	{
+		unlink(tmp);
+	}
+
+	free(file);
+	free(tmp);
+
+	return ok;
+}
+
+/*
+ * Return the information of the disc from the given file with any number
+ * of entries, or NULL if it has none for the disc.
+ *
+ */
+tsr_metainfo_t *tsr_mbcache_find(char *filename, char *discid)
+{
+	tsr_metainfo_t *metainfo = NULL;
+	char *found;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+
+	while (metainfo == NULL && !feof(fp))
+	{
+		metainfo = tsr_mbcache_read(fp, &found);
+
+		if (metainfo != NULL && strcmp(found, discid))
+		{
+			tsr_metainfo_free(metainfo);
+			metainfo = NULL;
+		}
+
+		free(found);
+	}
+
+	fclose(fp);
+
+	return metainfo;
+}
+
+/*
+ * Import all entries of the given file into the cache. Returns the number
+ * of discs imported, or -1 if the file can't be read.
+ *
+ */
+int tsr_mbcache_import(char *filename, tsr_cfg_t *cfg)
+{
+	tsr_metainfo_t *metainfo;
+	char *discid;
+	FILE *fp;
+	int imported = 0;
+
+	fp = fopen(filename, "r");
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	while (!feof(fp))
+	{
+		metainfo = tsr_mbcache_read(fp, &discid);
+
+		if (metainfo == NULL)
+		{
+			continue;
+		}
+
+		imported += tsr_mbcache_put(discid, metainfo, cfg);
+		tsr_metainfo_free(metainfo);
+		free(discid);
+	}
+
+	fclose(fp);
+
+	return imported;
+}
@@ -0,0 +1,29 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_mbcache.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+tsr_metainfo_t *tsr_mbcache_get(char *discid, tsr_cfg_t *cfg);
+
+int tsr_mbcache_put(char *discid, tsr_metainfo_t *metainfo, tsr_cfg_t *cfg);
+
+tsr_metainfo_t *tsr_mbcache_find(char *filename, char *discid);
+
+int tsr_mbcache_import(char *filename, tsr_cfg_t *cfg);
@@ -0,0 +1,184 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_pcm.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Conversion of interleaved 16 bit little endian cd samples to planar
+ * floats in the range [-1, 1). The best kernel for the running cpu is chosen
+ * on the first call. All kernels scale by a power of two, so they give the
+ * same floats as the plain C version.
+ *
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "tsr_pcm.h"
+
+#if defined(HAVE_IMMINTRIN_H) && (defined(__x86_64__) || defined(__i386__))
+#define TSR_PCM_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Plain C kernel, works everywhere.
+ *
+ */
+static void tsr_pcm_deinterleave_c(const int8_t *in, float *left, float *right,
+		int samples)
+{
+	int i;
+
+	for (i = 0; i < samples; i++)
+	{
+		left[i] = ((in[i * 4 + 1] << 8)
+				| (0x00ff & (int)in[i * 4])) / 32768.f;
+		right[i] = ((in[i * 4 + 3] << 8)
+				| (0x00ff & (int)in[i * 4 + 2])) / 32768.f;
+	}
+}
+
+static int tsr_pcm_supported_c(void)
+{
+	return 1;
+}
+
+#ifdef TSR_PCM_X86
+
+/*
+ * SSE2 kernel, 4 samples per step. Each 32 bit lane holds one stereo sample,
+ * the left channel is sign extended by shifting it up and back down, the
+ * right one by shifting it down.
+ *
+ */
+__attribute__((target("sse2")))
+static void tsr_pcm_deinterleave_sse2(const int8_t *in, float *left,
+		float *right, int samples)
+{
+	const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+	__m128i frames;
+	int i;
+
+	for (i = 0; i + 4 <= samples; i += 4)
+	{
+		frames = _mm_loadu_si128((const __m128i *) (in + i * 4));
+		_mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_slli_epi32(frames, 16), 16)), scale));
+		_mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(
+				_mm_srai_epi32(frames, 16)), scale));
+	}
+
+	tsr_pcm_deinterleave_c(in + i * 4, left + i, right + i, samples - i);
+}
+
+static int tsr_pcm_supported_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+/*
+ * AVX2 kernel, same as the SSE2 one with 8 samples per step.
+ *
+ */
+__attribute__((target("avx2")))
+static void tsr_pcm_deinterleave_avx2(const int8_t *in, float *left,
+		float *right, int samples)
+{
+	const __m256 scale = _mm256_set1_ps(1.f / 32768.f);
+	__m256i frames;
+	int i;
+
+	for (i = 0; i + 8 <= samples; i += 8)
+	{
+		frames = _mm256_loadu_si256((const __m256i *) (in + i * 4));
+		_mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_cvtepi32_ps(
+				_mm256_srai_epi32(_mm256_slli_epi32(frames, 16), 16)), scale));
+		_mm256_storeu_ps(right + i, _mm256_mul_ps(_mm256_cvtepi32_ps(
+				_mm256_srai_epi32(frames, 16)), scale));
+	}
+
+	tsr_pcm_deinterleave_c(in + i * 4, left + i, right + i, samples - i);
+}
+
+static int tsr_pcm_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+/*
+ * All kernels, the best one last.
+ *
+ */
+tsr_pcm_kernel_t tsr_pcm_kernels[] =
+{
+	{"c", tsr_pcm_deinterleave_c, tsr_pcm_supported_c},
+#ifdef TSR_PCM_X86
+	{"sse2", tsr_pcm_deinterleave_sse2, tsr_pcm_supported_sse2},
+	{"avx2", tsr_pcm_deinterleave_avx2, tsr_pcm_supported_avx2},
+#endif
+	{NULL, NULL, NULL}
+};
+
+static tsr_pcm_deinterleave_t tsr_pcm_best = NULL;
+
+/*
+ * Convert samples stereo samples with the best supported kernel.
+ *
+ */
+void tsr_pcm_deinterleave(const int8_t *in, float *left, float *right, int samples)
+{
+	tsr_pcm_deinterleave_t best;
+	int i;
+
+	best = __atomic_load_n(&tsr_pcm_best, __ATOMIC_RELAXED);
+
+	if (best == NULL)
+	{
+		for (i = 0; tsr_pcm_kernels[i].name != NULL; i++)
+		{
+			if (tsr_pcm_kernels[i].supported())
+			{
+				best = tsr_pcm_kernels[i].deinterleave;
+			}
+		}
+
+		__atomic_store_n(&tsr_pcm_best, best, __ATOMIC_RELAXED);
+	}
+
+	best(in, left, right, samples);
+}
+
+/*
+ * Convert values 16 bit little endian samples to 32 bit integers, which is
+ * what libFLAC wants.
+ *
+ */
+void tsr_pcm_widen(const int8_t *in, int32_t *out, int values)
+{
+	int i;
+
+	for (i = 0; i < values; i++)
+	{
+		out[i] = (in[i * 2 + 1] << 8) | (0x00ff & (int)in[i * 2]);
+	}
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_pcm.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <stdint.h>
+
+typedef void (*tsr_pcm_deinterleave_t)(const int8_t *in, float *left,
+		float *right, int samples);
+
+typedef struct _tsr_pcm_kernel_t
+{
+	char *name;
+	tsr_pcm_deinterleave_t deinterleave;
+	int (*supported)(void);
+} tsr_pcm_kernel_t;
+
+extern tsr_pcm_kernel_t tsr_pcm_kernels[];
+
+void tsr_pcm_deinterleave(const int8_t *in, float *left, float *right, int samples);
+
+void tsr_pcm_widen(const int8_t *in, int32_t *out, int values);
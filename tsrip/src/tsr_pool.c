@@ -0,0 +1,374 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_pool.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * A pool of encoder threads. The reader spools complete tracks into memory
+ * and submits them as jobs, so several tracks are encoded at once. Several
+ * readers can share the pool, each with its own queue. The threads take the
+ * next job from the queue served longest ago, so a drive with many short
+ * tracks doesn't starve the others. Submitting blocks while too many
+ * spooled tracks of the reader are waiting, which keeps the memory bounded
+ * to a few tracks per thread however many readers there are.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_pool.h"
+#include "tsr_util.h"
+
+/*
+ * Create a spool for numsectors sectors, shared by refs jobs.
+ *
+ */
+tsr_spool_t *tsr_spool_new(long numsectors, int refs)
+{
+	tsr_spool_t *spool;
+
+	spool = (tsr_spool_t *) malloc(sizeof(tsr_spool_t));
+
+	if (spool == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	spool->pcm = (char *) malloc((size_t) numsectors * CD_FRAMESIZE_RAW);
+
+	if (spool->pcm == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	spool->numsectors = numsectors;
+	spool->refs = refs;
+
+	return spool;
+}
+
+/*
+ * Drop a reference to the spool, the last one frees it.
+ *
+ */
+void tsr_spool_release(tsr_spool_t *spool)
+{
+	if (__atomic_sub_fetch(&spool->refs, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		free(spool->pcm);
+		free(spool);
+	}
+}
+
+/*
+ * Create a new job encoding the spooled track for the given output.
+ *
+ */
+tsr_job_t *tsr_job_new(int tracknum, int output, tsr_spool_t *spool)
+{
+	tsr_job_t *job;
+
+	job = (tsr_job_t *) malloc(sizeof(tsr_job_t));
+
+	if (job == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	job->tracknum = tracknum;
+	job->output = output;
+	job->spool = spool;
+	job->numsectors = spool->numsectors;
+	job->encoded = 0;
+	job->state = TSR_JOB_QUEUED;
+	job->queue = NULL;
+	job->next = NULL;
+
+	return job;
+}
+
+/*
+ * Take the next job from the first queue which has one and move the queue
+ * to the end, so the queues are served in turn. The pool has to be locked
+ * and a job queued.
+ *
+ */
+static tsr_job_t *tsr_pool_take(tsr_pool_t *pool)
+{
+	tsr_queue_t **prev, **last, *queue;
+	tsr_job_t *job;
+
+	for (prev = &pool->queues; (*prev)->head == NULL; prev = &(*prev)->next);
+
+	queue = *prev;
+	job = queue->head;
+	queue->head = job->next;
+
+	if (queue->head == NULL)
+	{
+		queue->tail = NULL;
+	}
+
+	*prev = queue->next;
+
+	for (last = &pool->queues; *last != NULL; last = &(*last)->next);
+
+	*last = queue;
+	queue->next = NULL;
+	pool->queued--;
+
+	return job;
+}
+
+/*
+ * Thread function, run jobs until the pool is shut down.
+ *
+ */
+static void *tsr_pool_worker(void *arg)
+{
+	tsr_pool_t *pool = (tsr_pool_t *) arg;
+	tsr_job_t *job;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (1)
+	{
+		while (pool->queued == 0 && !pool->shutdown)
+		{
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+
+		if (pool->queued == 0)
+		{
+			break;
+		}
+
+		job = tsr_pool_take(pool);
+		__atomic_store_n(&job->state, TSR_JOB_RUNNING, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&pool->lock);
+
+		pool->run(job, job->queue->arg);
+		tsr_spool_release(job->spool);
+
+		pthread_mutex_lock(&pool->lock);
+		__atomic_store_n(&job->state, TSR_JOB_DONE, __ATOMIC_RELEASE);
+		job->queue->pending--;
+		pthread_cond_broadcast(&pool->done);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/*
+ * Create a pool of numthreads threads, each job is handed to run() with the
+ * arg of its queue.
+ *
+ */
+tsr_pool_t *tsr_pool_new(int numthreads, tsr_pool_run_t run)
+{
+	tsr_pool_t *pool;
+	int i, err;
+
+	pool = (tsr_pool_t *) malloc(sizeof(tsr_pool_t));
+
+	if (pool == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	pool->threads = (pthread_t *) malloc(numthreads * sizeof(pthread_t));
+
+	if (pool->threads == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	pool->numthreads = numthreads;
+	pool->numqueues = 0;
+	pool->queued = 0;
+	pool->shutdown = 0;
+	pool->queues = NULL;
+	pool->run = run;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (i = 0; i < numthreads; i++)
+	{
+		err = pthread_create(&pool->threads[i], NULL, tsr_pool_worker, pool);
+
+		if (err)
+		{
+			tsr_exit_error(__FILE__, __LINE__, err);
+		}
+	}
+
+	return pool;
+}
+
+/*
+ * Add a queue for the jobs of a reader, they are run with arg.
+ *
+ */
+tsr_queue_t *tsr_pool_queue_new(tsr_pool_t *pool, void *arg)
+{
+	tsr_queue_t *queue;
+
+	queue = (tsr_queue_t *) malloc(sizeof(tsr_queue_t));
+
+	if (queue == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	queue->head = NULL;
+	queue->tail = NULL;
+	queue->pending = 0;
+	queue->arg = arg;
+
+	pthread_mutex_lock(&pool->lock);
+	queue->next = pool->queues;
+	pool->queues = queue;
+	pool->numqueues++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return queue;
+}
+
+/*
+ * Remove the queue from the pool, all its jobs have to be done.
+ *
+ */
+void tsr_pool_queue_free(tsr_pool_t *pool, tsr_queue_t *queue)
+{
+	tsr_queue_t **prev;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (prev = &pool->queues; *prev != queue; prev = &(*prev)->next);
+
+	*prev = queue->next;
+	pool->numqueues--;
+
+	/* the other readers may spool more tracks now */
+	pthread_cond_broadcast(&pool->done);
+	pthread_mutex_unlock(&pool->lock);
+	free(queue);
+}
+
+/*
+ * Queue a job, wait while too many jobs of the queue are pending. The
+ * threads are shared out between the queues, one more job than its share
+ * may be pending, so a single reader keeps all threads busy.
+ *
+ */
+void tsr_pool_submit(tsr_pool_t *pool, tsr_queue_t *queue, tsr_job_t *job)
+{
+	pthread_mutex_lock(&pool->lock);
+
+	while (queue->pending >= pool->numthreads / pool->numqueues + 1)
+	{
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+
+	job->queue = queue;
+	job->next = NULL;
+
+	if (queue->tail == NULL)
+	{
+		queue->head = job;
+	}
+	else
+	{
+		queue->tail->next = job;
+	}
+
+	queue->tail = job;
+	queue->pending++;
+	pool->queued++;
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Wait up to msecs for a job to finish, return the number of pending jobs
+ * of the queue.
+ *
+ */
+int tsr_pool_wait(tsr_pool_t *pool, tsr_queue_t *queue, int msecs)
+{
+	struct timespec ts;
+	int pending;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += msecs / 1000;
+	ts.tv_nsec += (msecs % 1000) * 1000000L;
+
+	if (ts.tv_nsec >= 1000000000L)
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	if (queue->pending > 0)
+	{
+		pthread_cond_timedwait(&pool->done, &pool->lock, &ts);
+	}
+
+	pending = queue->pending;
+	pthread_mutex_unlock(&pool->lock);
+
+	return pending;
+}
+
+/*
+ * Finish all pending jobs, stop the threads and free the pool.
+ *
+ */
+void tsr_pool_free(tsr_pool_t *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->numthreads; i++)
+	{
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->done);
+	free(pool->threads);
+	free(pool);
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_pool.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_POOL_H
+#define TSR_POOL_H
+
+#include <pthread.h>
+
+#define TSR_JOB_QUEUED 0
+#define TSR_JOB_RUNNING 1
+#define TSR_JOB_DONE 2
+
+typedef struct _tsr_spool_t
+{
+	char *pcm;
+	long numsectors;
+	int refs;
+} tsr_spool_t;
+
+typedef struct _tsr_queue_t tsr_queue_t;
+
+typedef struct _tsr_job_t
+{
+	int tracknum;
+	int output;
+	tsr_spool_t *spool;
+	long numsectors;
+	long encoded;
+	int state;
+	tsr_queue_t *queue;
+	struct _tsr_job_t *next;
+} tsr_job_t;
+
+typedef void (*tsr_pool_run_t)(tsr_job_t *job, void *arg);
+
+/*
+ * The jobs of one reader, run with its arg.
+ *
+ */
+struct _tsr_queue_t
+{
+	tsr_job_t *head;
+	tsr_job_t *tail;
+	int pending;
+	void *arg;
+	struct _tsr_queue_t *next;
+};
+
+typedef struct _tsr_pool_t
+{
+	int numthreads;
+	int numqueues;
+	int queued;
+	int shutdown;
+	pthread_t *threads;
+	tsr_queue_t *queues;
+	tsr_pool_run_t run;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+} tsr_pool_t;
+
+tsr_spool_t *tsr_spool_new(long numsectors, int refs);
+
+void tsr_spool_release(tsr_spool_t *spool);
+
+tsr_job_t *tsr_job_new(int tracknum, int output, tsr_spool_t *spool);
+
+tsr_pool_t *tsr_pool_new(int numthreads, tsr_pool_run_t run);
+
+tsr_queue_t *tsr_pool_queue_new(tsr_pool_t *pool, void *arg);
+
+void tsr_pool_queue_free(tsr_pool_t *pool, tsr_queue_t *queue);
+
+void tsr_pool_submit(tsr_pool_t *pool, tsr_queue_t *queue, tsr_job_t *job);
+
+int tsr_pool_wait(tsr_pool_t *pool, tsr_queue_t *queue, int msecs);
+
+void tsr_pool_free(tsr_pool_t *pool);
+
+#endif
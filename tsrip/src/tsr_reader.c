@@ -0,0 +1,394 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_reader.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The reader thread reads all tracks of a disc sector by sector and hands
+ * them over to the encoder through a ring, so the drive keeps on reading
+ * while the encoder is busy and the other way round. The sectors are taken
+ * from a source, a drive or a file.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_stats.h"
+#include "tsr_reader.h"
+#include "tsr_util.h"
+
+/*
+ * Longest track which is read fast into memory, 10 minutes.
+ *
+ */
+#define TSR_READER_FASTMAX 45000
+
+/*
+ * Hand a sector over to the ring, the time spent waiting for the encoders
+ * is accounted to stats. Returns 0 if the ring was closed.
+ *
+ */
+static int tsr_reader_put(tsr_reader_t *reader, tsr_stats_t *stats, char *sector)
+{
+	char *slot;
+	uint64_t t;
+
+	t = tsr_stats_start(stats);
+	slot = tsr_ring_write_slot(reader->ring);
+	tsr_stats_stop(stats, TSR_STAGE_STALL, t);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+
+	memcpy(slot, sector, CD_FRAMESIZE_RAW);
+	tsr_ring_write_commit(reader->ring);
+
+	return 1;
+}
+
+/*
+ * Add the sectors the read offset shifts into the checksums of a track,
+ * before it if after is 0 and the offset is negative, after it if after is
+ * 1 and the offset is positive. A sector which can't be read leaves the
+ * checksums short, they won't match then.
+ *
+ */
+static void tsr_reader_read_margin(tsr_reader_t *reader, int track, int after,
+		tsr_stats_t *stats)
+{
+	char *read_buffer;
+	long cursor, end;
+	uint64_t t;
+
+	if ((reader->accurip->offset > 0) != after)
+	{
+		return;
+	}
+
+	if (after)
+	{
+		cursor = reader->toc->lastsector[track] + 1;
+	}
+	else
+	{
+		cursor = reader->toc->firstsector[track]
+			- tsr_accurip_margin(reader->accurip, track);
+	}
+
+	for (end = cursor + tsr_accurip_margin(reader->accurip, track); cursor < end;
+			cursor++)
+	{
+		t = tsr_stats_start(stats);
+		read_buffer = reader->source->read(reader->source, cursor);
+		tsr_stats_stop(stats, TSR_STAGE_READ, t);
+
+		if (!read_buffer)
+		{
+			return;
+		}
+
+		tsr_accurip_update(reader->accurip, track, read_buffer, 1);
+	}
+}
+
+/*
+ * Read a track with the source in fast mode into memory and only hand it
+ * over if its checksums match the database. Returns 1 if the track was
+ * handed over, 0 if it has to be read again the slow way and -1 if the
+ * ring was closed.
+ *
+ */
+static int tsr_reader_read_fast(tsr_reader_t *reader, int track, tsr_stats_t *stats)
+{
+	char *read_buffer;
+	char *pcm;
+	long fsec, lsec, cursor;
+	int ret = 0;
+	uint64_t t;
+
+	fsec = reader->toc->firstsector[track];
+	lsec = reader->toc->lastsector[track];
+
+	if (lsec - fsec + 1 > TSR_READER_FASTMAX
+			|| (pcm = (char *) malloc((lsec - fsec + 1) * CD_FRAMESIZE_RAW)) == NULL)
+	{
+		return 0;
+	}
+
+	reader->source->fast(reader->source, 1);
+	tsr_reader_read_margin(reader, track, 0, stats);
+
+	for (cursor = fsec; cursor <= lsec; cursor++)
+	{
+		t = tsr_stats_start(stats);
+		read_buffer = reader->source->read(reader->source, cursor);
+		tsr_stats_stop(stats, TSR_STAGE_READ, t);
+
+		if (!read_buffer)
+		{
+			break;
+		}
+
+		memcpy(pcm + (cursor - fsec) * CD_FRAMESIZE_RAW, read_buffer,
+				CD_FRAMESIZE_RAW);
+		tsr_accurip_update(reader->accurip, track, read_buffer, 1);
+	}
+
+	if (cursor > lsec)
+	{
+		tsr_reader_read_margin(reader, track, 1, stats);
+	}
+
+	reader->source->fast(reader->source, 0);
+
+	if (cursor > lsec && tsr_accurip_finish(reader->accurip, track) > 0)
+	{
+		if (reader->loudness != NULL)
+		{
+			tsr_loudness_update(reader->loudness, track, pcm, lsec - fsec + 1);
+		}
+
+		for (ret = 1, cursor = fsec; ret == 1 && cursor <= lsec; cursor++)
+		{
+			ret = tsr_reader_put(reader, stats,
+					pcm + (cursor - fsec) * CD_FRAMESIZE_RAW) ? 1 : -1;
+		}
+	}
+	else
+	{
+		tsr_accurip_start(reader->accurip, track, lsec - fsec + 1);
+	}
+
+	free(pcm);
+
+	return ret;
+}
+
+/*
+ * Read all tracks into the ring, the time spent reading and waiting for
+ * the encoders is accounted to the stats of the tracks. If the checksums
+ * of a track match the database, the next one is read fast and only read
+ * again the slow way if its checksums don't match. Tracks the journal has
+ * as done are left out, the sectors it has spooled are not read again.
+ *
+ */
+static void tsr_reader_read_tracks(tsr_reader_t *reader, tsr_perf_t *perf)
+{
+	char *read_buffer;
+	char sector[CD_FRAMESIZE_RAW];
+	int track, fast = 0, ret;
+	long fsec, lsec, cursor, spooled, errors;
+	tsr_stats_t *stats = NULL;
+	uint64_t t;
+
+	for (track = 1; track <= reader->toc->numtracks; track++)
+	{
+		fsec = reader->toc->firstsector[track - 1];
+		lsec = reader->toc->lastsector[track - 1];
+
+		if (reader->stats != NULL)
+		{
+			stats = &reader->stats[track - 1];
+			stats->sectors = lsec - fsec + 1;
+			stats->start = tsr_stats_now();
+		}
+
+		if (tsr_journal_skip(reader->journal, track - 1))
+		{
+			continue;
+		}
+
+		if (reader->accurip != NULL)
+		{
+			tsr_accurip_start(reader->accurip, track - 1, lsec - fsec + 1);
+		}
+
+		if (reader->loudness != NULL)
+		{
+			tsr_loudness_start(reader->loudness, track - 1);
+		}
+
+		spooled = tsr_journal_spool_open(reader->journal, track - 1);
+		errors = (reader->source->riplog != NULL) ?
+			tsr_riplog_errors(reader->source->riplog) : 0;
+		ret = (fast && spooled == 0) ?
+			tsr_reader_read_fast(reader, track - 1, stats) : 0;
+
+		if (ret == -1)
+		{
+			return;
+		}
+
+		if (reader->accurip != NULL && ret == 0)
+		{
+			tsr_reader_read_margin(reader, track - 1, 0, stats);
+		}
+
+		for (cursor = fsec; ret == 0 && cursor <= lsec; cursor++)
+		{
+			if (tsr_journal_spool_read(reader->journal, cursor - fsec, sector))
+			{
+				read_buffer = sector;
+			}
+			else
+			{
+				t = tsr_stats_start(stats);
+				read_buffer = reader->source->read(reader->source, cursor);
+				tsr_stats_stop(stats, TSR_STAGE_READ, t);
+
+				if (!read_buffer)
+				{
+					reader->failtrack = track;
+					tsr_ring_close(reader->ring, EIO);
+
+					return;
+				}
+
+				tsr_journal_spool_write(reader->journal, cursor - fsec, read_buffer,
+						reader->source->riplog != NULL
+						&& tsr_riplog_errors(reader->source->riplog) > errors);
+			}
+
+			if (reader->accurip != NULL)
+			{
+				tsr_accurip_update(reader->accurip, track - 1, read_buffer, 1);
+			}
+
+			if (reader->loudness != NULL)
+			{
+				tsr_loudness_update(reader->loudness, track - 1, read_buffer, 1);
+			}
+
+			if (!tsr_reader_put(reader, stats, read_buffer))
+			{
+				return;
+			}
+		}
+
+		tsr_journal_spool_close(reader->journal);
+
+		if (reader->loudness != NULL)
+		{
+			tsr_loudness_finish(reader->loudness, track - 1);
+			tsr_journal_loudness(reader->journal, track - 1,
+					reader->loudness->tracks[track - 1].peak,
+					reader->loudness->tracks[track - 1].blocks,
+					reader->loudness->tracks[track - 1].numblocks);
+		}
+
+		if (reader->accurip != NULL && ret == 0)
+		{
+			tsr_reader_read_margin(reader, track - 1, 1, stats);
+			fast = tsr_accurip_finish(reader->accurip, track - 1) > 0
+				&& tsr_accurip_known(reader->accurip)
+				&& reader->source->fast != NULL;
+		}
+
+		if (stats != NULL)
+		{
+			tsr_perf_account(perf, stats);
+		}
+	}
+
+	tsr_ring_close(reader->ring, 0);
+}
+
+/*
+ * Thread function, read all tracks into the ring.
+ *
+ */
+static void *tsr_reader_run(void *arg)
+{
+	tsr_reader_t *reader = (tsr_reader_t *) arg;
+	tsr_perf_t perf;
+
+	if (reader->stats != NULL)
+	{
+		tsr_perf_open(&perf);
+		tsr_reader_read_tracks(reader, &perf);
+		tsr_perf_close(&perf);
+	}
+	else
+	{
+		tsr_reader_read_tracks(reader, NULL);
+	}
+
+	return NULL;
+}
+
+/*
+ * Start reading all tracks of the toc into a ring of ringsize sectors, which
+ * is read by numreaders consumers. If stats is not NULL, it has stats for
+ * every track, if accurip is not NULL the checksums of every track are
+ * computed and if loudness is not NULL their loudness is measured. journal
+ * may be NULL.
+ *
+ */
+tsr_reader_t *tsr_reader_start(tsr_source_t *source, tsr_toc_t *toc, int ringsize,
+		int numreaders, tsr_stats_t *stats, tsr_accurip_t *accurip,
+		tsr_loudness_t *loudness, tsr_journal_t *journal)
+{
+	tsr_reader_t *reader;
+	int err;
+
+	reader = (tsr_reader_t *) malloc(sizeof(tsr_reader_t));
+
+	if (reader == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	reader->source = source;
+	reader->toc = toc;
+	reader->stats = stats;
+	reader->accurip = accurip;
+	reader->loudness = loudness;
+	reader->journal = journal;
+	reader->failtrack = 0;
+	reader->ring = tsr_ring_new(ringsize, CD_FRAMESIZE_RAW, numreaders);
+	err = pthread_create(&reader->thread, NULL, tsr_reader_run, reader);
+
+	if (err)
+	{
+		tsr_exit_error(__FILE__, __LINE__, err);
+	}
+
+	return reader;
+}
+
+/*
+ * Stop the reader thread and free it.
+ *
+ */
+void tsr_reader_stop(tsr_reader_t *reader)
+{
+	tsr_ring_close(reader->ring, 0);
+	pthread_join(reader->thread, NULL);
+	tsr_ring_free(reader->ring);
+	free(reader);
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_reader.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <pthread.h>
+
+#include "tsr_ring.h"
+#include "tsr_stats.h"
+#include "tsr_source.h"
+#include "tsr_accurip.h"
+#include "tsr_loudness.h"
+#include "tsr_journal.h"
+
+typedef struct _tsr_reader_t
+{
+	tsr_source_t *source;
+	tsr_toc_t *toc;
+	tsr_stats_t *stats;
+	tsr_accurip_t *accurip;
+	tsr_loudness_t *loudness;
+	tsr_journal_t *journal;
+	int failtrack;
+	tsr_ring_t *ring;
+	pthread_t thread;
+} tsr_reader_t;
+
+tsr_reader_t *tsr_reader_start(tsr_source_t *source, tsr_toc_t *toc, int ringsize,
+		int numreaders, tsr_stats_t *stats, tsr_accurip_t *accurip,
+		tsr_loudness_t *loudness, tsr_journal_t *journal);
+
+void tsr_reader_stop(tsr_reader_t *reader);
@@ -0,0 +1,264 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_ring.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * A bounded ring of fixed size slots with a single producer. Every slot is
+ * seen by all readers, each of them has its own tail, and a slot is only
+ * reused once the slowest reader is done with it. Head and tails are only
+ * published with atomic stores, so no side takes a lock as long as the ring
+ * is neither full nor empty. The mutex and condition are only used to sleep
+ * on the slow path.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_ring.h"
+#include "tsr_util.h"
+
+/*
+ * Create a new ring with numslots slots of slotsize bytes for numreaders
+ * readers.
+ *
+ */
+tsr_ring_t *tsr_ring_new(int numslots, int slotsize, int numreaders)
+{
+	tsr_ring_t *ring;
+	int i;
+
+	ring = (tsr_ring_t *) malloc(sizeof(tsr_ring_t));
+
+	if (ring == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	ring->slots = (char *) malloc((size_t) numslots * slotsize);
+
+	if (ring->slots == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	ring->numslots = numslots;
+	ring->slotsize = slotsize;
+	ring->numreaders = numreaders;
+	ring->head = 0;
+	ring->closed = 0;
+	ring->error = 0;
+	ring->waiting = 0;
+
+	for (i = 0; i < numreaders; i++)
+	{
+		ring->tail[i] = 0;
+		ring->want[i] = 1;
+	}
+
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->cond, NULL);
+
+	return ring;
+}
+
+/*
+ * Check if the producer can go on.
+ *
+ */
+static int tsr_ring_writable(tsr_ring_t *ring, int reader)
+{
+	int i;
+
+	if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST))
+	{
+		return 1;
+	}
+
+	for (i = 0; i < ring->numreaders; i++)
+	{
+		if (ring->head - __atomic_load_n(&ring->tail[i], __ATOMIC_SEQ_CST)
+				>= (unsigned long) ring->numslots)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Check if the given reader can go on.
+ *
+ */
+static int tsr_ring_readable(tsr_ring_t *ring, int reader)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - ring->tail[reader]
+			>= (unsigned long) ring->want[reader]
+		|| __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Sleep until ready() becomes true. The waiter is counted before the
+ * condition is checked again, so a commit on the other side either sees the
+ * waiter or we see its index.
+ *
+ */
+static void tsr_ring_wait(tsr_ring_t *ring, int (*ready)(tsr_ring_t *, int),
+		int reader)
+{
+	pthread_mutex_lock(&ring->lock);
+	__atomic_add_fetch(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+
+	while (!ready(ring, reader))
+	{
+		pthread_cond_wait(&ring->cond, &ring->lock);
+	}
+
+	__atomic_sub_fetch(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/*
+ * Wake up the other sides if they are sleeping.
+ *
+ */
+static void tsr_ring_wake(tsr_ring_t *ring)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED))
+	{
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_broadcast(&ring->cond);
+		pthread_mutex_unlock(&ring->lock);
+	}
+}
+
+/*
+ * Get the next free slot, wait if the ring is full. Returns NULL if the
+ * ring was closed by a reader.
+ *
+ */
+char *tsr_ring_write_slot(tsr_ring_t *ring)
+{
+	if (!tsr_ring_writable(ring, 0))
+	{
+		tsr_ring_wait(ring, tsr_ring_writable, 0);
+	}
+
+	if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST))
+	{
+		return NULL;
+	}
+
+	return ring->slots + (ring->head % ring->numslots) * ring->slotsize;
+}
+
+/*
+ * Publish the slot returned by tsr_ring_write_slot().
+ *
+ */
+void tsr_ring_write_commit(tsr_ring_t *ring)
+{
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+	tsr_ring_wake(ring);
+}
+
+/*
+ * Wait until want slots are filled for the given reader and return the first
+ * of them. Less slots are returned if the filled slots wrap around the end
+ * of the ring or if the producer closed the ring, got is set to the number
+ * of slots returned. Returns NULL if the ring is empty and was closed.
+ *
+ */
+char *tsr_ring_read_slots(tsr_ring_t *ring, int reader, int want, int *got)
+{
+	unsigned long filled, tailslot;
+
+	ring->want[reader] = (want < ring->numslots) ? want : ring->numslots;
+
+	if (!tsr_ring_readable(ring, reader))
+	{
+		tsr_ring_wait(ring, tsr_ring_readable, reader);
+	}
+
+	filled = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail[reader];
+
+	if (filled == 0)
+	{
+		return NULL;
+	}
+
+	tailslot = ring->tail[reader] % ring->numslots;
+	*got = (int) ((filled < (unsigned long) ring->want[reader]) ?
+			filled : ring->want[reader]);
+
+	if (tailslot + *got > (unsigned long) ring->numslots)
+	{
+		*got = ring->numslots - tailslot;
+	}
+
+	return ring->slots + tailslot * ring->slotsize;
+}
+
+/*
+ * Release n slots returned by tsr_ring_read_slots() to the given reader.
+ *
+ */
+void tsr_ring_read_commit(tsr_ring_t *ring, int reader, int n)
+{
+	__atomic_store_n(&ring->tail[reader], ring->tail[reader] + n, __ATOMIC_RELEASE);
+	tsr_ring_wake(ring);
+}
+
+/*
+ * Close the ring from any side, error is kept for the other sides.
+ *
+ */
+void tsr_ring_close(tsr_ring_t *ring, int error)
+{
+	pthread_mutex_lock(&ring->lock);
+
+	if (!ring->error)
+	{
+		ring->error = error;
+	}
+
+	__atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_broadcast(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/*
+ * Free the ring, all sides must be done with it.
+ *
+ */
+void tsr_ring_free(tsr_ring_t *ring)
+{
+	pthread_mutex_destroy(&ring->lock);
+	pthread_cond_destroy(&ring->cond);
+	free(ring->slots);
+	free(ring);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_ring.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <pthread.h>
+
+#define TSR_RING_MAXREADERS 16
+
+typedef struct _tsr_ring_t
+{
+	char *slots;
+	int numslots;
+	int slotsize;
+	int numreaders;
+	int want[TSR_RING_MAXREADERS];
+	unsigned long head;
+	unsigned long tail[TSR_RING_MAXREADERS];
+	int closed;
+	int error;
+	int waiting;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} tsr_ring_t;
+
+tsr_ring_t *tsr_ring_new(int numslots, int slotsize, int numreaders);
+
+char *tsr_ring_write_slot(tsr_ring_t *ring);
+
+void tsr_ring_write_commit(tsr_ring_t *ring);
+
+char *tsr_ring_read_slots(tsr_ring_t *ring, int reader, int want, int *got);
+
+void tsr_ring_read_commit(tsr_ring_t *ring, int reader, int n);
+
+void tsr_ring_close(tsr_ring_t *ring, int error);
+
+void tsr_ring_free(tsr_ring_t *ring);
@@ -0,0 +1,425 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_riplog.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Read quality of a rip, collected from the paranoia callback. Every event
+ * is counted per track and flagged for its sector, so the rip log can show
+ * an error map of each track besides the counters. The counters are only
+ * written by the reading thread and may be read by others for the
+ * progress output.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_riplog.h"
+#include "tsr_util.h"
+
+static char *tsr_riplog_names[TSR_RIPLOG_EVENTS] =
+{
+	"reads", "verifies", "edge fixups", "atom fixups", "scratches",
+	"repairs", "skips", "drifts", "backoffs", "overlaps", "dropped fixups",
+	"duped fixups", "read errors", "rereads"
+};
+
+#define TSR_RIPLOG_FLAG(e) (1 << (e))
+
+/*
+ * Allocate a riplog for the sectors of the given toc.
+ *
+ */
+tsr_riplog_t *tsr_riplog_new(tsr_toc_t *toc)
+{
+	tsr_riplog_t *riplog;
+
+	riplog = (tsr_riplog_t *) calloc(1, sizeof(tsr_riplog_t));
+
+	if (riplog == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	riplog->toc = toc;
+	riplog->lastread = LONG_MIN;
+	riplog->sectors = (uint16_t *) calloc(toc->leadout - toc->firstsector[0] + 1,
+			sizeof(uint16_t));
+
+	if (riplog->sectors == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	return riplog;
+}
+
+/*
+ * Count an event for the given sector, its track and the disc.
+ *
+ */
+static void tsr_riplog_count(tsr_riplog_t *riplog, long sector, int event)
+{
+	tsr_toc_t *toc = riplog->toc;
+	int track;
+
+	__atomic_add_fetch(&riplog->totals[event], 1, __ATOMIC_RELAXED);
+
+	if (sector < toc->firstsector[0] || sector >= toc->leadout)
+	{
+		return;
+	}
+
+	riplog->sectors[sector - toc->firstsector[0]] |= TSR_RIPLOG_FLAG(event);
+
+	for (track = 0; track < toc->numtracks; track++)
+	{
+		if (sector >= toc->firstsector[track] && sector <= toc->lastsector[track])
+		{
+			riplog->tracks[track][event]++;
+			break;
+		}
+	}
+}
+
+/*
+ * Count an event of the paranoia callback at the given sector. Reads which
+ * don't start behind the last one are counted as rereads, too. A seek of
+ * the reader resets the last read.
+ *
+ */
+void tsr_riplog_event(tsr_riplog_t *riplog, long sector, int event)
+{
+	if (event < 0 || event >= TSR_RIPLOG_REREAD)
+	{
+		return;
+	}
+
+	tsr_riplog_count(riplog, sector, event);
+
+	if (event == TSR_RIPLOG_READ)
+	{
+		if (sector <= riplog->lastread)
+		{
+			tsr_riplog_count(riplog, sector, TSR_RIPLOG_REREAD);
+		}
+		else
+		{
+			riplog->lastread = sector;
+		}
+	}
+}
+
+/*
+ * Forget the last read after a seek.
+ *
+ */
+void tsr_riplog_seek(tsr_riplog_t *riplog)
+{
+	riplog->lastread = LONG_MIN;
+}
+
+/*
+ * Count a sector which had to be read again.
+ *
+ */
+void tsr_riplog_reread(tsr_riplog_t *riplog, long sector)
+{
+	tsr_riplog_count(riplog, sector, TSR_RIPLOG_REREAD);
+}
+
+/*
+ * Note the crcs of both passes of test and copy for a track.
+ *
+ */
+void tsr_riplog_crcs(tsr_riplog_t *riplog, int track, uint32_t testcrc,
+		uint32_t copycrc)
+{
+	riplog->hascrcs[track] = 1;
+	riplog->testcrcs[track] = testcrc;
+	riplog->copycrcs[track] = copycrc;
+}
+
+/*
+ * Count a sector handed out by the source.
+ *
+ */
+void tsr_riplog_delivered(tsr_riplog_t *riplog)
+{
+	__atomic_add_fetch(&riplog->delivered, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Count the events which show that the drive has trouble reading, the ones
+ * paranoia just checks or fixes on every drive are left out.
+ *
+ */
+long tsr_riplog_errors(tsr_riplog_t *riplog)
+{
+	return riplog->totals[TSR_RIPLOG_REREAD] + riplog->totals[TSR_RIPLOG_BACKOFF]
+		+ riplog->totals[TSR_RIPLOG_SCRATCH] + riplog->totals[TSR_RIPLOG_REPAIR]
+		+ riplog->totals[TSR_RIPLOG_SKIP] + riplog->totals[TSR_RIPLOG_READERR]
+		+ riplog->totals[TSR_RIPLOG_FIXUP_DROPPED]
+		+ riplog->totals[TSR_RIPLOG_FIXUP_DUPED];
+}
+
+/*
+ * Note the speed the drive was set to.
+ *
+ */
+void tsr_riplog_speed(tsr_riplog_t *riplog, int speed)
+{
+	if (riplog->speed != 0)
+	{
+		riplog->speedchanges++;
+	}
+
+	if (riplog->slowest == 0 || speed < riplog->slowest)
+	{
+		riplog->slowest = speed;
+	}
+
+	__atomic_store_n(&riplog->speed, speed, __ATOMIC_RELAXED);
+}
+
+/*
+ * Rereads per megabyte of audio, out of the given counters.
+ *
+ */
+static double tsr_riplog_rate(long *events, long sectors)
+{
+	double mb;
+
+	mb = (double) sectors * CD_FRAMESIZE_RAW / (1024 * 1024);
+
+	return (mb > 0) ? events[TSR_RIPLOG_REREAD] / mb : 0;
+}
+
+/*
+ * Append the rereads per megabyte and the skips so far to the progress.
+ *
+ */
+void tsr_riplog_print_rates(tsr_riplog_t *riplog)
+{
+	long totals[TSR_RIPLOG_EVENTS];
+
+	totals[TSR_RIPLOG_REREAD] = __atomic_load_n(&riplog->totals[TSR_RIPLOG_REREAD],
+			__ATOMIC_RELAXED);
+	totals[TSR_RIPLOG_SKIP] = __atomic_load_n(&riplog->totals[TSR_RIPLOG_SKIP],
+			__ATOMIC_RELAXED);
+	printf(" | %.2f rereads/MB, %li skips", tsr_riplog_rate(totals,
+				__atomic_load_n(&riplog->delivered, __ATOMIC_RELAXED)),
+			totals[TSR_RIPLOG_SKIP]);
+
+	if (__atomic_load_n(&riplog->speed, __ATOMIC_RELAXED) > 0)
+	{
+		printf(" at %ix", __atomic_load_n(&riplog->speed, __ATOMIC_RELAXED));
+	}
+}
+
+/*
+ * The worst thing which happened to some sectors, as a char of the map.
+ *
+ */
+static char tsr_riplog_mapchar(uint16_t flags)
+{
+	if (flags & TSR_RIPLOG_FLAG(TSR_RIPLOG_SKIP))
+	{
+		return 'X';
+	}
+	else if (flags & TSR_RIPLOG_FLAG(TSR_RIPLOG_READERR))
+	{
+		return 'e';
+	}
+	else if (flags & (TSR_RIPLOG_FLAG(TSR_RIPLOG_SCRATCH)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_REPAIR)))
+	{
+		return 's';
+	}
+	else if (flags & (TSR_RIPLOG_FLAG(TSR_RIPLOG_FIXUP_EDGE)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_FIXUP_ATOM)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_FIXUP_DROPPED)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_FIXUP_DUPED)))
+	{
+		return '+';
+	}
+	else if (flags & (TSR_RIPLOG_FLAG(TSR_RIPLOG_REREAD)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_BACKOFF)
+				| TSR_RIPLOG_FLAG(TSR_RIPLOG_DRIFT)))
+	{
+		return 'r';
+	}
+
+	return '.';
+}
+
+/*
+ * Print the counters which are not zero.
+ *
+ */
+static void tsr_riplog_write_counters(FILE *fp, long *events)
+{
+	int e, n = 0;
+
+	for (e = 0; e < TSR_RIPLOG_EVENTS; e++)
+	{
+		if (events[e] > 0)
+		{
+			fprintf(fp, "%s%s %li", n++ ? ", " : "  ", tsr_riplog_names[e],
+					events[e]);
+		}
+	}
+
+	if (n > 0)
+	{
+		fprintf(fp, "\n");
+	}
+}
+
+/*
+ * Print the error map of a track, a line per minute.
+ *
+ */
+static void tsr_riplog_write_map(FILE *fp, tsr_riplog_t *riplog, int track)
+{
+	long fsec, lsec, s, col;
+	uint16_t flags;
+
+	fsec = riplog->toc->firstsector[track];
+	lsec = riplog->toc->lastsector[track];
+
+	for (col = 0; fsec + col * TSR_RIPLOG_RANGE <= lsec; col++)
+	{
+		flags = 0;
+
+		for (s = fsec + col * TSR_RIPLOG_RANGE;
+				s < fsec + (col + 1) * TSR_RIPLOG_RANGE && s <= lsec; s++)
+		{
+			flags |= riplog->sectors[s - riplog->toc->firstsector[0]];
+		}
+
+		if (col % 60 == 0)
+		{
+			fprintf(fp, "%s  %02li:00 ", col ? "\n" : "", col / 60);
+		}
+
+		fputc(tsr_riplog_mapchar(flags), fp);
+	}
+
+	fprintf(fp, "\n");
+}
+
+/*
+ * Append the counters and error maps of all tracks to the rip log, - is
+ * stdout. The metainfo may be NULL. Returns 1 on success, else 0.
+ *
+ */
+int tsr_riplog_write(tsr_riplog_t *riplog, char *filename, char *name,
+		tsr_metainfo_t *metainfo)
+{
+	FILE *fp;
+	tsr_toc_t *toc = riplog->toc;
+	char date[32];
+	time_t now;
+	int track;
+	long sectors;
+
+	fp = (!strcmp(filename, "-")) ? stdout : fopen(filename, "a");
+
+	if (fp == NULL)
+	{
+		return 0;
+	}
+
+	now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	fprintf(fp, "Rip of %s at %s\n", name, date);
+
+	if (metainfo != NULL)
+	{
+		fprintf(fp, "Album: %s\n", metainfo->album);
+	}
+
+	fprintf(fp, "Map: one char per second, . clean, r reread, + fixed up, "
+			"s scratch or repaired, e read error, X skipped\n");
+
+	for (track = 0; track < toc->numtracks; track++)
+	{
+		sectors = toc->lastsector[track] - toc->firstsector[track] + 1;
+		fprintf(fp, "\nTrack %02i", track + 1);
+
+		if (metainfo != NULL && track < metainfo->numtracks)
+		{
+			fprintf(fp, " %s", metainfo->trackinfos[track].title);
+		}
+
+		fprintf(fp, ": sectors %li-%li, %.2f rereads/MB\n",
+				toc->firstsector[track], toc->lastsector[track],
+				tsr_riplog_rate(riplog->tracks[track], sectors));
+		tsr_riplog_write_counters(fp, riplog->tracks[track]);
+
+		if (riplog->hascrcs[track])
+		{
+			fprintf(fp, "  test crc %08X, copy crc %08X%s\n",
+					riplog->testcrcs[track], riplog->copycrcs[track],
+					(riplog->testcrcs[track] == riplog->copycrcs[track]) ?
+					"" : ", reread sectors differ");
+		}
+
+		tsr_riplog_write_map(fp, riplog, track);
+	}
+
+	fprintf(fp, "\nDisc: %li sectors, %.2f rereads/MB\n", riplog->delivered,
+			tsr_riplog_rate(riplog->totals, riplog->delivered));
+	tsr_riplog_write_counters(fp, riplog->totals);
+
+	if (riplog->speed > 0)
+	{
+		fprintf(fp, "  speed %ix, slowest %ix, %li changes\n", riplog->speed,
+				riplog->slowest, riplog->speedchanges);
+	}
+
+	fprintf(fp, "\n");
+
+	if (fp == stdout)
+	{
+		return !fflush(fp);
+	}
+
+	return !fclose(fp);
+}
+
+/*
+ * Free the riplog.
+ *
+ */
+void tsr_riplog_free(tsr_riplog_t *riplog)
+{
+	free(riplog->sectors);
+	free(riplog);
+}
@@ -0,0 +1,95 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_riplog.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_RIPLOG_H
+#define TSR_RIPLOG_H
+
+#include <stdint.h>
+
+/*
+ * Events reported by the paranoia callback, with the numbers used by
+ * cdda_paranoia.h, and the re-reads derived from them.
+ *
+ */
+#define TSR_RIPLOG_READ 0
+#define TSR_RIPLOG_VERIFY 1
+#define TSR_RIPLOG_FIXUP_EDGE 2
+#define TSR_RIPLOG_FIXUP_ATOM 3
+#define TSR_RIPLOG_SCRATCH 4
+#define TSR_RIPLOG_REPAIR 5
+#define TSR_RIPLOG_SKIP 6
+#define TSR_RIPLOG_DRIFT 7
+#define TSR_RIPLOG_BACKOFF 8
+#define TSR_RIPLOG_OVERLAP 9
+#define TSR_RIPLOG_FIXUP_DROPPED 10
+#define TSR_RIPLOG_FIXUP_DUPED 11
+#define TSR_RIPLOG_READERR 12
+#define TSR_RIPLOG_REREAD 13
+#define TSR_RIPLOG_EVENTS 14
+
+/*
+ * Sectors per column of the error map, one second.
+ *
+ */
+#define TSR_RIPLOG_RANGE 75
+
+typedef struct _tsr_riplog_t
+{
+	tsr_toc_t *toc;
+	uint16_t *sectors;
+	long lastread;
+	long delivered;
+	int speed;
+	int slowest;
+	long speedchanges;
+	int hascrcs[TSR_MAXTRACKS];
+	uint32_t testcrcs[TSR_MAXTRACKS];
+	uint32_t copycrcs[TSR_MAXTRACKS];
+	long totals[TSR_RIPLOG_EVENTS];
+	long tracks[TSR_MAXTRACKS][TSR_RIPLOG_EVENTS];
+} tsr_riplog_t;
+
+tsr_riplog_t *tsr_riplog_new(tsr_toc_t *toc);
+
+void tsr_riplog_event(tsr_riplog_t *riplog, long sector, int event);
+
+void tsr_riplog_seek(tsr_riplog_t *riplog);
+
+void tsr_riplog_reread(tsr_riplog_t *riplog, long sector);
+
+void tsr_riplog_crcs(tsr_riplog_t *riplog, int track, uint32_t testcrc,
+		uint32_t copycrc);
+
+void tsr_riplog_delivered(tsr_riplog_t *riplog);
+
+long tsr_riplog_errors(tsr_riplog_t *riplog);
+
+void tsr_riplog_speed(tsr_riplog_t *riplog, int speed);
+
+void tsr_riplog_print_rates(tsr_riplog_t *riplog);
+
+int tsr_riplog_write(tsr_riplog_t *riplog, char *filename, char *name,
+		tsr_metainfo_t *metainfo);
+
+void tsr_riplog_free(tsr_riplog_t *riplog);
+
+#endif
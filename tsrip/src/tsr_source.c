@@ -0,0 +1,149 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_source.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Audio sources. The reader takes the sectors of a disc from a source, which
+ * is a cd drive read with paranoia, wav files, a bin/cue image or raw pcm from
+ * a file or stdin. A source is chosen by a spec like "cdda:/dev/cdrom",
+ * "wav:01.wav,02.wav", "cue:disc.cue" or "raw:-". File sources are mapped
+ * into memory, so their sectors are not copied before they reach the ring.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <cdda_interface.h>
+
+#include "config.h"
+
+#ifdef HAVE_LINUX_CDROM_H
+#include <linux/cdrom.h>
+#endif
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_source.h"
+#include "tsr_cdda_source.h"
+#include "tsr_file_source.h"
+#include "tsr_image.h"
+#include "tsr_util.h"
+
+/*
+ * Check if the spec names a cd drive.
+ *
+ */
+int tsr_source_isdrive(char *spec)
+{
+	return (spec == NULL || !strcmp(spec, "cdda") || !strncmp(spec, "cdda:", 5));
+}
+
+/*
+ * Open the source described by spec, NULL means the configured cd drive.
+ * Returns NULL and sets errno on failure.
+ *
+ */
+tsr_source_t *tsr_source_open(char *spec, tsr_cfg_t *cfg)
+{
+	tsr_image_t *image;
+
+	if (tsr_source_isdrive(spec))
+	{
+		return tsr_cdda_source_open((spec && spec[4] == ':') ? spec + 5 : cfg->device,
+				cfg);
+	}
+	else if (!strncmp(spec, "wav:", 4))
+	{
+		return tsr_wav_source_open(spec + 4);
+	}
+	else if (!strncmp(spec, "raw:", 4))
+	{
+		return tsr_raw_source_open(spec + 4);
+	}
+	else if (!strncmp(spec, "cue:", 4))
+	{
+		image = tsr_image_open(spec + 4);
+
+		return (image != NULL) ? &image->source : NULL;
+	}
+
+	errno = EINVAL;
+
+	return NULL;
+}
+
+/*
+ * Get a sector of little endian pcm from a file source in host byte order.
+ * Only len bytes are left of the last sector of a file, the rest of it is
+ * filled with silence.
+ *
+ */
+char *tsr_source_pcm(tsr_source_t *source, char *pcm, size_t len)
+{
+#ifndef WORDS_BIGENDIAN
+	if (len == CD_FRAMESIZE_RAW)
+	{
+		return pcm;
+	}
+
+	memcpy(source->buf, pcm, len);
+#else
+	swab(pcm, source->buf, len);
+#endif
+	memset(source->buf + len, 0, CD_FRAMESIZE_RAW - len);
+
+	return source->buf;
+}
+
+/*
+ * Close the source and free it.
+ *
+ */
+void tsr_source_close(tsr_source_t *source)
+{
+	source->close(source);
+}
+
+/*
+ * Eject the disc of the drive with the given device, its source has to be
+ * closed already. Returns 0 if there is no drive or it can't eject.
+ *
+ */
+int tsr_source_eject(char *device)
+{
+	int ok = 0;
+#ifdef CDROMEJECT
+	int fd;
+
+	fd = (device != NULL) ? open(device, O_RDONLY | O_NONBLOCK) : -1;
+
+	if (fd != -1)
+	{
+		ok = ioctl(fd, CDROMEJECT) == 0;
+		close(fd);
+	}
+#endif
+
+	return ok;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_source.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_SOURCE_H
+#define TSR_SOURCE_H
+
+#include <cdda_interface.h>
+
+#include "tsr_riplog.h"
+
+typedef struct _tsr_source_t tsr_source_t;
+
+typedef char *(*tsr_source_read_t)(tsr_source_t *source, long sector);
+typedef void (*tsr_source_speed_t)(tsr_source_t *source, int speed);
+typedef void (*tsr_source_fast_t)(tsr_source_t *source, int fast);
+typedef void (*tsr_source_close_t)(tsr_source_t *source);
+
+struct _tsr_source_t
+{
+	char *name;
+	char *device;
+	tsr_toc_t toc;
+	char buf[CD_FRAMESIZE_RAW];
+	tsr_riplog_t *riplog;
+	tsr_source_read_t read;
+	tsr_source_speed_t speed;
+	tsr_source_fast_t fast;
+	tsr_source_close_t close;
+};
+
+int tsr_source_isdrive(char *spec);
+
+tsr_source_t *tsr_source_open(char *spec, tsr_cfg_t *cfg);
+
+char *tsr_source_pcm(tsr_source_t *source, char *pcm, size_t len);
+
+void tsr_source_close(tsr_source_t *source);
+
+int tsr_source_eject(char *device);
+
+#endif
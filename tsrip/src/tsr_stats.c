@@ -0,0 +1,468 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_stats.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Timing of the stages a sector goes through, from reading it to writing the
+ * encoded data. Every track has its own stats, the times are taken with the
+ * monotonic clock and kept as totals and log2 histograms, which are updated
+ * without locks from all threads. If the kernel permits, cycles and cache
+ * misses of the threads working on a track are counted as well.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "config.h"
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#endif
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_stats.h"
+#include "tsr_util.h"
+
+static const char *tsr_stage_names[TSR_STAGES] =
+{
+	"read", "stall", "wait", "pcm", "analysis", "bitrate", "page", "write"
+};
+
+/*
+ * Allocate zeroed stats for numtracks tracks, each is done when finished
+ * pending times.
+ *
+ */
+tsr_stats_t *tsr_stats_new(int numtracks, int pending)
+{
+	tsr_stats_t *stats;
+	int i, s;
+
+	stats = (tsr_stats_t *) calloc(numtracks, sizeof(tsr_stats_t));
+
+	if (stats == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	for (i = 0; i < numtracks; i++)
+	{
+		stats[i].pending = pending;
+
+		for (s = 0; s < TSR_STAGES; s++)
+		{
+			stats[i].stages[s].min = UINT64_MAX;
+		}
+	}
+
+	return stats;
+}
+
+/*
+ * Get monotonic time in nanoseconds.
+ *
+ */
+uint64_t tsr_stats_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Start timing a stage, nothing is done without stats.
+ *
+ */
+uint64_t tsr_stats_start(tsr_stats_t *stats)
+{
+	return (stats != NULL) ? tsr_stats_now() : 0;
+}
+
+/*
+ * Stop timing a stage started at start.
+ *
+ */
+void tsr_stats_stop(tsr_stats_t *stats, int stage, uint64_t start)
+{
+	uint64_t expected = 0;
+
+	if (stats == NULL)
+	{
+		return;
+	}
+
+	if (__atomic_load_n(&stats->start, __ATOMIC_RELAXED) == 0)
+	{
+		__atomic_compare_exchange_n(&stats->start, &expected, start, 0,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+
+	tsr_stats_add(stats, stage, tsr_stats_now() - start);
+}
+
+/*
+ * Account ns nanoseconds to a stage.
+ *
+ */
+void tsr_stats_add(tsr_stats_t *stats, int stage, uint64_t ns)
+{
+	tsr_stage_t *st = &stats->stages[stage];
+	uint64_t old;
+	int b;
+
+	b = (ns > 1) ? 63 - __builtin_clzll(ns) : 0;
+	b = (b < TSR_STATS_BUCKETS) ? b : TSR_STATS_BUCKETS - 1;
+	__atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->total, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->buckets[b], 1, __ATOMIC_RELAXED);
+	old = __atomic_load_n(&st->min, __ATOMIC_RELAXED);
+
+	while (ns < old && !__atomic_compare_exchange_n(&st->min, &old, ns, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
+
+	old = __atomic_load_n(&st->max, __ATOMIC_RELAXED);
+
+	while (ns > old && !__atomic_compare_exchange_n(&st->max, &old, ns, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
+}
+
+/*
+ * Add the stats of a finished track to the ones of the disc.
+ *
+ */
+void tsr_stats_merge(tsr_stats_t *to, tsr_stats_t *from)
+{
+	int s, b;
+
+	for (s = 0; s < TSR_STAGES; s++)
+	{
+		to->stages[s].count += from->stages[s].count;
+		to->stages[s].total += from->stages[s].total;
+
+		if (from->stages[s].min < to->stages[s].min)
+		{
+			to->stages[s].min = from->stages[s].min;
+		}
+
+		if (from->stages[s].max > to->stages[s].max)
+		{
+			to->stages[s].max = from->stages[s].max;
+		}
+
+		for (b = 0; b < TSR_STATS_BUCKETS; b++)
+		{
+			to->stages[s].buckets[b] += from->stages[s].buckets[b];
+		}
+	}
+
+	if (from->start && (!to->start || from->start < to->start))
+	{
+		to->start = from->start;
+	}
+
+	if (from->end > to->end)
+	{
+		to->end = from->end;
+	}
+
+	to->sectors += from->sectors;
+	to->cycles += from->cycles;
+	to->cachemisses += from->cachemisses;
+	to->perf |= from->perf;
+}
+
+/*
+ * Called by everyone done with the track, returns 1 for the last one.
+ *
+ */
+int tsr_stats_finish(tsr_stats_t *stats)
+{
+	if (__atomic_sub_fetch(&stats->pending, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		__atomic_store_n(&stats->end, tsr_stats_now(), __ATOMIC_RELEASE);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Estimate the percentile p of a stage from its histogram, the upper bound
+ * of the bucket is returned.
+ *
+ */
+static uint64_t tsr_stats_percentile(tsr_stage_t *st, double p)
+{
+	uint64_t n = 0, want;
+	int b;
+
+	want = (uint64_t) (st->count * p);
+
+	for (b = 0; b < TSR_STATS_BUCKETS; b++)
+	{
+		n += st->buckets[b];
+
+		if (n > want)
+		{
+			return ((2ULL << b) < st->max) ? (2ULL << b) : st->max;
+		}
+	}
+
+	return st->max;
+}
+
+/*
+ * Print a human readable summary.
+ *
+ */
+void tsr_stats_print(FILE *out, tsr_stats_t *stats, char *title)
+{
+	double wall;
+	int s;
+	tsr_stage_t *st;
+
+	wall = (stats->end > stats->start) ? (stats->end - stats->start) / 1e9 : 0;
+	fprintf(out, "%s: %li sectors in %.1fs (%.1fx)\n", title, stats->sectors, wall,
+			(wall > 0) ? stats->sectors / 75. / wall : 0);
+	fprintf(out, "  %-9s %10s %10s %10s %10s %10s\n", "stage", "calls", "total s",
+			"p50 us", "p99 us", "max us");
+
+	for (s = 0; s < TSR_STAGES; s++)
+	{
+		st = &stats->stages[s];
+
+		if (st->count == 0)
+		{
+			continue;
+		}
+
+		fprintf(out, "  %-9s %10llu %10.2f %10.1f %10.1f %10.1f\n",
+				tsr_stage_names[s], (unsigned long long) st->count, st->total / 1e9,
+				tsr_stats_percentile(st, 0.5) / 1e3,
+				tsr_stats_percentile(st, 0.99) / 1e3, st->max / 1e3);
+	}
+
+	if (stats->perf)
+	{
+		fprintf(out, "  %.2f Gcycles, %.2f M cache misses\n", stats->cycles / 1e9,
+				stats->cachemisses / 1e6);
+	}
+}
+
+/*
+ * Write the stats of one track or the disc as a json object.
+ *
+ */
+static void tsr_stats_json(FILE *out, tsr_stats_t *stats)
+{
+	tsr_stage_t *st;
+	int s, b, first = 1;
+
+	fprintf(out, "{\"sectors\": %li, \"wall_ns\": %llu", stats->sectors,
+			(unsigned long long) ((stats->end > stats->start) ?
+				stats->end - stats->start : 0));
+
+	if (stats->perf)
+	{
+		fprintf(out, ", \"cycles\": %llu, \"cache_misses\": %llu",
+				(unsigned long long) stats->cycles,
+				(unsigned long long) stats->cachemisses);
+	}
+
+	fprintf(out, ", \"stages\": {");
+
+	for (s = 0; s < TSR_STAGES; s++)
+	{
+		st = &stats->stages[s];
+
+		if (st->count == 0)
+		{
+			continue;
+		}
+
+		fprintf(out, "%s\n    \"%s\": {\"count\": %llu, \"total_ns\": %llu, "
+				"\"min_ns\": %llu, \"max_ns\": %llu, \"p50_ns\": %llu, "
+				"\"p90_ns\": %llu, \"p99_ns\": %llu, \"log2_histogram\": [",
+				first ? "" : ",", tsr_stage_names[s],
+				(unsigned long long) st->count, (unsigned long long) st->total,
+				(unsigned long long) st->min, (unsigned long long) st->max,
+				(unsigned long long) tsr_stats_percentile(st, 0.5),
+				(unsigned long long) tsr_stats_percentile(st, 0.9),
+				(unsigned long long) tsr_stats_percentile(st, 0.99));
+		first = 0;
+
+		for (b = 0; b < TSR_STATS_BUCKETS; b++)
+		{
+			fprintf(out, "%s%llu", b ? ", " : "",
+					(unsigned long long) st->buckets[b]);
+		}
+
+		fprintf(out, "]}");
+	}
+
+	fprintf(out, "}}");
+}
+
+/*
+ * Write the report for all tracks and the whole disc, "-" is stdout.
+ * Returns 0 and sets errno on failure.
+ *
+ */
+int tsr_stats_write_json(char *filename, tsr_stats_t *stats, int numtracks)
+{
+	FILE *out;
+	tsr_stats_t disc;
+	int i, s, err;
+
+	out = (!strcmp(filename, "-")) ? stdout : fopen(filename, "w");
+
+	if (out == NULL)
+	{
+		return 0;
+	}
+
+	memset(&disc, 0, sizeof(disc));
+
+	for (s = 0; s < TSR_STAGES; s++)
+	{
+		disc.stages[s].min = UINT64_MAX;
+	}
+
+	fprintf(out, "{\"tracks\": [");
+
+	for (i = 0; i < numtracks; i++)
+	{
+		fprintf(out, "%s\n  {\"track\": %i, \"stats\": ", i ? "," : "", i + 1);
+		tsr_stats_json(out, &stats[i]);
+		fprintf(out, "}");
+		tsr_stats_merge(&disc, &stats[i]);
+	}
+
+	fprintf(out, "],\n\"disc\": ");
+	tsr_stats_json(out, &disc);
+	fprintf(out, "}\n");
+	err = ferror(out);
+
+	if (out != stdout)
+	{
+		err |= fclose(out);
+	}
+
+	return !err;
+}
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+/*
+ * Open a counter for the calling thread, only user space is counted, which
+ * is allowed with the default perf_event_paranoid setting.
+ *
+ */
+static int tsr_perf_counter(uint64_t config)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/*
+ * Open the cycle and cache miss counters of the calling thread, if the
+ * kernel doesn't allow it nothing is counted.
+ *
+ */
+void tsr_perf_open(tsr_perf_t *perf)
+{
+	perf->fd[0] = -1;
+	perf->fd[1] = -1;
+	perf->last[0] = 0;
+	perf->last[1] = 0;
+#ifdef HAVE_LINUX_PERF_EVENT_H
+	perf->fd[0] = tsr_perf_counter(PERF_COUNT_HW_CPU_CYCLES);
+	perf->fd[1] = tsr_perf_counter(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+}
+
+/*
+ * Account the events since the last call to the stats.
+ *
+ */
+void tsr_perf_account(tsr_perf_t *perf, tsr_stats_t *stats)
+{
+	uint64_t value;
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (perf->fd[i] == -1 || read(perf->fd[i], &value, sizeof(value))
+				!= sizeof(value))
+		{
+			continue;
+		}
+
+		if (stats != NULL)
+		{
+			__atomic_fetch_add((i == 0) ? &stats->cycles : &stats->cachemisses,
+					value - perf->last[i], __ATOMIC_RELAXED);
+			__atomic_store_n(&stats->perf, 1, __ATOMIC_RELAXED);
+		}
+
+		perf->last[i] = value;
+	}
+}
+
+/*
+ * Close the counters.
+ *
+ */
+void tsr_perf_close(tsr_perf_t *perf)
+{
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (perf->fd[i] != -1)
+		{
+			close(perf->fd[i]);
+		}
+	}
+}
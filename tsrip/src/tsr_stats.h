@@ -0,0 +1,92 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_stats.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_STATS_H
+#define TSR_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TSR_STAGE_READ 0
+#define TSR_STAGE_STALL 1
+#define TSR_STAGE_WAIT 2
+#define TSR_STAGE_PCM 3
+#define TSR_STAGE_ANALYSIS 4
+#define TSR_STAGE_BITRATE 5
+#define TSR_STAGE_PAGE 6
+#define TSR_STAGE_WRITE 7
+#define TSR_STAGES 8
+
+#define TSR_STATS_BUCKETS 40
+
+typedef struct _tsr_stage_t
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[TSR_STATS_BUCKETS];
+} tsr_stage_t;
+
+typedef struct _tsr_stats_t
+{
+	tsr_stage_t stages[TSR_STAGES];
+	long sectors;
+	uint64_t start;
+	uint64_t end;
+	uint64_t cycles;
+	uint64_t cachemisses;
+	int perf;
+	int pending;
+} tsr_stats_t;
+
+typedef struct _tsr_perf_t
+{
+	int fd[2];
+	uint64_t last[2];
+} tsr_perf_t;
+
+tsr_stats_t *tsr_stats_new(int numtracks, int pending);
+
+uint64_t tsr_stats_now();
+
+uint64_t tsr_stats_start(tsr_stats_t *stats);
+
+void tsr_stats_stop(tsr_stats_t *stats, int stage, uint64_t start);
+
+void tsr_stats_add(tsr_stats_t *stats, int stage, uint64_t ns);
+
+void tsr_stats_merge(tsr_stats_t *to, tsr_stats_t *from);
+
+int tsr_stats_finish(tsr_stats_t *stats);
+
+void tsr_stats_print(FILE *out, tsr_stats_t *stats, char *title);
+
+int tsr_stats_write_json(char *filename, tsr_stats_t *stats, int numtracks);
+
+void tsr_perf_open(tsr_perf_t *perf);
+
+void tsr_perf_account(tsr_perf_t *perf, tsr_stats_t *stats);
+
+void tsr_perf_close(tsr_perf_t *perf);
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_tags.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The tags of the files. Files are written with padding after their vorbis
+ * comments, a flac padding block or zeros at the end of the ogg comment
+ * packet, so the tags of a finished file can be rewritten in place: the
+ * new comments take from the padding and only the header of the file is
+ * written again, the audio stays where it is.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_tags.h"
+#include "tsr_util.h"
+
+/*
+ * Bytes of an ogg file read to find the comment packet, which is on the
+ * second page and a few more if it is large.
+ *
+ */
+#define TSR_TAGS_OGG_HEAD (256 * 1024)
+
+/*
+ * Most tags of a file, with room for the ReplayGain tags and the
+ * terminating NULL.
+ *
+ */
+#define TSR_TAGS_MAX 12
+
+/*
+ * Return the vorbis comments of the track as NULL terminated list of
+ * "NAME=value" strings. Without metainfo only the encoder is tagged.
+ *
+ */
+char **tsr_tags_new(int tracknum, tsr_metainfo_t *metainfo)
+{
+	char **tags;
+	int n = 0;
+
+	tags = (char **) calloc(TSR_TAGS_MAX, sizeof(char *));
+
+	if (tags == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	tags[n++] = strdup("ENCODER=tsrip");
+
+	if (metainfo == NULL)
+	{
+		return tags;
+	}
+
+	asprintf(&tags[n++], "TITLE=%s", metainfo->trackinfos[tracknum].title);
+	asprintf(&tags[n++], "ARTIST=%s", metainfo->trackinfos[tracknum].artist);
+	asprintf(&tags[n++], "ALBUM=%s", metainfo->album);
+
+	if (metainfo->discnum > 0)
+	{
+		asprintf(&tags[n++], "DISC=%i", metainfo->discnum);
+	}
+
+	asprintf(&tags[n++], "TRACKNUMBER=%i", tracknum + 1);
+
+	return tags;
+}
+
+/*
+ * Return the vorbis comments of the file of a whole disc, with the cue
+ * sheet of its tracks.
+ *
+ */
+char **tsr_tags_new_disc(tsr_metainfo_t *metainfo, char *cuesheet)
+{
+	char **tags;
+	int n = 0;
+
+	tags = (char **) calloc(TSR_TAGS_MAX, sizeof(char *));
+
+	if (tags == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	tags[n++] = strdup("ENCODER=tsrip");
+	asprintf(&tags[n++], "TITLE=%s", metainfo->album);
+	asprintf(&tags[n++], "ARTIST=%s", (metainfo->numtracks == 0) ? "Unknown Artist" :
+			(metainfo->ismultiple) ? "Various Artists" :
+			metainfo->trackinfos[0].artist);
+	asprintf(&tags[n++], "ALBUM=%s", metainfo->album);
+
+	if (metainfo->discnum > 0)
+	{
+		asprintf(&tags[n++], "DISC=%i", metainfo->discnum);
+	}
+
+	asprintf(&tags[n++], "CUESHEET=%s", cuesheet);
+
+	return tags;
+}
+
+/*
+ * Add the ReplayGain tags of the track to the tags, the file of a whole
+ * disc has the values of the album for its track. Tracks which were not
+ * measured get none and the album tags are only added if all tracks were
+ * measured.
+ *
+ */
+void tsr_tags_add_gain(char **tags, tsr_loudness_t *loudness, int tracknum)
+{
+	double trackgain, trackpeak, albumgain, albumpeak;
+	int n, album;
+
+	if (loudness == NULL)
+	{
+		return;
+	}
+
+	for (n = 0; tags[n] != NULL; n++);
+
+	album = tsr_loudness_album(loudness, &albumgain, &albumpeak);
+
+	if (tracknum == TSR_DISC && album)
+	{
+		trackgain = albumgain;
+		trackpeak = albumpeak;
+	}
+	else if (tracknum == TSR_DISC
+			|| !tsr_loudness_track(loudness, tracknum, &trackgain, &trackpeak))
+	{
+		return;
+	}
+
+	asprintf(&tags[n++], "REPLAYGAIN_TRACK_GAIN=%+.2f dB", trackgain);
+	asprintf(&tags[n++], "REPLAYGAIN_TRACK_PEAK=%.6f", trackpeak);
+
+	if (album)
+	{
+		asprintf(&tags[n++], "REPLAYGAIN_ALBUM_GAIN=%+.2f dB", albumgain);
+		asprintf(&tags[n++], "REPLAYGAIN_ALBUM_PEAK=%.6f", albumpeak);
+	}
+}
+
+/*
+ * Free the list of tags.
+ *
+ */
+void tsr_tags_free(char **tags)
+{
+	int i;
+
+	for (i = 0; tags[i] != NULL; i++)
+	{
+		free(tags[i]);
+	}
+
+	free(tags);
+}
+
+static void tsr_tags_put32le(unsigned char *buf, uint32_t val)
+{
+	buf[0] = val & 0xff;
+	buf[1] = (val >> 8) & 0xff;
+	buf[2] = (val >> 16) & 0xff;
+	buf[3] = (val >> 24) & 0xff;
+}
+
+static uint32_t tsr_tags_get32le(unsigned char *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+/*
+ * Pack the vendor string and the tags as vorbis comments into buf. Returns
+ * the size of the comments, they are only written if they fit into size.
+ *
+ */
+static size_t tsr_tags_pack(unsigned char *buf, size_t size, unsigned char *vendor,
+		uint32_t vendorlen, char **tags)
+{
+	size_t len, n;
+	int i;
+
+	for (i = 0, len = 8 + vendorlen; tags[i] != NULL; i++)
+	{
+		len += 4 + strlen(tags[i]);
+	}
+
+	if (len > size)
+	{
+		return len;
+	}
+
+	tsr_tags_put32le(buf, vendorlen);
+	memmove(buf + 4, vendor, vendorlen);
+	buf += 4 + vendorlen;
+
+	for (i = 0; tags[i] != NULL; i++);
+
+	tsr_tags_put32le(buf, i);
+	buf += 4;
+
+	for (i = 0; tags[i] != NULL; i++)
+	{
+		n = strlen(tags[i]);
+		tsr_tags_put32le(buf, n);
+		memcpy(buf + 4, tags[i], n);
+		buf += 4 + n;
+	}
+
+	return len;
+}
+
+/*
+ * Rewrite the vorbis comment block of a flac file and the padding block
+ * following it. Returns 0 if the file has no such blocks or the tags don't
+ * fit.
+ *
+ */
+static int tsr_tags_write_flac(int fd, char **tags)
+{
+	unsigned char head[4], *buf;
+	off_t pos = 4, comment = -1;
+	uint32_t len, commentlen = 0, vendorlen;
+	size_t space, n;
+	int ok;
+
+	if (pread(fd, head, 4, 0) != 4 || memcmp(head, "fLaC", 4))
+	{
+		return 0;
+	}
+
+	/* find the comments and the padding right behind them */
+	while (1)
+	{
+		if (pread(fd, head, 4, pos) != 4)
+		{
+			return 0;
+		}
+
+		len = head[1] << 16 | head[2] << 8 | head[3];
+
+		if ((head[0] & 0x7f) == 4)
+		{
+			comment = pos;
+			commentlen = len;
+		}
+		else if ((head[0] & 0x7f) == 1 && comment != -1
+				&& pos == comment + 4 + commentlen)
+		{
+			break;
+		}
+
+		if (head[0] & 0x80)
+		{
+			return 0;
+		}
+
+		pos += 4 + len;
+	}
+
+	space = commentlen + 4 + len;
+	buf = (unsigned char *) calloc(1, space + 4);
+
+	if (buf == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	if (pread(fd, buf, commentlen, comment + 4) != (ssize_t) commentlen || commentlen < 4
+			|| (vendorlen = tsr_tags_get32le(buf)) > commentlen - 4)
+	{
+		free(buf);
+
+		return 0;
+	}
+
+	/* the vendor string is kept, it is moved behind the new header */
+	memmove(buf + 8, buf + 4, vendorlen);
+	n = tsr_tags_pack(buf + 4, space - 4, buf + 8, vendorlen, tags);
+
+	if (n > space - 4)
+	{
+		free(buf);
+
+		return 0;
+	}
+
+	buf[0] = 4;
+	buf[1] = (n >> 16) & 0xff;
+	buf[2] = (n >> 8) & 0xff;
+	buf[3] = n & 0xff;
+	len = space - 4 - n;
+	buf[4 + n] = 1 | (head[0] & 0x80);
+	buf[5 + n] = (len >> 16) & 0xff;
+	buf[6 + n] = (len >> 8) & 0xff;
+	buf[7 + n] = len & 0xff;
+	memset(buf + 8 + n, 0, len);
+	ok = pwrite(fd, buf, space + 4, comment) == (ssize_t) (space + 4);
+	free(buf);
+
+	return ok;
+}
+
+/*
+ * Return the crc of an ogg page, its crc field has to be zero.
+ *
+ */
+static uint32_t tsr_tags_ogg_crc(unsigned char *page, size_t len)
+{
+	uint32_t crc = 0;
+	size_t i;
+	int bit;
+
+	for (i = 0; i < len; i++)
+	{
+		crc ^= (uint32_t) page[i] << 24;
+
+		for (bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+/*
+ * Walk the segments of the second packet of the ogg stream in buf, the
+ * comment packet. If packet is NULL its length is returned in len and its
+ * bytes in old, else the segments are overwritten with packet and the
+ * crcs of their pages are updated. Returns the end of the last page
+ * touched, or 0 if the packet isn't complete in buf.
+ *
+ */
+static size_t tsr_tags_ogg_walk(unsigned char *buf, size_t size,
+		unsigned char *packet, unsigned char *old, size_t *len)
+{
+	size_t pos = 0, body, done = 0;
+	int numpacket = 0, numsegs, i, touched;
+
+	while (numpacket < 2 && pos + 27 <= size && !memcmp(buf + pos, "OggS", 4))
+	{
+		numsegs = buf[pos + 26];
+		body = pos + 27 + numsegs;
+		touched = 0;
+
+		for (i = 0; i < numsegs && numpacket < 2; i++)
+		{
+			if (body + buf[pos + 27 + i] > size)
+			{
+				return 0;
+			}
+
+			if (numpacket == 1)
+			{
+				if (packet != NULL)
+				{
+					memcpy(buf + body, packet + done, buf[pos + 27 + i]);
+				}
+				else if (old != NULL)
+				{
+					memcpy(old + done, buf + body, buf[pos + 27 + i]);
+				}
+
+				done += buf[pos + 27 + i];
+				touched = 1;
+			}
+
+			body += buf[pos + 27 + i];
+			numpacket += buf[pos + 27 + i] < 255;
+		}
+
+		for (; i < numsegs; i++)
+		{
+			body += buf[pos + 27 + i];
+		}
+
+		if (touched && packet != NULL)
+		{
+			memset(buf + pos + 22, 0, 4);
+			tsr_tags_put32le(buf + pos + 22, tsr_tags_ogg_crc(buf + pos, body - pos));
+		}
+
+		pos = body;
+	}
+
+	*len = done;
+
+	return (numpacket == 2) ? pos : 0;
+}
+
+/*
+ * Rewrite the comment packet of an ogg vorbis file. The packet keeps its
+ * length, so only the pages it is on change. Returns 0 if the tags don't
+ * fit.
+ *
+ */
+static int tsr_tags_write_ogg(int fd, char **tags)
+{
+	unsigned char *buf, *old, *packet;
+	ssize_t size;
+	size_t len, end, n;
+	uint32_t vendorlen;
+	int ok = 0;
+
+	buf = (unsigned char *) malloc(TSR_TAGS_OGG_HEAD);
+
+	if (buf == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	size = pread(fd, buf, TSR_TAGS_OGG_HEAD, 0);
+
+	if (size <= 0 || !tsr_tags_ogg_walk(buf, size, NULL, NULL, &len) || len < 16)
+	{
+		free(buf);
+
+		return 0;
+	}
+
+	old = (unsigned char *) malloc(len);
+	packet = (unsigned char *) calloc(1, len);
+
+	if (old == NULL || packet == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	tsr_tags_ogg_walk(buf, size, NULL, old, &len);
+	vendorlen = tsr_tags_get32le(old + 7);
+
+	if (old[0] == 3 && !memcmp(old + 1, "vorbis", 6) && vendorlen <= len - 16)
+	{
+		/* header, comments, framing bit and the padding up to the old length */
+		memcpy(packet, old, 7);
+		n = tsr_tags_pack(packet + 7, len - 8, old + 11, vendorlen, tags);
+
+		if (n <= len - 8)
+		{
+			packet[7 + n] = 1;
+			end = tsr_tags_ogg_walk(buf, size, packet, NULL, &len);
+			ok = pwrite(fd, buf, end, 0) == (ssize_t) end;
+		}
+	}
+
+	free(packet);
+	free(old);
+	free(buf);
+
+	return ok;
+}
+
+/*
+ * Rewrite the tags of the finished file of the output in place. Returns 0
+ * if they can't be written.
+ *
+ */
+int tsr_tags_write(char *filename, tsr_output_t *output, char **tags)
+{
+	int fd, ok;
+
+	fd = open(filename, O_RDWR);
+
+	if (fd == -1)
+	{
+		return 0;
+	}
+
+	ok = (output->enctype == CFG_TYPE_FLAC) ? tsr_tags_write_flac(fd, tags) :
+		tsr_tags_write_ogg(fd, tags);
+
+	if (close(fd) == -1)
+	{
+		ok = 0;
+	}
+
+	return ok;
+}
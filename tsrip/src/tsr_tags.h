@@ -0,0 +1,51 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_tags.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_TAGS_H
+#define TSR_TAGS_H
+
+#include "tsr_loudness.h"
+
+/*
+ * Padding left after the tags, so they can be changed without rewriting the
+ * whole file.
+ *
+ */
+#define TSR_TAGS_PADDING 8192
+
+/*
+ * Padding of the file of a whole disc, which has the cue sheet in its tags.
+ *
+ */
+#define TSR_TAGS_DISC_PADDING 65536
+
+char **tsr_tags_new(int tracknum, tsr_metainfo_t *metainfo);
+
+char **tsr_tags_new_disc(tsr_metainfo_t *metainfo, char *cuesheet);
+
+void tsr_tags_add_gain(char **tags, tsr_loudness_t *loudness, int tracknum);
+
+void tsr_tags_free(char **tags);
+
+int tsr_tags_write(char *filename, tsr_output_t *output, char **tags);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_toc.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * The table of contents of a disc, the sector ranges of the tracks. It is
+ * read from the drive or from the cue sheet of a disc image, the musicbrainz
+ * disc id is computed from it, so a disc can be looked up without a drive.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <cdda_interface.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_toc.h"
+#include "tsr_util.h"
+
+/*
+ * Sectors before the first track, the disc id counts them.
+ *
+ */
+#define TSR_TOC_PREGAP 150
+
+typedef struct _tsr_sha1_t
+{
+	uint32_t h[5];
+	uint64_t len;
+	unsigned char block[64];
+	int fill;
+} tsr_sha1_t;
+
+/*
+ * Read the table of contents from the drive.
+ *
+ */
+void tsr_toc_read(cdrom_drive *drive, tsr_toc_t *toc)
+{
+	int i;
+
+	toc->numtracks = (drive->tracks > TSR_MAXTRACKS) ? TSR_MAXTRACKS : drive->tracks;
+
+	for (i = 0; i < toc->numtracks; i++)
+	{
+		toc->firstsector[i] = cdda_track_firstsector(drive, i + 1);
+		toc->lastsector[i] = cdda_track_lastsector(drive, i + 1);
+	}
+
+	toc->leadout = toc->lastsector[toc->numtracks - 1] + 1;
+}
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/*
+ * Process one block of 64 bytes.
+ *
+ */
+static void tsr_sha1_block(tsr_sha1_t *sha1)
+{
+	uint32_t w[80], a, b, c, d, e, f, k, t;
+	int i;
+
+	for (i = 0; i < 16; i++)
+	{
+		w[i] = (uint32_t) sha1->block[i * 4] << 24
+			| (uint32_t) sha1->block[i * 4 + 1] << 16
+			| (uint32_t) sha1->block[i * 4 + 2] << 8
+			| (uint32_t) sha1->block[i * 4 + 3];
+	}
+
+	for (i = 16; i < 80; i++)
+	{
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	a = sha1->h[0];
+	b = sha1->h[1];
+	c = sha1->h[2];
+	d = sha1->h[3];
+	e = sha1->h[4];
+
+	for (i = 0; i < 80; i++)
+	{
+		if (i < 20)
+		{
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		}
+		else if (i < 40)
+		{
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		}
+		else if (i < 60)
+		{
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		}
+		else
+		{
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		t = ROL(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	sha1->h[0] += a;
+	sha1->h[1] += b;
+	sha1->h[2] += c;
+	sha1->h[3] += d;
+	sha1->h[4] += e;
+}
+
+/*
+ * Add len bytes of data to the hash.
+ *
+ */
+static void tsr_sha1_update(tsr_sha1_t *sha1, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) data;
+
+	sha1->len += len;
+
+	while (len--)
+	{
+		sha1->block[sha1->fill++] = *p++;
+
+		if (sha1->fill == 64)
+		{
+			tsr_sha1_block(sha1);
+			sha1->fill = 0;
+		}
+	}
+}
+
+/*
+ * Pad the last block and store the 20 byte digest.
+ *
+ */
+static void tsr_sha1_final(tsr_sha1_t *sha1, unsigned char *digest)
+{
+	uint64_t bits = sha1->len * 8;
+	unsigned char pad = 0x80;
+	unsigned char lenbuf[8];
+	int i;
+
+	tsr_sha1_update(sha1, &pad, 1);
+	pad = 0;
+
+	while (sha1->fill != 56)
+	{
+		tsr_sha1_update(sha1, &pad, 1);
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		lenbuf[i] = (unsigned char) (bits >> (56 - i * 8));
+	}
+
+	tsr_sha1_update(sha1, lenbuf, 8);
+
+	for (i = 0; i < 20; i++)
+	{
+		digest[i] = (unsigned char) (sha1->h[i / 4] >> (24 - (i % 4) * 8));
+	}
+}
+
+/*
+ * Compute the musicbrainz disc id, the base64 encoded sha1 of the first and
+ * last track number and the sector offsets of the lead-out and all tracks.
+ * Musicbrainz uses '.', '_' and '-' instead of '+', '/' and '='.
+ *
+ */
+char *tsr_toc_discid(tsr_toc_t *toc)
+{
+	static const char *alphabet =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._";
+	tsr_sha1_t sha1 = {{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+		0xc3d2e1f0}, 0, {0}, 0};
+	unsigned char digest[21];
+	char buf[16];
+	char *discid;
+	uint32_t v;
+	int i;
+
+	snprintf(buf, sizeof(buf), "%02X%02X", 1, toc->numtracks);
+	tsr_sha1_update(&sha1, buf, 4);
+	snprintf(buf, sizeof(buf), "%08lX", toc->leadout + TSR_TOC_PREGAP);
+	tsr_sha1_update(&sha1, buf, 8);
+
+	for (i = 0; i < TSR_MAXTRACKS; i++)
+	{
+		snprintf(buf, sizeof(buf), "%08lX", (i < toc->numtracks) ?
+				toc->firstsector[i] + TSR_TOC_PREGAP : 0);
+		tsr_sha1_update(&sha1, buf, 8);
+	}
+
+	tsr_sha1_final(&sha1, digest);
+	digest[20] = 0;
+	discid = (char *) malloc(29);
+
+	if (discid == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	for (i = 0; i < 7; i++)
+	{
+		v = (uint32_t) digest[i * 3] << 16 | (uint32_t) digest[i * 3 + 1] << 8
+			| digest[i * 3 + 2];
+		discid[i * 4] = alphabet[(v >> 18) & 63];
+		discid[i * 4 + 1] = alphabet[(v >> 12) & 63];
+		discid[i * 4 + 2] = alphabet[(v >> 6) & 63];
+		discid[i * 4 + 3] = alphabet[v & 63];
+	}
+
+	/* 20 bytes give 27 chars and one pad char */
+	discid[27] = '-';
+	discid[28] = '\0';
+
+	return discid;
+}
@@ -20,8 +20,14 @@
  *
  */
 
+#ifndef TSR_TYPES_H
+#define TSR_TYPES_H
+
 #include <stdio.h>
-#include <vorbis/vorbisenc.h>
+#include <stdint.h>
+
+#include "tsr_writer.h"
+#include "tsr_stats.h"
 
 typedef struct _tsr_trackinfo_t
 {
@@ -29,24 +35,53 @@ typedef struct _tsr_trackinfo_t
 	char *artist;
 } tsr_trackinfo_t;
 
+/*
+ * The metainfo is a single block with the track array and an arena for the
+ * strings behind it, strings which don't fit go to further chunks. The
+ * strings belong to the metainfo, they are added with tsr_metainfo_str.
+ *
+ */
 typedef struct _tsr_metainfo_t
 {
 	char *album;
 	int numtracks;
 	int discnum;
 	int ismultiple;
-	tsr_trackinfo_t **trackinfos;
+	tsr_trackinfo_t *trackinfos;
+	char *arena;
+	size_t arenasize;
+	void *chunks;
 } tsr_metainfo_t;
 
+#define TSR_MAXTRACKS 99
+
+/*
+ * The track number of the file of a whole disc.
+ *
+ */
+#define TSR_DISC -1
+
+typedef struct _tsr_toc_t
+{
+	int numtracks;
+	long firstsector[TSR_MAXTRACKS];
+	long lastsector[TSR_MAXTRACKS];
+	long leadout;
+} tsr_toc_t;
+
 typedef struct _tsr_trackfile_t tsr_trackfile_t;
 
-typedef void (*tsr_trackfile_encode_t)(tsr_trackfile_t *trackfile, int8_t *buffer);
-typedef void (*tsr_trackfile_finish_t)(tsr_trackfile_t *trackfile);
+typedef void (*tsr_trackfile_encode_t)(tsr_trackfile_t *trackfile, int8_t *buffer,
+		int sectors);
+typedef int (*tsr_trackfile_finish_t)(tsr_trackfile_t *trackfile);
 
 struct _tsr_trackfile_t
 {
-	FILE *file_s;
+	tsr_writer_t *writer;
+	tsr_stats_t *stats;
 	char *filename;
 	tsr_trackfile_encode_t encode;
 	tsr_trackfile_finish_t finish;
 };
+
+#endif
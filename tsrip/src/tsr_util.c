@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <errno.h>
 
@@ -31,6 +32,15 @@
 #include "tsr_cfg.h"
 #include "tsr_util.h"
 
+#define TSR_TMPDIR ".tsrip-tmp"
+
+/*
+ * Arena of a new metainfo, for the album and per track.
+ *
+ */
+#define TSR_METAINFO_ARENA 256
+#define TSR_METAINFO_TRACK 64
+
 /*
  * Replace chars which aren't usable for pathnames.
  *
@@ -95,10 +105,12 @@ void tsr_preparefile(tsr_cfg_t *cfg, char *str)
 }
 
 /*
- * Create filename and needed directorys.
+ * Create filename with the given extension and needed directorys. The file
+ * of a whole disc, TSR_DISC, is named after the album.
  *
  */
-char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum)
+char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum,
+		char *ext)
 {
 	char *path = NULL;
 	char *artist;
@@ -111,11 +123,11 @@ char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum)
 
 	if (metainfo->ismultiple)
 	{
-		artist = "Various";
+		artist = strdup("Various");
 	}
 	else
 	{
-		artist = strdup(metainfo->trackinfos[tracknum]->artist);
+		artist = strdup(metainfo->trackinfos[(tracknum == TSR_DISC) ? 0 : tracknum].artist);
 	}
 
 	mode = 0755;
@@ -159,9 +171,10 @@ char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum)
 		exit(EXIT_FAILURE);
 	}
 
-	title = strdup(metainfo->trackinfos[tracknum]->title);
+	title = strdup((tracknum == TSR_DISC) ? metainfo->album :
+			metainfo->trackinfos[tracknum].title);
 	tsr_preparefile(cfg, title);
-	asprintf(&path, "%s/%s.ogg", path, title);
+	asprintf(&path, "%s/%s.%s", path, title, ext);
 	free(title);
 	free(artist);
 	free(album);
@@ -169,93 +182,216 @@ char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum)
 	return path;
 }
 
+/*
+ * Create the name of the file the output of a track is encoded to before
+ * its metainfo is known, in a directory of the music directory so it can
+ * be renamed to its final name. With a file per disc all tracks have the
+ * same one.
+ *
+ */
+char *tsr_get_tmpfilename(tsr_cfg_t *cfg, char *discid, int tracknum, char *ext)
+{
+	char *dir, *path;
+
+	if (*cfg->musicdir == '~')
+	{
+		asprintf(&dir, "%s%s/%s", getenv("HOME"), cfg->musicdir + 1, TSR_TMPDIR);
+	}
+	else
+	{
+		asprintf(&dir, "%s/%s", cfg->musicdir, TSR_TMPDIR);
+	}
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+	{
+		perror("Failed to create temporary directory");
+		exit(EXIT_FAILURE);
+	}
+
+	if (cfg->singlefile)
+	{
+		asprintf(&path, "%s/%s.disc.%s", dir, discid, ext);
+	}
+	else
+	{
+		asprintf(&path, "%s/%s.%02i.%s", dir, discid, tracknum + 1, ext);
+	}
+	free(dir);
+
+	return path;
+}
+
 void tsr_exit_error(char *file, int line, int err)
 {
-	printf("File %s:line %i: %s", file, line, strerror(errno));
+	printf("File %s:line %i: %s", file, line, strerror(err));
 	exit(EXIT_FAILURE);
 }
 
 /*
- * Create a new instance of an metainfo structure.
+ * Create a metainfo with an arena of the given size for the strings.
  *
  */
-tsr_metainfo_t *tsr_metainfo_new(int size)
+static tsr_metainfo_t *tsr_metainfo_alloc(int numtracks, size_t arenasize)
 {
 	int i;
 	tsr_metainfo_t *metainfo;
 
-	metainfo = (tsr_metainfo_t *) malloc(sizeof(tsr_metainfo_t));
+	metainfo = (tsr_metainfo_t *) malloc(sizeof(tsr_metainfo_t)
+			+ numtracks * sizeof(tsr_trackinfo_t) + arenasize);
 
 	if (metainfo == NULL)
 	{
 		tsr_exit_error(__FILE__, __LINE__, errno);
 	}
 
-	metainfo->trackinfos = (tsr_trackinfo_t **) malloc(size * sizeof(tsr_metainfo_t));
+	metainfo->album = NULL;
+	metainfo->numtracks = numtracks;
+	metainfo->discnum = 0;
+	metainfo->ismultiple = 0;
+	metainfo->trackinfos = (tsr_trackinfo_t *) (metainfo + 1);
+	metainfo->arena = (char *) (metainfo->trackinfos + numtracks);
+	metainfo->arenasize = arenasize;
+	metainfo->chunks = NULL;
 
-	if (metainfo->trackinfos == NULL)
+	for (i = 0; i < numtracks; i++)
 	{
-		tsr_exit_error(__FILE__, __LINE__, errno);
+		metainfo->trackinfos[i].title = NULL;
+		metainfo->trackinfos[i].artist = NULL;
+	}
+
+	return metainfo;
+}
+
+/*
+ * Create a new instance of an metainfo structure for the given number of
+ * tracks, without any strings.
+ *
+ */
+tsr_metainfo_t *tsr_metainfo_new(int size)
+{
+	return tsr_metainfo_alloc(size, TSR_METAINFO_ARENA + size * TSR_METAINFO_TRACK);
+}
+
+/*
+ * Return str as string of the metainfo. A string the metainfo has already
+ * is shared, e.g. the artist of all tracks of an album.
+ *
+ */
+char *tsr_metainfo_str(tsr_metainfo_t *metainfo, const char *str)
+{
+	size_t len;
+	void **chunk;
+	char *copy;
+	int i;
+
+	if (metainfo->album != NULL && !strcmp(metainfo->album, str))
+	{
+		return metainfo->album;
+	}
+
+	for (i = 0; i < metainfo->numtracks; i++)
+	{
+		if (metainfo->trackinfos[i].artist != NULL
+				&& !strcmp(metainfo->trackinfos[i].artist, str))
+		{
+			return metainfo->trackinfos[i].artist;
+		}
+
+		if (metainfo->trackinfos[i].title != NULL
+				&& !strcmp(metainfo->trackinfos[i].title, str))
+		{
+			return metainfo->trackinfos[i].title;
+		}
 	}
 
-	for (i = 0; i < size; i++)
+	len = strlen(str) + 1;
+
+	/* a new chunk of at least the size of a whole arena */
+	if (len > metainfo->arenasize)
 	{
-		metainfo->trackinfos[i] = (tsr_trackinfo_t *) malloc(sizeof(tsr_trackinfo_t));
+		metainfo->arenasize = (len > TSR_METAINFO_ARENA) ? len : TSR_METAINFO_ARENA;
+		chunk = (void **) malloc(sizeof(void *) + metainfo->arenasize);
 
-		if (metainfo->trackinfos[i] == NULL)
+		if (chunk == NULL)
 		{
 			tsr_exit_error(__FILE__, __LINE__, errno);
 		}
+
+		*chunk = metainfo->chunks;
+		metainfo->chunks = chunk;
+		metainfo->arena = (char *) (chunk + 1);
 	}
 
-	return metainfo;
+	copy = metainfo->arena;
+	memcpy(copy, str, len);
+	metainfo->arena += len;
+	metainfo->arenasize -= len;
+
+	return copy;
 }
 
 /*
- * Create a new metainfo and copy values from an existing one.
+ * Create a new metainfo and copy values from an existing one. The copy is
+ * a single block, with an arena just large enough for the strings.
  * 
  */
 tsr_metainfo_t *tsr_metainfo_copy(tsr_metainfo_t *metainfo)
 {
 	int i;
+	size_t size = 0;
 	tsr_metainfo_t *metainfoc;
 
-	metainfoc = tsr_metainfo_new(metainfo->numtracks);
+	size += (metainfo->album != NULL) ? strlen(metainfo->album) + 1 : 0;
 
-	if (metainfoc == NULL)
+	for (i = 0; i < metainfo->numtracks; i++)
 	{
-		tsr_exit_error(__FILE__, __LINE__, errno);
+		size += (metainfo->trackinfos[i].title != NULL) ?
+			strlen(metainfo->trackinfos[i].title) + 1 : 0;
+		size += (metainfo->trackinfos[i].artist != NULL) ?
+			strlen(metainfo->trackinfos[i].artist) + 1 : 0;
 	}
 
-	metainfoc->album = strdup(metainfo->album);
-	metainfoc->numtracks = metainfo->numtracks;
+	metainfoc = tsr_metainfo_alloc(metainfo->numtracks, size);
 	metainfoc->discnum = metainfo->discnum;
 	metainfoc->ismultiple = metainfo->ismultiple;
 
+	if (metainfo->album != NULL)
+	{
+		metainfoc->album = tsr_metainfo_str(metainfoc, metainfo->album);
+	}
+
 	for (i = 0; i < metainfoc->numtracks; i++)
 	{
-		metainfoc->trackinfos[i]->title = strdup(metainfo->trackinfos[i]->title);
-		metainfoc->trackinfos[i]->artist = strdup(metainfo->trackinfos[i]->artist);
+		if (metainfo->trackinfos[i].title != NULL)
+		{
+			metainfoc->trackinfos[i].title = tsr_metainfo_str(metainfoc,
+					metainfo->trackinfos[i].title);
+		}
+
+		if (metainfo->trackinfos[i].artist != NULL)
+		{
+			metainfoc->trackinfos[i].artist = tsr_metainfo_str(metainfoc,
+					metainfo->trackinfos[i].artist);
+		}
 	}
 
 	return metainfoc;
 }
 
 /*
- * Free metainfo structure.
+ * Free metainfo structure with all its strings.
  *
  */
 void tsr_metainfo_free(tsr_metainfo_t *metainfo)
 {
-	int i;
+	void **chunk;
 
-	for (i = 0; i < metainfo->numtracks; i++)
+	while ((chunk = (void **) metainfo->chunks) != NULL)
 	{
-		free(metainfo->trackinfos[i]);
+		metainfo->chunks = *chunk;
+		free(chunk);
 	}
 
-	free(metainfo->trackinfos);
-	free(metainfo->album);
 	free(metainfo);
 }
 
@@ -265,6 +401,6 @@ void tsr_metainfo_free(tsr_metainfo_t *metainfo)
  */
 void tsr_trackfile_fail(tsr_trackfile_t *trackfile)
 {
-	fclose(trackfile->file_s);
+	tsr_writer_close(trackfile->writer);
 	unlink(trackfile->filename);
 }
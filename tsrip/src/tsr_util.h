@@ -20,12 +20,17 @@
  *
  */
 
-char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum);
+char *tsr_get_filename(tsr_cfg_t *cfg, tsr_metainfo_t *metainfo, int tracknum,
+		char *ext);
+
+char *tsr_get_tmpfilename(tsr_cfg_t *cfg, char *discid, int tracknum, char *ext);
 
 void tsr_exit_error(char *file, int line, int err);
 
 tsr_metainfo_t *tsr_metainfo_new(int size);
 
+char *tsr_metainfo_str(tsr_metainfo_t *metainfo, const char *str);
+
 tsr_metainfo_t *tsr_metainfo_copy(tsr_metainfo_t *metainfo);
 
 void tsr_metainfo_free(tsr_metainfo_t *metainfo);
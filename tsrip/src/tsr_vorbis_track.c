@@ -0,0 +1,240 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_vorbis_track.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cdda_interface.h>
+#include <vorbis/vorbisenc.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_vorbis_track.h"
+#include "tsr_pcm.h"
+#include "tsr_tags.h"
+#include "tsr_util.h"
+#include "tsr_writer.h"
+
+/*
+ * Append an ogg page to the output buffer.
+ *
+ */
+void tsr_vorbisfile_write_page(tsr_vorbisfile_t *vorbisfile, ogg_page *opage)
+{
+	tsr_writer_write(vorbisfile->trackfile.writer, opage->header, opage->header_len);
+	tsr_writer_write(vorbisfile->trackfile.writer, opage->body, opage->body_len);
+}
+
+/* 
+ * Write next ogg blocks and finish unfinished ones.
+ *
+ */
+void tsr_vorbisfile_encode_handle_blocks(tsr_vorbisfile_t *vorbisfile)
+{
+	ogg_packet opackage;
+	ogg_page opage;
+	tsr_stats_t *stats = vorbisfile->trackfile.stats;
+	uint64_t t;
+
+	t = tsr_stats_start(stats);
+
+	while (vorbis_analysis_blockout(&vorbisfile->vdsp_state, &vorbisfile->vblock) == 1)
+	{
+		vorbis_analysis(&vorbisfile->vblock, 0);
+		tsr_stats_stop(stats, TSR_STAGE_ANALYSIS, t);
+		t = tsr_stats_start(stats);
+		vorbis_bitrate_addblock(&vorbisfile->vblock);
+
+		while (vorbis_bitrate_flushpacket(&vorbisfile->vdsp_state, &opackage))
+		{
+			tsr_stats_stop(stats, TSR_STAGE_BITRATE, t);
+			t = tsr_stats_start(stats);
+			ogg_stream_packetin(&vorbisfile->ostream, &opackage);
+
+			while (1)
+			{
+				int result = (vorbisfile->pagefill > 0) ?
+					ogg_stream_pageout_fill(&vorbisfile->ostream, &opage,
+							vorbisfile->pagefill) :
+					ogg_stream_pageout(&vorbisfile->ostream, &opage);
+				
+				if (!result)
+				{
+					break;
+				}
+
+				tsr_stats_stop(stats, TSR_STAGE_PAGE, t);
+				t = tsr_stats_start(stats);
+				tsr_vorbisfile_write_page(vorbisfile, &opage);
+				tsr_stats_stop(stats, TSR_STAGE_WRITE, t);
+				t = tsr_stats_start(stats);
+			}
+
+			tsr_stats_stop(stats, TSR_STAGE_PAGE, t);
+			t = tsr_stats_start(stats);
+		}
+
+		tsr_stats_stop(stats, TSR_STAGE_BITRATE, t);
+		t = tsr_stats_start(stats);
+	}
+}
+
+/* 
+ * Encode next buffer of the given number of sectors. 
+ *
+ */
+void tsr_vorbisfile_encode_next(tsr_trackfile_t *trackfile, int8_t *read_buffer,
+		int sectors)
+{
+	tsr_vorbisfile_t *vorbisfile = (tsr_vorbisfile_t *) trackfile;
+	float **encode_buffer;
+	int samples;
+	uint64_t t;
+
+	t = tsr_stats_start(trackfile->stats);
+	samples = sectors * CD_FRAMESAMPLES;
+	encode_buffer = vorbis_analysis_buffer(&vorbisfile->vdsp_state, samples);
+	tsr_pcm_deinterleave(read_buffer, encode_buffer[0], encode_buffer[1], samples);
+	vorbis_analysis_wrote(&vorbisfile->vdsp_state, samples);
+	tsr_stats_stop(trackfile->stats, TSR_STAGE_PCM, t);
+	tsr_vorbisfile_encode_handle_blocks(vorbisfile);
+}
+
+/* 
+ * Finish file. Returns 0 if it could not be written completely.
+ *
+ */
+int tsr_vorbisfile_finish(tsr_trackfile_t *trackfile)
+{
+	tsr_vorbisfile_t *vorbisfile = (tsr_vorbisfile_t *) trackfile;
+	int ok = 1;
+
+	vorbis_analysis_wrote(&vorbisfile->vdsp_state, 0);
+	tsr_vorbisfile_encode_handle_blocks(vorbisfile);
+	ogg_stream_clear(&vorbisfile->ostream);
+	vorbis_block_clear(&vorbisfile->vblock);
+	vorbis_dsp_clear(&vorbisfile->vdsp_state);
+	vorbis_comment_clear(&vorbisfile->vcomment);
+	vorbis_info_clear(&vorbisfile->vinfo);
+
+	if (tsr_writer_close(trackfile->writer))
+	{
+		fprintf(stderr, "\nError writing %s\n", trackfile->filename);
+		ok = 0;
+	}
+
+	free(vorbisfile);
+
+	return ok;
+}
+
+/* 
+ * Initialize file, ogg stuff etc. Without metainfo the file is only tagged
+ * with the encoder, the tags are written later by tsr_tags_write.
+ *
+ */
+tsr_trackfile_t *tsr_vorbisfile_init(int tracknum, char *filename,
+		tsr_metainfo_t *metainfo, float quality, tsr_cfg_t *cfg)
+{
+	tsr_vorbisfile_t *vorbisfile;
+	ogg_page opage;
+	ogg_packet oheader;
+	ogg_packet oheader_comm;
+	ogg_packet oheader_code;
+	unsigned char *comments;
+	char **tags;
+	int i, padding;
+
+	vorbisfile = (tsr_vorbisfile_t *) malloc(sizeof(tsr_vorbisfile_t));
+
+	if (vorbisfile == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	vorbisfile->trackfile.writer = tsr_writer_open(filename, cfg->writebuffer);
+
+	if (!vorbisfile->trackfile.writer)
+	{
+		perror("tsr_vorbisfile_init: open");
+		exit(1);
+	}
+	
+	vorbisfile->trackfile.filename = filename;
+	vorbisfile->trackfile.stats = NULL;
+	vorbisfile->pagefill = cfg->pagefill;
+	vorbisfile->trackfile.encode = tsr_vorbisfile_encode_next;
+	vorbisfile->trackfile.finish = tsr_vorbisfile_finish;
+	vorbis_info_init(&vorbisfile->vinfo);
+	vorbis_encode_init_vbr(&vorbisfile->vinfo, 2, 44100, quality);
+	vorbis_comment_init(&vorbisfile->vcomment);
+	vorbis_analysis_init(&vorbisfile->vdsp_state, &vorbisfile->vinfo);
+	vorbis_block_init(&vorbisfile->vdsp_state, &vorbisfile->vblock);
+	ogg_stream_init(&(vorbisfile->ostream), tracknum);
+
+	tags = tsr_tags_new(tracknum, metainfo);
+
+	for (i = 0; tags[i] != NULL; i++)
+	{
+		vorbis_comment_add(&vorbisfile->vcomment, tags[i]);
+	}
+
+	tsr_tags_free(tags);
+	vorbis_analysis_headerout(&vorbisfile->vdsp_state, &vorbisfile->vcomment,
+			&oheader, &oheader_comm, &oheader_code);
+
+	/* zeros after the framing bit are skipped by decoders */
+	padding = (tracknum == TSR_DISC) ? TSR_TAGS_DISC_PADDING : TSR_TAGS_PADDING;
+	comments = (unsigned char *) calloc(1, oheader_comm.bytes + padding);
+
+	if (comments == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	memcpy(comments, oheader_comm.packet, oheader_comm.bytes);
+	oheader_comm.packet = comments;
+	oheader_comm.bytes += padding;
+	ogg_stream_packetin(&vorbisfile->ostream, &oheader);
+	ogg_stream_packetin(&vorbisfile->ostream, &oheader_comm);
+	ogg_stream_packetin(&vorbisfile->ostream, &oheader_code);
+	free(comments);
+
+	/* finish ogg block */
+	while (1)
+	{
+		int result = ogg_stream_flush(&vorbisfile->ostream, &opage);
+		
+		if (!result)
+		{
+			break;
+		}
+
+		tsr_vorbisfile_write_page(vorbisfile, &opage);
+	}
+
+	return (tsr_trackfile_t *) vorbisfile;
+}
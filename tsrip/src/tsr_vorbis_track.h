@@ -0,0 +1,39 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_vorbis_track.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#include <vorbis/vorbisenc.h>
+
+#include "tsr_types.h"
+
+typedef struct _tsr_vorbisfile_t
+{
+	tsr_trackfile_t trackfile;
+	vorbis_info vinfo;
+	vorbis_comment vcomment;
+	vorbis_dsp_state vdsp_state;
+	vorbis_block vblock;
+	ogg_stream_state ostream;
+	int pagefill;
+} tsr_vorbisfile_t;
+
+tsr_trackfile_t *tsr_vorbisfile_init(int tracknum, char *filename,
+		tsr_metainfo_t *metainfo, float quality, tsr_cfg_t *cfg);
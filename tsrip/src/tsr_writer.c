@@ -0,0 +1,197 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_writer.c
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+/*
+ * Buffered output for the encoded files. Ogg pages are a few kilobytes
+ * only, so they are gathered in a large page aligned buffer which is
+ * written with a single write() once it is full. Write errors are kept
+ * until the file is closed.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "tsr_types.h"
+#include "tsr_cfg.h"
+#include "tsr_writer.h"
+#include "tsr_util.h"
+
+/*
+ * Create filename and a buffer of size bytes. Returns NULL and sets errno if
+ * the file can't be created.
+ *
+ */
+tsr_writer_t *tsr_writer_open(char *filename, size_t size)
+{
+	tsr_writer_t *writer;
+	int err;
+
+	writer = (tsr_writer_t *) malloc(sizeof(tsr_writer_t));
+
+	if (writer == NULL)
+	{
+		tsr_exit_error(__FILE__, __LINE__, errno);
+	}
+
+	err = posix_memalign((void **) &writer->buf, 4096, size);
+
+	if (err)
+	{
+		tsr_exit_error(__FILE__, __LINE__, err);
+	}
+
+	writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if (writer->fd == -1)
+	{
+		err = errno;
+		free(writer->buf);
+		free(writer);
+		errno = err;
+
+		return NULL;
+	}
+
+	writer->size = size;
+	writer->fill = 0;
+	writer->offset = 0;
+	writer->error = 0;
+
+	return writer;
+}
+
+/*
+ * Write len bytes of data directly to the file.
+ *
+ */
+static void tsr_writer_write_fd(tsr_writer_t *writer, const char *data, size_t len)
+{
+	ssize_t written;
+
+	while (len > 0 && !writer->error)
+	{
+		written = write(writer->fd, data, len);
+
+		if (written == -1)
+		{
+			if (errno != EINTR)
+			{
+				writer->error = errno;
+			}
+
+			continue;
+		}
+
+		data += written;
+		len -= written;
+		writer->offset += written;
+	}
+}
+
+/*
+ * Write out the buffer.
+ *
+ */
+void tsr_writer_flush(tsr_writer_t *writer)
+{
+	tsr_writer_write_fd(writer, writer->buf, writer->fill);
+	writer->fill = 0;
+}
+
+/*
+ * Get the position in the file where the next write goes to.
+ *
+ */
+off_t tsr_writer_tell(tsr_writer_t *writer)
+{
+	return writer->offset + writer->fill;
+}
+
+/*
+ * Flush the buffer and continue writing at offset. Returns 0 or an error.
+ *
+ */
+int tsr_writer_seek(tsr_writer_t *writer, off_t offset)
+{
+	tsr_writer_flush(writer);
+
+	if (!writer->error && lseek(writer->fd, offset, SEEK_SET) == -1)
+	{
+		writer->error = errno;
+	}
+
+	if (!writer->error)
+	{
+		writer->offset = offset;
+	}
+
+	return writer->error;
+}
+
+/*
+ * Append len bytes of data to the buffer, flush it if it's full.
+ *
+ */
+void tsr_writer_write(tsr_writer_t *writer, const void *data, size_t len)
+{
+	if (writer->fill + len > writer->size)
+	{
+		tsr_writer_flush(writer);
+	}
+
+	if (len > writer->size)
+	{
+		tsr_writer_write_fd(writer, data, len);
+
+		return;
+	}
+
+	memcpy(writer->buf + writer->fill, data, len);
+	writer->fill += len;
+}
+
+/*
+ * Flush and close the file and free the writer. Returns 0 or the first
+ * error that occured.
+ *
+ */
+int tsr_writer_close(tsr_writer_t *writer)
+{
+	int err;
+
+	tsr_writer_flush(writer);
+	err = writer->error;
+
+	if (close(writer->fd) == -1 && !err)
+	{
+		err = errno;
+	}
+
+	free(writer->buf);
+	free(writer);
+
+	return err;
+}
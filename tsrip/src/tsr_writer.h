@@ -0,0 +1,51 @@
+/*
+ * This file is part of tsrip.
+ * 
+ * tsrip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ * 
+ * tsrip is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with tsrip; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * file: tsr_writer.h
+ * Author: Sven Salzwedel <sven_salzwedel@web.de>
+ *
+ */
+
+#ifndef TSR_WRITER_H
+#define TSR_WRITER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct _tsr_writer_t
+{
+	int fd;
+	char *buf;
+	size_t size;
+	size_t fill;
+	off_t offset;
+	int error;
+} tsr_writer_t;
+
+tsr_writer_t *tsr_writer_open(char *filename, size_t size);
+
+void tsr_writer_write(tsr_writer_t *writer, const void *data, size_t len);
+
+void tsr_writer_flush(tsr_writer_t *writer);
+
+off_t tsr_writer_tell(tsr_writer_t *writer);
+
+int tsr_writer_seek(tsr_writer_t *writer, off_t offset);
+
+int tsr_writer_close(tsr_writer_t *writer);
+
+#endif